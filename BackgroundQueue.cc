@@ -0,0 +1,286 @@
+/**
+* @file
+*
+* Background extraction of fields requested with CONTENT_DELAYIFSLOW flag.
+*/
+
+#include "BackgroundQueue.hh"
+#include "xPDFInfo.hh"
+#include <algorithm>
+
+/**
+* Destructor, stop queue thread if it is still running.
+*/
+BackgroundQueue::~BackgroundQueue()
+{
+    stop(PRODUCER_TIMEOUT);
+}
+
+/**
+* Check if field extraction may take a long time.
+* Text fields need page content interpretation, page counters load and check every page.
+* Other fields are read from Info directory, XMP metadata, Catalog or trailer.
+* Full text fields (#fiText, #fiOutlines) are used only in search, they are never delayed.
+*
+* @param[in]    field   index of the field
+* @return true if field should be extracted in background
+*/
+bool BackgroundQueue::isSlowField(int field)
+{
+    switch (field)
+    {
+    case fiDocStart:
+        [[fallthrough]];
+    case fiFirstRow:
+        [[fallthrough]];
+    case fiNumberOfFontlessPages:
+        [[fallthrough]];
+    case fiNumberOfPagesWithImages:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+* Start queue thread, if not already started.
+* Must be called with #m_mutex locked.
+*
+* @return true if queue thread is running
+*/
+bool BackgroundQueue::start()
+{
+    if (!m_thread.joinable())
+    {
+        if (!m_extractor)
+        {
+            m_extractor = std::make_unique<PDFExtractor>();
+        }
+        m_exit.reset();
+        m_thread = std::thread([this]()
+        {
+            TRACE(L"%hs!queue thread start\n", __FUNCTION__);
+            run();
+            TRACE(L"%hs!queue thread end\n", __FUNCTION__);
+            m_exit.set();
+        });
+    }
+    return m_thread.joinable();
+}
+
+/**
+* Queue thread main function.
+* Extract queued requests one by one, oldest first.
+*/
+void BackgroundQueue::run()
+{
+    std::unique_lock lock(m_mutex);
+    while (!m_stop)
+    {
+        m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+        if (m_stop)
+        {
+            break;
+        }
+
+        auto item{ m_queue.front() };
+        m_queue.pop_front();
+        item->status = itemStatus::running;
+        lock.unlock();
+
+        // slow fields deferred by TC are not interactive, they don't pause search
+        std::vector<char> value(REQUEST_BUFFER_SIZE, 0);
+        const auto result{ m_extractor->extract(item->fileName.c_str(), item->field, item->unit, value.data(), static_cast<int>(value.size()), 0) };
+        TRACE(L"%hs!%ls!%d result=%d\n", __FUNCTION__, item->fileName.c_str(), item->field, result);
+
+        lock.lock();
+        item->result = result;
+        item->value = std::move(value);
+        item->status = itemStatus::done;
+        m_cv.notify_all();
+    }
+}
+
+/**
+* Find request.
+* Must be called with #m_mutex locked.
+*
+* @param[in]    fileName    full path to PDF document
+* @param[in]    field       index of the field
+* @param[in]    unit        index of the unit
+* @return iterator to request in #m_items, or m_items.end() if not found
+*/
+std::list<std::shared_ptr<BackgroundQueue::Item>>::iterator BackgroundQueue::find(const wchar_t* fileName, int field, int unit)
+{
+    return std::find_if(m_items.begin(), m_items.end(), [&](const std::shared_ptr<Item>& item)
+    {
+        return (item->field == field) && (item->unit == unit) && !wcsicmp(item->fileName.c_str(), fileName);
+    });
+}
+
+/**
+* Remove request from queue and from the list of known requests.
+* Must be called with #m_mutex locked.
+*
+* @param[in]    item    request to remove
+*/
+void BackgroundQueue::remove(const std::shared_ptr<Item>& item)
+{
+    m_queue.erase(std::remove(m_queue.begin(), m_queue.end(), item), m_queue.end());
+    m_items.remove(item);
+}
+
+/**
+* Queue request for background extraction.
+* If there are too many requests, the oldest ones which are not in progress are dropped.
+*
+* @param[in]    fileName    full path to PDF document
+* @param[in]    field       index of the field
+* @param[in]    unit        index of the unit
+* @return true if request is queued
+*/
+bool BackgroundQueue::enqueue(const wchar_t* fileName, int field, int unit)
+{
+    if (!fileName || !isSlowField(field))
+    {
+        return false;
+    }
+
+    std::lock_guard lock(m_mutex);
+    if (m_stop || !start())
+    {
+        return false;
+    }
+
+    if (find(fileName, field, unit) != m_items.end())
+    {
+        // already queued
+        return true;
+    }
+
+    for (auto it{ m_items.begin() }; (m_items.size() >= BACKGROUND_QUEUE_SIZE) && (it != m_items.end()); )
+    {
+        const auto item{ *it++ };
+        if (item->status != itemStatus::running)
+        {
+            remove(item);
+        }
+    }
+
+    auto item{ std::make_shared<Item>() };
+    item->fileName.assign(fileName);
+    item->field = field;
+    item->unit = unit;
+    m_items.push_back(item);
+    m_queue.push_back(item);
+    m_cv.notify_all();
+    TRACE(L"%hs!%ls!%d queued\n", __FUNCTION__, fileName, field);
+    return true;
+}
+
+/**
+* Get value extracted in background.
+* If extraction is in progress, wait for it to complete.
+* If request is still waiting in queue, it is removed from queue and caller should extract value itself.
+*
+* @param[in]    fileName    full path to PDF document
+* @param[in]    field       index of the field
+* @param[in]    unit        index of the unit
+* @param[out]   dst         buffer for retrieved data
+* @param[in]    dstSize     sizeof dst buffer in bytes
+* @param[out]   result      result of an extraction
+* @return true if value has been extracted in background and copied to dst
+*/
+bool BackgroundQueue::fetch(const wchar_t* fileName, int field, int unit, void* dst, int dstSize, int& result)
+{
+    if (!fileName || !isSlowField(field))
+    {
+        return false;
+    }
+
+    std::unique_lock lock(m_mutex);
+    const auto it{ find(fileName, field, unit) };
+    if (it == m_items.end())
+    {
+        return false;
+    }
+
+    const auto item{ *it };
+    if (item->status == itemStatus::queued)
+    {
+        // extraction hasn't started, don't wait for other requests in queue
+        remove(item);
+        return false;
+    }
+
+    const auto isDone{ [this, &item] { return m_stop || (item->status == itemStatus::done); } };
+    if (!m_cv.wait_for(lock, std::chrono::milliseconds(CONSUMER_TIMEOUT), isDone) || (item->status != itemStatus::done))
+    {
+        return false;
+    }
+
+    remove(item);
+    result = item->result;
+    if (dst && (dstSize > 0))
+    {
+        const auto len{ std::min(static_cast<size_t>(dstSize), item->value.size()) };
+        memcpy(dst, item->value.data(), len);
+        if ((result == ft_stringw) && (len >= sizeof(wchar_t)))
+        {
+            // value may be truncated, terminate string
+            static_cast<wchar_t*>(dst)[len / sizeof(wchar_t) - 1] = 0;
+        }
+    }
+    TRACE(L"%hs!%ls!%d result=%d\n", __FUNCTION__, fileName, field, result);
+    return true;
+}
+
+/**
+* Drop requests waiting in queue and values which have not been fetched.
+* Request in progress is not cancelled, it is dropped when TC fetches its value or when queue is full.
+*/
+void BackgroundQueue::clear()
+{
+    std::lock_guard lock(m_mutex);
+    m_queue.clear();
+    m_items.remove_if([](const std::shared_ptr<Item>& item) { return item->status != itemStatus::running; });
+}
+
+/**
+* Stop queue thread and release extractor.
+* Queue thread is detached, not joined, see ThreadData::closeWorker.
+* Extraction in progress is aborted, #PDFExtractor::stop would wait for it up to #CONSUMER_TIMEOUT.
+* If queue thread doesn't exit in time, it is left to finish on its own.
+*
+* @param[in]    timeout     time to wait for queue thread to exit in miliseconds
+*/
+void BackgroundQueue::stop(uint32_t timeout)
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+        m_queue.clear();
+        m_items.clear();
+    }
+    m_cv.notify_all();
+
+    if (m_thread.joinable())
+    {
+        // cancel extraction in progress, abort waits for it only PRODUCER_TIMEOUT, stop may be called from DllMain
+        m_extractor->abort();
+        const auto exited{ m_exit.wait(timeout) == waitResult::signaled };
+        m_thread.detach();
+        if (!exited)
+        {
+            // extractor is still used by queue thread
+            static_cast<void>(m_extractor.release());
+            return;
+        }
+    }
+
+    if (m_extractor)
+    {
+        m_extractor->abort();
+        m_extractor.reset();
+    }
+}
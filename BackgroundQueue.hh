@@ -0,0 +1,76 @@
+/**
+* @file
+*
+* BackgroundQueue class declaration.
+*/
+
+#pragma once
+
+#include "PDFExtractor.hh"
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <memory>
+
+constexpr size_t BACKGROUND_QUEUE_SIZE{ 256U };    /**< max number of delayed requests and values waiting for TC */
+
+/**
+* Queue of slow field extractions requested with CONTENT_DELAYIFSLOW flag.
+* TC calls ContentGetValueW with CONTENT_DELAYIFSLOW flag from its main thread,
+* and calls it again without this flag from background thread if #ft_delayed is returned.
+* Delayed requests are extracted in the queue thread while TC prepares its background call,
+* and the background call takes the value which is already computed or in progress.
+*/
+class BackgroundQueue
+{
+public:
+    BackgroundQueue() = default;
+    BackgroundQueue(const BackgroundQueue&) = delete;
+    BackgroundQueue& operator=(const BackgroundQueue&) = delete;
+    ~BackgroundQueue();
+
+    static bool isSlowField(int field);
+    bool enqueue(const wchar_t* fileName, int field, int unit);
+    bool fetch(const wchar_t* fileName, int field, int unit, void* dst, int dstSize, int& result);
+    void clear();
+    void stop(uint32_t timeout);
+
+private:
+    /**
+    * Status of queued request
+    */
+    enum class itemStatus
+    {
+        queued,     /**< waiting in queue */
+        running,    /**< extraction in progress */
+        done,       /**< value is extracted */
+    };
+
+    /**
+    * Queued request and its extracted value
+    */
+    struct Item
+    {
+        std::wstring        fileName;                       /**< full path to PDF document */
+        int                 field{ 0 };                     /**< field index to extract */
+        int                 unit{ 0 };                      /**< unit index */
+        int                 result{ ft_fieldempty };        /**< result of an extraction */
+        itemStatus          status{ itemStatus::queued };   /**< request status */
+        std::vector<char>   value;                          /**< extracted data */
+    };
+
+    bool start();
+    void run();
+    std::list<std::shared_ptr<Item>>::iterator find(const wchar_t* fileName, int field, int unit);
+    void remove(const std::shared_ptr<Item>& item);
+
+    std::mutex                          m_mutex;                /**< protects queue and items */
+    std::condition_variable             m_cv;                   /**< signals new request or extracted value */
+    std::deque<std::shared_ptr<Item>>   m_queue;                /**< requests waiting for extraction */
+    std::list<std::shared_ptr<Item>>    m_items;                /**< all known requests, oldest first */
+    std::unique_ptr<PDFExtractor>       m_extractor{ nullptr }; /**< extractor used by queue thread */
+    std::thread                         m_thread;               /**< queue thread */
+    SyncEvent                           m_exit;                 /**< raised by queue thread before it exits */
+    bool                                m_stop{ false };        /**< queue thread should exit */
+};
@@ -0,0 +1,303 @@
+/**
+* @file
+*
+* Decoding of content streams of next pages in a helper thread.
+*/
+
+#include "ContentDecoder.hh"
+#include "xPDFInfo.hh"
+#include <Catalog.h>
+#include <Page.h>
+#include <algorithm>
+
+/**
+* Destructor. Helper thread is stopped by #cancel at the end of each extraction,
+* destructor may be called from DllMain, where a running thread can't be joined.
+*/
+ContentDecoder::~ContentDecoder()
+{
+    cancel();
+}
+
+/**
+* Start helper thread, if not already started.
+* Must be called with #m_mutex locked.
+*
+* @return true if helper thread is running
+*/
+bool ContentDecoder::start()
+{
+    if (!m_thread.joinable())
+    {
+        m_stop = false;
+        m_thread = std::thread([this]()
+        {
+            TRACE(L"%hs!decode ahead thread start\n", __FUNCTION__);
+            run();
+            TRACE(L"%hs!decode ahead thread end\n", __FUNCTION__);
+        });
+    }
+    return m_thread.joinable();
+}
+
+/**
+* Helper thread main function.
+* Queued pages are decoded in page order, while decoded data fits to #DECODE_AHEAD_MEMORY_MAX.
+*/
+void ContentDecoder::run()
+{
+    std::unique_lock lock(m_mutex);
+    while (!m_stop)
+    {
+        const auto isQueued{ [](const QueuedPage& p) { return p.state == pageState::queued; } };
+        auto it{ std::find_if(m_pages.begin(), m_pages.end(), isQueued) };
+        if ((it == m_pages.end()) || (m_size >= DECODE_AHEAD_MEMORY_MAX))
+        {
+            m_cv.wait(lock);
+            continue;
+        }
+
+        const auto pageNum{ it->num };
+        const auto doc{ m_doc };
+        const auto limit{ DECODE_AHEAD_MEMORY_MAX - m_size };
+        it->state = pageState::decoding;
+        m_abort = false;
+        lock.unlock();
+
+        std::vector<char> data;
+        const auto ok{ decodePage(doc, pageNum, limit, data) };
+
+        lock.lock();
+        // pages being decoded are not removed from queue, see queuePages and cancel
+        it = std::find_if(m_pages.begin(), m_pages.end(), [pageNum](const QueuedPage& p) { return p.num == pageNum; });
+        if (it != m_pages.end())
+        {
+            if (ok && !m_abort)
+            {
+                m_size += data.size();
+                it->data = std::move(data);
+                it->state = pageState::ready;
+            }
+            else
+            {
+                it->state = pageState::failed;
+            }
+        }
+        m_cv.notify_all();
+    }
+}
+
+/**
+* Decode content streams of a page.
+* Must be called only from helper thread.
+* Content streams of a page are separated by EOL, like tokens of separate streams in Lexer.
+*
+* @param[in]    doc         PDF document
+* @param[in]    pageNum     page number
+* @param[in]    limit       max size of decoded data, in bytes
+* @param[out]   data        decoded content streams
+* @return true if page has been decoded
+*/
+bool ContentDecoder::decodePage(PDFDoc* doc, int pageNum, size_t limit, std::vector<char>& data)
+{
+    const auto page{ doc->getCatalog()->getPage(pageNum) };
+    if (!page)
+    {
+        return false;
+    }
+
+    auto ok{ true };
+    Object contents;
+    if (page->getContents(&contents)->isArray())
+    {
+        for (int i{ 0 }; ok && (i < contents.arrayGetLength()); i++)
+        {
+            Object obj;
+            if (i > 0)
+            {
+                data.push_back('\n');
+            }
+            ok = decodeStream(contents.arrayGet(i, &obj), limit, data);
+            obj.free();
+        }
+    }
+    else
+    {
+        ok = decodeStream(&contents, limit, data);
+    }
+    contents.free();
+    return ok;
+}
+
+/**
+* Decode one content stream and append it to data.
+* Decoding stops if #m_abort is set or the data doesn't fit to limit.
+*
+* @param[in]        obj     content stream object
+* @param[in]        limit   max size of decoded data, in bytes
+* @param[in,out]    data    decoded content streams
+* @return true if stream has been decoded
+*/
+bool ContentDecoder::decodeStream(Object* obj, size_t limit, std::vector<char>& data)
+{
+    // invalid contents are reported by Gfx
+    if (!obj->isStream())
+    {
+        return false;
+    }
+
+    const auto str{ obj->getStream() };
+    auto ok{ true };
+    str->reset();
+    for (;;)
+    {
+        const auto size{ data.size() };
+        if (m_abort || (size + DECODE_AHEAD_BLOCK_SIZE > limit))
+        {
+            ok = false;
+            break;
+        }
+        data.resize(size + DECODE_AHEAD_BLOCK_SIZE);
+        const auto n{ str->getBlock(data.data() + size, static_cast<int>(DECODE_AHEAD_BLOCK_SIZE)) };
+        data.resize(size + std::max(n, 0));
+        if (n <= 0)
+        {
+            break;
+        }
+    }
+    str->close();
+    return ok;
+}
+
+/**
+* Drop all pages, wait until helper thread finishes the page it is decoding.
+* Queued pages are dropped first, so helper thread doesn't start a new page.
+*
+* @param[in]    lock    lock of #m_mutex
+*/
+void ContentDecoder::clear(std::unique_lock<std::mutex>& lock)
+{
+    const auto isDecoding{ [](const QueuedPage& p) { return p.state == pageState::decoding; } };
+    m_pages.erase(std::remove_if(m_pages.begin(), m_pages.end(), [&](const QueuedPage& p) { return !isDecoding(p); }), m_pages.end());
+    m_abort = true;
+    m_cv.wait(lock, [&] { return std::none_of(m_pages.begin(), m_pages.end(), isDecoding); });
+    m_pages.clear();
+    m_size = 0;
+}
+
+/**
+* Queue pages for decoding, drop other pages which are not being decoded.
+* If the document has changed, all pages of previous document are dropped.
+*
+* @param[in]    doc         PDF document
+* @param[in]    firstPage   first page to decode
+* @param[in]    lastPage    last page to decode
+*/
+void ContentDecoder::queuePages(PDFDoc* doc, int firstPage, int lastPage)
+{
+    lastPage = std::min(lastPage, doc->getNumPages());
+    std::unique_lock lock(m_mutex);
+    if (doc != m_doc)
+    {
+        // helper thread uses m_doc while decoding
+        clear(lock);
+        m_doc = doc;
+    }
+
+    for (auto it{ m_pages.begin() }; it != m_pages.end();)
+    {
+        if ((it->state != pageState::decoding) && ((it->num < firstPage) || (it->num > lastPage)))
+        {
+            m_size -= it->data.size();
+            it = m_pages.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    for (int pageNum{ firstPage }; pageNum <= lastPage; ++pageNum)
+    {
+        if (std::none_of(m_pages.begin(), m_pages.end(), [pageNum](const QueuedPage& p) { return p.num == pageNum; }))
+        {
+            QueuedPage page;
+            page.num = pageNum;
+            m_pages.push_back(std::move(page));
+        }
+    }
+    if ((firstPage <= lastPage) && start())
+    {
+        m_cv.notify_all();
+    }
+}
+
+/**
+* Take decoded data of a page.
+* If the page is being decoded, wait for it. If it is only queued, drop it, so Gfx decodes it.
+*
+* @param[in]    pageNum     page number
+* @param[out]   contents    stream with decoded data
+* @return true if decoded data is available
+*/
+bool ContentDecoder::take(int pageNum, Object* contents)
+{
+    std::unique_lock lock(m_mutex);
+    const auto find{ [this, pageNum]() { return std::find_if(m_pages.begin(), m_pages.end(), [pageNum](const QueuedPage& p) { return p.num == pageNum; }); } };
+    m_cv.wait(lock, [&] { const auto it{ find() }; return (it == m_pages.end()) || (it->state != pageState::decoding); });
+    const auto it{ find() };
+    if (it == m_pages.end())
+    {
+        return false;
+    }
+
+    const auto ready{ it->state == pageState::ready };
+    if (ready)
+    {
+        m_size -= it->data.size();
+        m_current = std::move(it->data);
+        Object dict;
+        dict.initDict(m_doc->getXRef());
+        contents->initStream(new MemStream(m_current.data(), 0, static_cast<Guint>(m_current.size()), &dict));
+        // count data decoded by helper thread to limits of extraction thread, see ResourceGovernor
+        Stream::addDecodedSize(m_current.size());
+    }
+    m_pages.erase(it);
+    // memory is released, helper thread can continue
+    m_cv.notify_all();
+    return ready;
+}
+
+/**
+* Drop queued and decoded pages, stop helper thread.
+* Must be called before the document is closed, and at the end of extraction,
+* so the helper thread is not left running when TcOutputDev is destroyed.
+*/
+void ContentDecoder::cancel()
+{
+    {
+        std::unique_lock lock(m_mutex);
+        clear(lock);
+        m_doc = nullptr;
+        m_stop = true;
+        m_cv.notify_all();
+    }
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+    m_current.clear();
+    m_current.shrink_to_fit();
+}
+
+/**
+* Callback function used in Page::displaySlice to get decoded content streams of a page.
+*
+* @param[in]    decoder     pointer to ContentDecoder
+* @param[in]    pageNum     page number
+* @param[out]   contents    stream with decoded data
+* @return gTrue if decoded data is available
+*/
+GBool ContentDecoder::getContents(void* decoder, int pageNum, Object* contents)
+{
+    return static_cast<ContentDecoder*>(decoder)->take(pageNum, contents) ? gTrue : gFalse;
+}
@@ -0,0 +1,75 @@
+/**
+* @file
+*
+* ContentDecoder class declaration.
+*/
+
+#pragma once
+
+#include "ThreadData.hh"
+#include <deque>
+#include <vector>
+
+constexpr size_t DECODE_AHEAD_BLOCK_SIZE{ 64U * 1024U };         /**< size of one read of decode ahead thread, in bytes */
+constexpr size_t DECODE_AHEAD_MEMORY_MAX{ 64U * 1024U * 1024U };  /**< max size of decoded content streams held by decode ahead thread, in bytes */
+
+/**
+* Decoding of content streams of next pages in a helper thread.
+* Content streams are fetched, decrypted and decompressed on demand, while the page is interpreted,
+* so one thread either decodes or interprets.
+* While a page is extracted, content streams of next pages are decoded to memory by a helper thread,
+* and Gfx interprets the decoded data when it gets to them, see Page::setContentsCbk.
+* Pages which are not decoded yet when Gfx gets to them are decoded by Gfx as usual.
+* Memory of decoded pages is limited by #DECODE_AHEAD_MEMORY_MAX.
+*/
+class ContentDecoder
+{
+public:
+    ContentDecoder() = default;
+    ContentDecoder(const ContentDecoder&) = delete;
+    ContentDecoder& operator=(const ContentDecoder&) = delete;
+    ~ContentDecoder();
+
+    void queuePages(PDFDoc* doc, int firstPage, int lastPage);
+    void cancel();
+    static GBool getContents(void* decoder, int pageNum, Object* contents);
+
+private:
+    /**
+    * State of decoding of one page
+    */
+    enum class pageState
+    {
+        queued,     /**< waiting for helper thread */
+        decoding,   /**< helper thread is decoding the page */
+        ready,      /**< decoded data is in #QueuedPage::data */
+        failed      /**< page can't be decoded ahead, Gfx decodes it */
+    };
+
+    /**
+    * Page queued for decoding
+    */
+    struct QueuedPage
+    {
+        int                 num{ 0 };                   /**< page number */
+        pageState           state{ pageState::queued }; /**< state of decoding */
+        std::vector<char>   data;                       /**< decoded content streams */
+    };
+
+    bool start();
+    void run();
+    bool decodePage(PDFDoc* doc, int pageNum, size_t limit, std::vector<char>& data);
+    bool decodeStream(Object* obj, size_t limit, std::vector<char>& data);
+    bool take(int pageNum, Object* contents);
+    void clear(std::unique_lock<std::mutex>& lock);
+
+    std::mutex                  m_mutex;                /**< protects all members except #m_current */
+    std::condition_variable     m_cv;                   /**< signals new pages, finished pages or thread exit */
+    std::thread                 m_thread;               /**< decode ahead thread */
+    std::deque<QueuedPage>      m_pages;                /**< pages queued for decoding or decoded, in page order */
+    PDFDoc*                     m_doc{ nullptr };       /**< document of queued pages */
+    size_t                      m_size{ 0 };            /**< size of decoded data in #m_pages, in bytes */
+    std::atomic<bool>           m_abort{ false };       /**< helper thread should drop the page it is decoding */
+    bool                        m_stop{ false };        /**< helper thread should exit, set by #cancel */
+    std::vector<char>           m_current;              /**< decoded data of page interpreted by Gfx, used only by extraction thread */
+};
@@ -0,0 +1,129 @@
+/**
+* @file
+*
+* Destruction of closed documents in background.
+*/
+
+#include "DocReclaimer.hh"
+#include "ThreadData.hh"
+#include "xPDFInfo.hh"
+#include <deque>
+
+static std::mutex reclaimMutex;                                 /**< protects #reclaimQueue and #reclaimStop */
+static std::condition_variable reclaimCv;                       /**< signals closed document or stop */
+static std::deque<std::unique_ptr<PDFDocEx>> reclaimQueue;      /**< closed documents waiting for destruction */
+static std::thread reclaimThread;                               /**< reclaim thread */
+static SyncEvent reclaimExit;                                   /**< raised by reclaim thread before it exits */
+static bool reclaimStop{ false };                               /**< reclaim thread should exit, documents are destroyed immediately */
+static bool reclaimLeft{ false };                               /**< reclaim thread didn't exit in time in #DocReclaimer::stop */
+
+/**
+* Close file of the document and queue the document for destruction.
+* Reclaim thread is started on the first call. If the queue is full,
+* or reclaim thread is stopped, document is destroyed in calling thread.
+*
+* @param[in]    doc     closed document
+*/
+void DocReclaimer::reclaim(std::unique_ptr<PDFDocEx> doc)
+{
+    if (!doc)
+    {
+        return;
+    }
+    doc->closeFile();
+    {
+        std::lock_guard lock(reclaimMutex);
+        if (!reclaimStop && (reclaimQueue.size() < RECLAIM_QUEUE_SIZE))
+        {
+            if (!reclaimThread.joinable())
+            {
+                reclaimExit.reset();
+                reclaimThread = std::thread([]()
+                {
+                    TRACE(L"%hs!reclaim thread start\n", __FUNCTION__);
+                    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+                    run();
+                    TRACE(L"%hs!reclaim thread end\n", __FUNCTION__);
+                    reclaimExit.set();
+                });
+            }
+            reclaimQueue.push_back(std::move(doc));
+            reclaimCv.notify_one();
+            return;
+        }
+    }
+    doc.reset();
+}
+
+/**
+* Reclaim thread main function.
+* Destroy queued documents one by one, taken under the mutex.
+* When reclaim thread is stopped, it doesn't start to destroy next document, remaining documents are left to #stop.
+*/
+void DocReclaimer::run()
+{
+    std::unique_lock lock(reclaimMutex);
+    for (;;)
+    {
+        reclaimCv.wait(lock, [] { return reclaimStop || !reclaimQueue.empty(); });
+        if (reclaimStop)
+        {
+            break;
+        }
+        auto doc{ std::move(reclaimQueue.front()) };
+        reclaimQueue.pop_front();
+        lock.unlock();
+        doc.reset();
+        lock.lock();
+    }
+}
+
+/**
+* Stop reclaim thread, and destroy queued documents in calling thread.
+* Must be called before globalParams are deleted.
+* Reclaim thread is detached, not joined, see ThreadData::closeWorker.
+* If reclaim thread doesn't exit in time, it is still destroying a document, which uses globalParams.
+* Queued documents are left then, and caller must not delete globalParams.
+*
+* @param[in]    timeout     time to wait for reclaim thread to exit in miliseconds
+* @return true if no document is being destroyed in background, globalParams may be deleted
+*/
+bool DocReclaimer::stop(uint32_t timeout)
+{
+    {
+        std::lock_guard lock(reclaimMutex);
+        reclaimStop = true;
+    }
+    reclaimCv.notify_all();
+
+    auto exited{ true };
+    if (reclaimThread.joinable() || reclaimLeft)
+    {
+        // reclaim thread may have been left running by previous call
+        exited = reclaimExit.wait(timeout) == waitResult::signaled;
+        if (reclaimThread.joinable())
+        {
+            reclaimThread.detach();
+        }
+        reclaimLeft = !exited;
+    }
+
+    std::deque<std::unique_ptr<PDFDocEx>> docs;
+    {
+        std::lock_guard lock(reclaimMutex);
+        docs.swap(reclaimQueue);
+    }
+    for (auto& doc : docs)
+    {
+        if (exited)
+        {
+            doc.reset();
+        }
+        else
+        {
+            // documents can't be destroyed after globalParams, leave them
+            static_cast<void>(doc.release());
+        }
+    }
+    return exited;
+}
@@ -0,0 +1,29 @@
+/**
+* @file
+*
+* DocReclaimer class declaration.
+*/
+
+#pragma once
+
+#include "PDFDocEx.hh"
+#include <memory>
+#include <cstdint>
+
+constexpr size_t RECLAIM_QUEUE_SIZE{ 4U };  /**< max number of closed documents waiting for destruction, next ones are destroyed immediately */
+
+/**
+* Destruction of closed documents in a low priority thread.
+* Destruction of a large document (catalog, page cache, xref and object stream caches, fonts, outline)
+* takes noticeable time, and opening of the next document would wait for it.
+* File of the document is closed immediately, so the file can be renamed or deleted,
+* the rest of the document is destroyed in background.
+*/
+class DocReclaimer
+{
+public:
+    static void reclaim(std::unique_ptr<PDFDocEx> doc);
+    static bool stop(uint32_t timeout);
+private:
+    static void run();
+};
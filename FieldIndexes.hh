@@ -0,0 +1,25 @@
+/**
+* @file
+*
+* Declaration of field indexes, shared by the plugin interface and extraction threads
+*/
+
+#pragma once
+#include <cstddef>
+
+/**
+* The fieldIndexes enumeration is used simplify access to fields.
+*/
+enum fieldIndexes
+{
+    fiTitle, fiSubject, fiKeywords, fiAuthor, fiCreator, fiProducer, fiDocStart, fiFirstRow, fiExtensions,
+    fiNumberOfPages, fiNumberOfFontlessPages,fiNumberOfPagesWithImages,
+    fiPDFVersion, fiPageWidth, fiPageHeight,
+    fiCopyable, fiPrintable, fiCommentable, fiChangeable, fiEncrypted, fiTagged, fiLinearized, fiIncremental, fiSigned, fiOutlined, fiEmbeddedFiles,
+    fiCreationDate, fiModifiedDate, fiMetadataDate,
+    fiID, fiAttributesString, fiConformance, fiCreationDateRaw, fiModifiedDateRaw, fiMetadataDateRaw,
+    fiOutlines, fiText
+};
+
+/**< used to globally set the number of supported fields. */
+constexpr size_t FIELD_COUNT{ static_cast<size_t>(fiText + 1) };
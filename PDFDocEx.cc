@@ -3,15 +3,29 @@
 #include <Outline.h>
 #include <TextString.h>
 #include "xPDFInfo.hh"
+#include <vector>
+#include <algorithm>
 
 /**
 * Constructor
 * 
 * @param fileNameA      PDF file name to open
 * @param fileNameLen    PDF file name length
+* @param firstPageOnly  open only the first page of a linearized document, fails if document is not linearized
 */
-PDFDocEx::PDFDocEx(const wchar_t *fileNameA, size_t fileNameLen)
-: PDFDoc(fileNameA, fileNameLen) 
+PDFDocEx::PDFDocEx(const wchar_t *fileNameA, size_t fileNameLen, bool firstPageOnly)
+: PDFDoc(fileNameA, fileNameLen, nullptr, nullptr, nullptr, firstPageOnly) 
+{
+}
+
+/**
+* Constructor of a document in a stream, e.g. an embedded file.
+* Document takes ownership of the stream.
+*
+* @param strA   stream with PDF document
+*/
+PDFDocEx::PDFDocEx(BaseStream* strA)
+: PDFDoc(strA)
 {
 }
 
@@ -89,6 +103,203 @@ bool PDFDocEx::hasEmbeddedFiles()
     return ret;
 }
 
+/**
+* Open embedded files which are PDF documents and call fn for each of them.
+* Only embedded files in EmbeddedFiles name tree of catalog are opened, not files in annotations.
+* Each embedded file stream is opened once, even if more file specifications refer to it.
+* Embedded document is valid only during fn call.
+*
+* @param[in]    fn  function called for each embedded PDF document, returns false to stop
+* @return false if fn has stopped the walk
+*/
+bool PDFDocEx::forEachEmbeddedPDF(const std::function<bool(PDFDocEx*)>& fn)
+{
+    bool ret{ true };
+    const auto cat{ getCatalog() };
+    if (cat)
+    {
+        Object objNames;
+        const auto catObj{ cat->getCatalogObj() };
+        if (catObj->isDict() && catObj->dictLookup("Names", &objNames)->isDict())
+        {
+            Object objEF;
+            if (objNames.dictLookup("EmbeddedFiles", &objEF)->isDict())
+            {
+                std::vector<int> visited;
+                std::vector<Ref> opened;
+                ret = walkEmbeddedFiles(&objEF, 0, visited, opened, fn);
+            }
+            objEF.free();
+        }
+        objNames.free();
+    }
+    return ret;
+}
+
+/**
+* Walk node of EmbeddedFiles name tree, open PDF documents in Names array, then walk Kids.
+*
+* @param[in]        node        name tree node dictionary
+* @param[in]        depth       depth of node in name tree
+* @param[in,out]    visited     object numbers of visited kids, protection against loops
+* @param[in,out]    opened      references of embedded file streams opened in this walk
+* @param[in]        fn          function called for each embedded PDF document, returns false to stop
+* @return false if fn has stopped the walk
+*/
+bool PDFDocEx::walkEmbeddedFiles(Object* node, int depth, std::vector<int>& visited, std::vector<Ref>& opened, const std::function<bool(PDFDocEx*)>& fn)
+{
+    bool ret{ true };
+    Object objNames;
+    if (node->dictLookup("Names", &objNames)->isArray())
+    {
+        // Names array contains pairs of file name and file specification
+        for (int i{ 1 }; ret && (i < objNames.arrayGetLength()); i += 2)
+        {
+            Object fileSpec;
+            if (objNames.arrayGet(i, &fileSpec)->isDict())
+            {
+                // buffer must outlive the document which reads from it
+                std::vector<char> buffer;
+                const auto doc{ openEmbeddedPDF(&fileSpec, opened, buffer) };
+                if (doc)
+                {
+                    ret = fn(doc.get());
+                }
+            }
+            fileSpec.free();
+        }
+    }
+    objNames.free();
+
+    Object objKids;
+    if ((depth < NAME_TREE_DEPTH_MAX) && node->dictLookup("Kids", &objKids)->isArray())
+    {
+        for (int i{ 0 }; ret && (i < objKids.arrayGetLength()); ++i)
+        {
+            Object kidRef, kid;
+            if (objKids.arrayGetNF(i, &kidRef)->isRef())
+            {
+                const auto num{ kidRef.getRefNum() };
+                if (std::find(visited.cbegin(), visited.cend(), num) != visited.cend())
+                {
+                    kidRef.free();
+                    continue;
+                }
+                visited.push_back(num);
+            }
+            if (objKids.arrayGet(i, &kid)->isDict())
+            {
+                ret = walkEmbeddedFiles(&kid, depth + 1, visited, opened, fn);
+            }
+            kid.free();
+            kidRef.free();
+        }
+    }
+    objKids.free();
+    return ret;
+}
+
+/**
+* Open embedded file as PDF document.
+* Files with other Subtype than application/pdf, or without PDF header, are not decoded.
+* Unfiltered files are read directly from the window of parent document stream,
+* filtered files are decoded to buffer, up to #EMBEDDED_PDF_SIZE_MAX bytes.
+* File stream which has already been opened is skipped, many file specifications may refer
+* to one stream, and each embedded document could repeat that at every nesting level.
+*
+* @param[in]        fileSpec    file specification dictionary
+* @param[in,out]    opened      references of embedded file streams already opened
+* @param[out]       buffer      decoded embedded file, must outlive returned document
+* @return embedded document or nullptr if the file is not a valid PDF document, or if it has been opened already
+*/
+std::unique_ptr<PDFDocEx> PDFDocEx::openEmbeddedPDF(Object* fileSpec, std::vector<Ref>& opened, std::vector<char>& buffer)
+{
+    std::unique_ptr<PDFDocEx> doc;
+    Object objEF, objFile, objRef;
+    if (fileSpec->dictLookup("EF", &objEF)->isDict())
+    {
+        const char* key{ "UF" };
+        if (!objEF.dictLookup(key, &objFile)->isStream())
+        {
+            objFile.free();
+            key = "F";
+            objEF.dictLookup(key, &objFile);
+        }
+        if (objFile.isStream() && objEF.dictLookupNF(key, &objRef)->isRef())
+        {
+            const auto ref{ objRef.getRef() };
+            if (std::any_of(opened.cbegin(), opened.cend(), [&ref](const Ref& r) { return (r.num == ref.num) && (r.gen == ref.gen); }))
+            {
+                objFile.free();
+            }
+            else
+            {
+                opened.push_back(ref);
+            }
+        }
+        objRef.free();
+    }
+    if (objFile.isStream())
+    {
+        const auto str{ objFile.getStream() };
+        Object objSubtype;
+        const auto isPDF{ !str->getDict()->lookup("Subtype", &objSubtype)->isName() || objSubtype.isName("application/pdf") };
+        objSubtype.free();
+
+        // check PDF header, it may be preceded by garbage
+        buffer.resize(EMBEDDED_PDF_HEADER_SIZE);
+        str->reset();
+        const auto n{ isPDF ? str->getBlock(buffer.data(), static_cast<int>(buffer.size())) : 0 };
+        buffer.resize(std::max(n, 0));
+        constexpr char header[]{ "%PDF-" };
+        if (std::search(buffer.cbegin(), buffer.cend(), header, header + sizeof(header) - 1) != buffer.cend())
+        {
+            Object objLength, objNull;
+            const auto base{ str->getBaseStream() };
+            if ((str == base) && str->getDict()->lookup("Length", &objLength)->isInt() && (objLength.getInt() > 0))
+            {
+                // not filtered nor encrypted, read from the parent stream
+                buffer.clear();
+                objNull.initNull();
+                const auto sub{ base->makeSubStream(base->getStart(), gTrue, objLength.getInt(), &objNull) };
+                doc = std::make_unique<PDFDocEx>(static_cast<BaseStream*>(sub));
+            }
+            else
+            {
+                // decode whole file to memory
+                while (!Stream::checkForAbort())
+                {
+                    const auto size{ buffer.size() };
+                    if (size + EMBEDDED_PDF_BLOCK_SIZE > EMBEDDED_PDF_SIZE_MAX)
+                    {
+                        buffer.clear();
+                        break;
+                    }
+                    buffer.resize(size + EMBEDDED_PDF_BLOCK_SIZE);
+                    const auto m{ str->getBlock(buffer.data() + size, static_cast<int>(buffer.size() - size)) };
+                    buffer.resize(size + std::max(m, 0));
+                    if (m <= 0)
+                    {
+                        objNull.initNull();
+                        doc = std::make_unique<PDFDocEx>(new MemStream(buffer.data(), 0, static_cast<Guint>(buffer.size()), &objNull));
+                        break;
+                    }
+                }
+            }
+            objLength.free();
+        }
+        str->close();
+    }
+    objFile.free();
+    objEF.free();
+
+    if (doc && !doc->isOk())
+    {
+        doc.reset();
+    }
+    return doc;
+}
+
 /**
 * PDF document was updated incrementally without rewriting the entire file.
 *
@@ -700,6 +911,57 @@ bool PDFDocEx::pageContentIsEmpty(Page* page)
     return isEmpy;
 }
 
+/**
+* Read resources of pages from file in offset order, before they are checked page by page.
+* Page counters fetch objects in page order, which means random seeks across large files.
+*
+* @param[in]    firstPage   first page
+* @param[in]    lastPage    last page
+* @param[in]    key         resource type, e.g. "Font" or "XObject"
+* @param[in]    entries     prefetch also objects in resource dictionaries
+*/
+void PDFDocEx::prefetchResources(int firstPage, int lastPage, const char* key, bool entries)
+{
+    const auto cat{ getCatalog() };
+    std::vector<Ref> refs;
+    for (int pass{ 0 }; pass < (entries ? 2 : 1); pass++)
+    {
+        refs.clear();
+        for (int i{ firstPage }; i <= lastPage; i++)
+        {
+            const auto page{ cat->getPage(i) };
+            const auto resource{ (page && page->getAttrs()) ? page->getAttrs()->getResourceDict() : nullptr };
+            if (resource)
+            {
+                Object obj;
+                if (pass == 0)
+                {
+                    // resource dictionary
+                    if (resource->lookupNF(key, &obj)->isRef())
+                    {
+                        refs.push_back(obj.getRef());
+                    }
+                }
+                else if (resource->lookup(key, &obj)->isDict())
+                {
+                    // objects in resource dictionary
+                    for (int j{ 0 }; j < obj.dictGetLength(); j++)
+                    {
+                        Object entryObj;
+                        if (obj.dictGetValNF(j, &entryObj)->isRef())
+                        {
+                            refs.push_back(entryObj.getRef());
+                        }
+                        entryObj.free();
+                    }
+                }
+                obj.free();
+            }
+        }
+        getXRef()->prefetch(refs.data(), static_cast<int>(refs.size()));
+    }
+}
+
 /**
 * Get number of pages without Font resource.
 *
@@ -716,6 +978,10 @@ int PDFDocEx::getNumFontlessPages()
         const auto numPages{ getNumPages() };
         for (int i{ 1 }; i <= numPages; i++)
         {
+            if (((i - 1) % PREFETCH_PAGES) == 0)
+            {
+                prefetchResources(i, std::min(i + PREFETCH_PAGES - 1, numPages), "Font", false);
+            }
             const auto page{ cat->getPage(i) };
             if (page)
             {
@@ -791,6 +1057,10 @@ int PDFDocEx::getNumPagesWithImages()
         const auto numPages{ getNumPages() };
         for (int i{ 1 }; i <= numPages; i++)
         {
+            if (((i - 1) % PREFETCH_PAGES) == 0)
+            {
+                prefetchResources(i, std::min(i + PREFETCH_PAGES - 1, numPages), "XObject", true);
+            }
             const auto page{ cat->getPage(i) };
             if (page)
             {
@@ -3,11 +3,21 @@
 #include <Page.h>
 #include <Zoox.h>
 #include <memory>
+#include <functional>
+#include <vector>
+
+constexpr int PREFETCH_PAGES{ 64 };     /**< number of pages whose resources are prefetched at once by page counters */
+
+constexpr int NAME_TREE_DEPTH_MAX{ 32 };                        /**< max depth of EmbeddedFiles name tree */
+constexpr size_t EMBEDDED_PDF_SIZE_MAX{ 256U * 1024U * 1024U }; /**< max size of compressed embedded PDF decoded to memory, in bytes */
+constexpr size_t EMBEDDED_PDF_HEADER_SIZE{ 1024U };             /**< PDF header must be in first 1024 bytes of embedded file */
+constexpr size_t EMBEDDED_PDF_BLOCK_SIZE{ 64U * 1024U };        /**< size of one read of compressed embedded PDF, in bytes */
 
 class PDFDocEx : public PDFDoc
 {
 public:
-    PDFDocEx(const wchar_t *fileNameA, size_t fileNameLen);
+    PDFDocEx(const wchar_t *fileNameA, size_t fileNameLen, bool firstPageOnly = false);
+    explicit PDFDocEx(BaseStream* strA);
     bool hasSignature();
     bool hasOutlines();
     bool hasEmbeddedFiles();
@@ -22,14 +32,18 @@ public:
     GString* getConformance();
     GString* getID();
     double getPDFVersion();
+    bool forEachEmbeddedPDF(const std::function<bool(PDFDocEx*)>& fn);
 
 private:
     static bool getElemOrAttrData(const ZxElement* elem, const char* nodeName, GString& value, const char* prefix);
     static const char* findXmpPrefix(const ZxElement* elem, const char* nsURI);
     static bool pageContentIsEmpty(Page* page);
+    void prefetchResources(int firstPage, int lastPage, const char* key, bool entries);
     GString* getXmpValue(const char* nsURI, const char* key, const char* arrayType);
     void getExtensionValues(Object* objExt, GString& data);
     bool openXMP();
+    bool walkEmbeddedFiles(Object* node, int depth, std::vector<int>& visited, std::vector<Ref>& opened, const std::function<bool(PDFDocEx*)>& fn);
+    std::unique_ptr<PDFDocEx> openEmbeddedPDF(Object* fileSpec, std::vector<Ref>& opened, std::vector<char>& buffer);
 
     std::unique_ptr<ZxDoc> m_xmp{ nullptr };
     bool m_xmpChecked{ false };
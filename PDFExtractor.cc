@@ -1,9 +1,13 @@
 #include "PDFExtractor.hh"
 #include <CharTypes.h>
 #include "xPDFInfo.hh"
+#include "RevisionDiff.hh"
+#include "DocReclaimer.hh"
 #include <locale.h>
 #include <wchar.h>
 #include <charconv>
+#include <algorithm>
+#include <strsafe.h>
 
 /**
 * @file
@@ -99,7 +103,8 @@ PDFExtractor::~PDFExtractor()
 void PDFExtractor::closeDoc()
 {
     m_data->setStatus(requestStatus::closed);
-    m_doc.reset();
+    // file is closed now, the rest of the document is destroyed in background
+    DocReclaimer::reclaim(std::move(m_doc));
 }
 
 /**
@@ -112,10 +117,44 @@ void PDFExtractor::close()
     closeDoc();
 }
 
+/**
+* Check if field needs only the beginning of document text.
+*
+* @param[in]    field   index of the field
+* @return true for #fiFirstRow and #fiDocStart
+*/
+bool PDFExtractor::isFirstPageField(int field)
+{
+    return (field == fiFirstRow) || (field == fiDocStart);
+}
+
+/**
+* Create PDFDoc for #m_fileName.
+* Linearized document can be opened only with its first page, without reading
+* the main xref table and page tree at the end of the file.
+* If document is not linearized, or its first page section is not valid, it is opened normally.
+*
+* @param[in]    firstPageOnly   try to open only the first page of linearized document
+*/
+void PDFExtractor::openDoc(bool firstPageOnly)
+{
+    if (firstPageOnly)
+    {
+        m_doc = std::make_unique<PDFDocEx>(m_fileName.c_str(), m_fileName.size(), true);
+        if (m_doc->isOk())
+        {
+            return;
+        }
+    }
+    m_doc = std::make_unique<PDFDocEx>(m_fileName.c_str(), m_fileName.size());
+}
+
 /**
 * Open new PDF document if requested file is different than open one.
 * Close PDF if requested file name is nullptr.
 * Set Request::status to active if new document has been open successfuly.
+* #fiFirstRow and #fiDocStart open only the first page of linearized document,
+* document is opened again as a whole for other fields.
 *
 * @return true if PdfDoc is valid
 */
@@ -153,6 +192,10 @@ bool PDFExtractor::open()
             m_fileName = std::move(requestFileName);
             newFile = true;
         }
+        else if (m_doc && m_doc->isFirstPageOnly() && !isFirstPageField(m_data->getRequestField()))
+        {
+            newFile = true;
+        }
     }
 
     if (newFile)
@@ -161,7 +204,7 @@ bool PDFExtractor::open()
         if (!m_fileName.empty())
         {
             m_data->setStatus(requestStatus::active);
-            m_doc = std::make_unique<PDFDocEx>(m_fileName.c_str(), m_fileName.size());
+            openDoc(isFirstPageField(m_data->getRequestField()));
             TRACE(L"%hs!%ls\n", __FUNCTION__, m_fileName.c_str());
         }
 
@@ -692,7 +735,46 @@ void PDFExtractor::doWork()
     case fiFirstRow:
         [[fallthrough]];
     case fiText:
-        m_tc.output(m_doc.get(), m_data.get());
+        // skip documents which have already exceeded a resource limit
+        if (!ResourceGovernor::isFlagged(m_fileName.c_str()))
+        {
+            // compare of two revisions extracts only pages which can differ, see RevisionDiff
+            const auto pages{ (field == fiText) ? m_data->getRequestPages() : std::vector<int>() };
+            if (!pages.empty())
+            {
+                m_tc.outputPages(m_doc.get(), m_data.get(), pages);
+            }
+            else
+            {
+                m_tc.output(m_doc.get(), m_data.get(), (field == fiText) ? m_data->getRequestFirstPage() : 1);
+                // text of the first page is not enough, continue with next pages of whole document
+                if (m_doc->isFirstPageOnly() && (requestStatus::active == m_data->getStatus()) && !m_tc.limitExceeded())
+                {
+                    auto doc{ std::make_unique<PDFDocEx>(m_fileName.c_str(), m_fileName.size()) };
+                    if (doc->isOk())
+                    {
+                        // document opened for the first page is destroyed in background, see closeDoc
+                        DocReclaimer::reclaim(std::move(m_doc));
+                        m_doc = std::move(doc);
+                        m_tc.output(m_doc.get(), m_data.get(), 2, true);
+                    }
+                }
+                // text of XFA form data follows the text of pages
+                if ((field == fiText) && globalOptionsFromIni.extractXFAData && (requestStatus::active == m_data->getStatus()) && !m_tc.limitExceeded())
+                {
+                    m_tc.outputXFAData(m_doc.get(), m_data.get());
+                }
+                // text of embedded PDF documents follows the text of parent document
+                if ((field == fiText) && globalOptionsFromIni.searchEmbeddedFiles && (requestStatus::active == m_data->getStatus()) && !m_tc.limitExceeded())
+                {
+                    m_tc.outputEmbeddedFiles(m_doc.get(), m_data.get(), std::min(globalOptionsFromIni.searchEmbeddedFiles, EMBEDDED_DEPTH_MAX));
+                }
+            }
+            if (m_tc.shouldFlag())
+            {
+                ResourceGovernor::flag(m_fileName.c_str());
+            }
+        }
         break;
     case fiNumberOfPages:
         m_data->setValue(m_doc->getNumPages(), ft_numeric_32);
@@ -798,8 +880,8 @@ void PDFExtractor::waitForProducer()
     while (m_data->isActive())
     {
         // !!! producer idle point !!!
-        const auto dwRet{ m_data->waitForProducer(timeout) };
-        if (dwRet == WAIT_OBJECT_0)
+        const auto ret{ m_data->waitForProducer(timeout) };
+        if (ret == waitResult::signaled)
         {
             auto status{ m_data->getStatus() };
             if ((status != requestStatus::cancelled) && (status != requestStatus::complete) && open())
@@ -827,11 +909,11 @@ void PDFExtractor::waitForProducer()
 
             timeout = PRODUCER_TIMEOUT;
         }
-        else if (dwRet == WAIT_TIMEOUT)
+        else if (ret == waitResult::timeout)
         {
             // if there are no new requests, close PDFDoc and wait
             close();
-            timeout = INFINITE;
+            timeout = INFINITE_TIMEOUT;
         }
         else
         {
@@ -849,9 +931,8 @@ void PDFExtractor::waitForProducer()
 * Pointer to PDFExtractor object (this) is passed in function parameter.
 * 
 * @param[in]    param   pointer to PDFExtractor object (this)
-* @return 0
 */
-unsigned int __stdcall threadFunc(void* param)
+static void threadFunc(void* param)
 {
     auto extractor{ static_cast<PDFExtractor*>(param) };
     TRACE(L"%hs!worker thread start\n", __FUNCTION__);
@@ -860,18 +941,14 @@ unsigned int __stdcall threadFunc(void* param)
         extractor->waitForProducer();
     }
     TRACE(L"%hs!worker thread end\n", __FUNCTION__);
-    _endthreadex(0);
-
-    return 0;
 }
 
 /**
 * Start extraction thread, if not already started.
-* Create unnamed events with automatic reset.
 *
-* @return thread ID number
+* @return true if extraction thread is running
 */
-uint32_t PDFExtractor::startWorkerThread()
+bool PDFExtractor::startWorkerThread()
 {
     return m_data->start(threadFunc, this);
 }
@@ -885,20 +962,20 @@ uint32_t PDFExtractor::startWorkerThread()
 * @param[in]    timeout time to wait for Consumer signal in miliseconds
 * @return result of an extraction, #ft_timeout if consumer did not send signal, #ft_fileerror if error
 */
-int PDFExtractor::waitForConsumer(DWORD timeout)
+int PDFExtractor::waitForConsumer(uint32_t timeout)
 {
     auto result{ ft_fileerror };
-    const auto dwRet{ m_data->notifyProducerWaitForConsumer(timeout) };
-    switch (dwRet)
+    const auto ret{ m_data->notifyProducerWaitForConsumer(timeout) };
+    switch (ret)
     {
-    case WAIT_OBJECT_0:
+    case waitResult::signaled:
         result = ft_setsuccess;
         break;
-    case WAIT_TIMEOUT:
+    case waitResult::timeout:
         result = ft_timeout;
         break;
     default:
-        TRACE(L"%hs!%ls!ret=%lx err=%lu\n", __FUNCTION__, dwRet, GetLastError());
+        TRACE(L"%hs!ret=%d\n", __FUNCTION__, static_cast<int>(ret));
         m_data->setStatusCond(requestStatus::cancelled, requestStatus::active);
         break;
     }
@@ -918,7 +995,7 @@ int PDFExtractor::waitForConsumer(DWORD timeout)
 * @param[in]    timeout         producer timeout (in text extraction)
 * @return       ft_fieldempty if data cannot be set, ft_setsuccess if successfuly set
 */
-int PDFExtractor::initData(const wchar_t* fileName, int field, int unit, int flags, DWORD timeout)
+int PDFExtractor::initData(const wchar_t* fileName, int field, int unit, int flags, uint32_t timeout)
 {
     auto retval{ ft_fieldempty };
     const auto fiTextOrOutlines{ (field == fiText) || (field == fiOutlines) };
@@ -959,9 +1036,10 @@ int PDFExtractor::initData(const wchar_t* fileName, int field, int unit, int fla
 * @param[out]   dst             buffer for retrieved data
 * @param[in]    dstSize         sizeof dst buffer in bytes (NUL char for stringw and fulltextw included)
 * @param[in]    flags           TC flags
+* @param[in]    firstPage       page to start #fiText extraction from, used with unit 0
 * @return       result of an extraction
 */
-int PDFExtractor::extract(const wchar_t* fileName, int field, int unit, void* dst, int dstSize, int flags)
+int PDFExtractor::extract(const wchar_t* fileName, int field, int unit, void* dst, int dstSize, int flags, int firstPage)
 {
     auto result{ initData(fileName, field, unit, flags, PRODUCER_TIMEOUT) };
     if (result != ft_fieldempty)
@@ -971,6 +1049,10 @@ int PDFExtractor::extract(const wchar_t* fileName, int field, int unit, void* ds
         {
             if (unit == 0)
             {
+                if ((field == fiText) && (firstPage > 1))
+                {
+                    m_data->setRequestFirstPage(firstPage);
+                }
                 m_data->setStatusCond(requestStatus::active, requestStatus::complete);
                 if (startWorkerThread())
                 {
@@ -1140,6 +1222,21 @@ int PDFExtractor::compare(PROGRESSCALLBACKPROC progresscallback, const wchar_t*
     size_t bytesProcessed{ 0U };
     auto eqTxt{ false };
 
+    // text of pages which are identical in two revisions of a document is not compared
+    std::vector<int> changedPages;
+    if ((field == fiText) && globalOptionsFromIni.compareRevisions)
+    {
+        RevisionDiff revisions;
+        if (revisions.analyze(fileName1, fileName2))
+        {
+            if (revisions.isIdentical() || revisions.getChangedPages().empty())
+            {
+                return ft_compare_eq;
+            }
+            changedPages = revisions.getChangedPages();
+        }
+    }
+
     // set timeout to long wait, because it waits for another extraction thread
     auto result{ initData(fileName1, field, 0, 0, CONSUMER_TIMEOUT) };
     if (result != ft_setsuccess)
@@ -1158,6 +1255,11 @@ int PDFExtractor::compare(PROGRESSCALLBACKPROC progresscallback, const wchar_t*
     {
         return ft_compare_next;
     }
+    if (!changedPages.empty())
+    {
+        m_data->setRequestPages(changedPages);
+        m_search->m_data->setRequestPages(changedPages);
+    }
 
     // start threads
     if (startWorkerThread() && m_search->startWorkerThread())
@@ -39,7 +39,7 @@ public:
     PDFExtractor(const PDFExtractor&) = delete;
     PDFExtractor& operator=(const PDFExtractor&) = delete;
     ~PDFExtractor();
-    int extract(const wchar_t* fileName, int field, int unit, void* dst, int dstSize, int flags);
+    int extract(const wchar_t* fileName, int field, int unit, void* dst, int dstSize, int flags, int firstPage = 1);
     int compare(PROGRESSCALLBACKPROC progresscallback, const wchar_t* fileName1, const wchar_t* fileName2, int field);
     void abort();
     void stop();
@@ -57,21 +57,23 @@ private:
     void getConformance();
     void getExtensions();
 
+    static bool isFirstPageField(int field);
     static double getPaperSize(int units);
     static size_t removeDelimiters(wchar_t* str, size_t cchStr, const wchar_t* delims);
     static bool dateToInt(const char* date, uint8_t len, uint16_t& result);
     static bool PdfDateTimeToFileTime(const GString& pdfDateTime, FILETIME& fileTime);
-    int initData(const wchar_t* fileName, int field, int unit, int flags, DWORD timeout);
+    int initData(const wchar_t* fileName, int field, int unit, int flags, uint32_t timeout);
 
-    uint32_t startWorkerThread();
-    int waitForConsumer(DWORD timeout);
+    bool startWorkerThread();
+    int waitForConsumer(uint32_t timeout);
     bool open();
+    void openDoc(bool firstPageOnly);
     void close();
     void closeDoc();
     void doWork();
     void done();
 
-    std::unique_ptr<ThreadData>     m_data{ std::make_unique<ThreadData>() };      /**< pointer to thread data, request    */
+    std::unique_ptr<ThreadData>     m_data{ std::make_unique<ThreadData>(globalParams->getTextEOL()) };   /**< pointer to thread data, request    */
     std::unique_ptr<PDFExtractor>   m_search{ nullptr };        /**< pointer to second instance of PDFExtractor, used to extract data from second file when comparing data */
     std::unique_ptr<PDFDocEx>       m_doc{ nullptr };           /**< pointer to PDFDoc object   */
     ScopedCollateLocale             m_locale{ };                /**< locale-specific value, used for compare as text */
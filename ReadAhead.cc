@@ -0,0 +1,217 @@
+/**
+* @file
+*
+* Asynchronous read ahead of content streams of the next page.
+*/
+
+#include "ReadAhead.hh"
+#include "xPDFInfo.hh"
+#include <Catalog.h>
+#include <Page.h>
+#include <share.h>
+#include <algorithm>
+#include <vector>
+
+/**
+* Destructor, stop read ahead thread if it is still running.
+* Destructor may be called from DllMain, where a running thread can't be joined,
+* read ahead thread is detached, not joined, see ThreadData::closeWorker.
+* If it doesn't exit in time, it is left to finish on its own with its own reference to #State.
+*/
+ReadAhead::~ReadAhead()
+{
+    {
+        std::lock_guard lock(m_state->mutex);
+        m_state->stop = true;
+        m_state->ranges.clear();
+        m_state->cv.notify_all();
+    }
+    if (m_thread.joinable())
+    {
+        m_state->exit.wait(PRODUCER_TIMEOUT);
+        m_thread.detach();
+    }
+}
+
+/**
+* Start read ahead thread, if not already started.
+* Must be called with State::mutex locked.
+*
+* @return true if read ahead thread is running
+*/
+bool ReadAhead::start()
+{
+    if (!m_thread.joinable())
+    {
+        m_thread = std::thread([state = m_state]()
+        {
+            TRACE(L"%hs!read ahead thread start\n", __FUNCTION__);
+            run(*state);
+            TRACE(L"%hs!read ahead thread end\n", __FUNCTION__);
+            state->exit.set();
+        });
+    }
+    return m_thread.joinable();
+}
+
+/**
+* Read ahead thread main function.
+* Ranges are read in blocks of #READ_AHEAD_BLOCK_SIZE, so new pages and #cancel are checked between blocks.
+* File is closed when there is nothing to read, so it can be renamed or deleted in TC.
+*
+* @param[in,out]    state   state shared with ReadAhead
+*/
+void ReadAhead::run(State& state)
+{
+    std::vector<char> buffer(READ_AHEAD_BLOCK_SIZE);
+    std::unique_lock lock(state.mutex);
+    while (!state.stop)
+    {
+        if (state.ranges.empty())
+        {
+            lock.unlock();
+            openFile(state, std::wstring());
+            lock.lock();
+            state.cv.wait(lock, [&state] { return state.stop || !state.ranges.empty(); });
+            continue;
+        }
+
+        auto range{ state.ranges.front() };
+        state.ranges.pop_front();
+        const auto fileName{ state.fileName };
+        const auto size{ static_cast<size_t>(std::min<GFileOffset>(range.length, READ_AHEAD_BLOCK_SIZE)) };
+        if (range.length > static_cast<GFileOffset>(size))
+        {
+            state.ranges.push_front({ range.start + static_cast<GFileOffset>(size), range.length - static_cast<GFileOffset>(size) });
+        }
+        lock.unlock();
+
+        if (!openFile(state, fileName)
+            || _fseeki64(state.file, range.start, SEEK_SET)
+            || (fread(buffer.data(), 1, size, state.file) != size))
+        {
+            // file can't be read, drop its ranges
+            lock.lock();
+            if (fileName == state.fileName)
+            {
+                state.ranges.clear();
+            }
+            continue;
+        }
+        lock.lock();
+    }
+    lock.unlock();
+    openFile(state, std::wstring());
+}
+
+/**
+* Open file in read ahead thread, close previous one.
+* Must be called only from read ahead thread.
+*
+* @param[in,out]    state       state shared with ReadAhead
+* @param[in]        fileName    file to open, empty to close file
+* @return true if file is open
+*/
+bool ReadAhead::openFile(State& state, const std::wstring& fileName)
+{
+    if (state.file && (fileName == state.openFileName))
+    {
+        return true;
+    }
+    if (state.file)
+    {
+        fclose(state.file);
+        state.file = nullptr;
+    }
+    state.openFileName = fileName;
+    if (!fileName.empty())
+    {
+        state.file = _wfsopen(fileName.c_str(), L"rb", _SH_DENYNO);
+        if (state.file)
+        {
+            // data is discarded, don't copy it to stdio buffer
+            setvbuf(state.file, nullptr, _IONBF, 0);
+        }
+    }
+    return state.file != nullptr;
+}
+
+/**
+* Add range of stream data to read ahead.
+*
+* @param[in]        obj     stream object
+* @param[in,out]    ranges  ranges of the page
+* @param[in,out]    size    size of ranges of the page, in bytes
+*/
+void ReadAhead::queueStream(Object* obj, std::deque<Range>& ranges, GFileOffset& size)
+{
+    const auto limit{ static_cast<GFileOffset>(globalOptionsFromIni.readAheadSize) * 1024 * 1024 };
+    if (obj->isStream() && (size < limit))
+    {
+        const auto base{ obj->getStream()->getBaseStream() };
+        Object lenObj;
+        if (base && (base->getKind() == strFile)
+            && obj->streamGetDict()->lookup("Length", &lenObj)->isInt() && (lenObj.getInt() > 0))
+        {
+            const auto length{ std::min<GFileOffset>(lenObj.getInt(), limit - size) };
+            ranges.push_back({ base->getStart(), length });
+            size += length;
+        }
+        lenObj.free();
+    }
+}
+
+/**
+* Queue content streams of a page for read ahead.
+* Ranges of previously queued page, which have not been read yet, are dropped.
+*
+* @param[in]    doc     PDF document
+* @param[in]    page    page number
+*/
+void ReadAhead::queuePage(PDFDoc* doc, int page)
+{
+    if (!globalOptionsFromIni.readAheadSize || !doc || !doc->getFileNameU() || (page < 1) || (page > doc->getNumPages()))
+    {
+        return;
+    }
+    const auto pageObj{ doc->getCatalog()->getPage(page) };
+    if (!pageObj)
+    {
+        return;
+    }
+
+    std::deque<Range> ranges;
+    GFileOffset size{ 0 };
+    Object contents;
+    if (pageObj->getContents(&contents)->isArray())
+    {
+        for (int i{ 0 }; i < contents.arrayGetLength(); i++)
+        {
+            Object obj;
+            queueStream(contents.arrayGet(i, &obj), ranges, size);
+            obj.free();
+        }
+    }
+    else
+    {
+        queueStream(&contents, ranges, size);
+    }
+    contents.free();
+
+    std::lock_guard lock(m_state->mutex);
+    m_state->fileName.assign(doc->getFileNameU());
+    m_state->ranges = std::move(ranges);
+    if (!m_state->ranges.empty() && start())
+    {
+        m_state->cv.notify_all();
+    }
+}
+
+/**
+* Drop ranges which have not been read yet.
+*/
+void ReadAhead::cancel()
+{
+    std::lock_guard lock(m_state->mutex);
+    m_state->ranges.clear();
+}
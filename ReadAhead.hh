@@ -0,0 +1,69 @@
+/**
+* @file
+*
+* ReadAhead class declaration.
+*/
+
+#pragma once
+
+#include "ThreadData.hh"
+#include <string>
+#include <deque>
+#include <cstdio>
+#include <memory>
+
+constexpr size_t READ_AHEAD_BLOCK_SIZE{ 256U * 1024U };    /**< size of one read of read ahead thread, in bytes */
+
+/**
+* Asynchronous read ahead of content streams of the next page.
+* Content streams are read and decoded on demand, while the page is interpreted,
+* so text extraction waits for each read, and disk or network is idle while the page is interpreted.
+* While a page is extracted, content streams of the next page are read by a worker thread
+* with its own file handle, so they are in the file system cache when extraction gets to them.
+* Data read ahead is discarded.
+*/
+class ReadAhead
+{
+public:
+    ReadAhead() = default;
+    ReadAhead(const ReadAhead&) = delete;
+    ReadAhead& operator=(const ReadAhead&) = delete;
+    ~ReadAhead();
+
+    void queuePage(PDFDoc* doc, int page);
+    void cancel();
+
+private:
+    /**
+    * Range of file to read
+    */
+    struct Range
+    {
+        GFileOffset     start{ 0 };     /**< file offset */
+        GFileOffset     length{ 0 };    /**< number of bytes */
+    };
+
+    /**
+    * State shared with read ahead thread.
+    * Thread is detached when ReadAhead is destroyed, so it keeps its own reference to the state.
+    */
+    struct State
+    {
+        std::mutex                  mutex;                  /**< protects all members except #file and #openFileName */
+        std::condition_variable     cv;                     /**< signals new ranges or thread exit */
+        std::deque<Range>           ranges;                 /**< ranges waiting for read ahead */
+        std::wstring                fileName;               /**< file of queued ranges */
+        std::wstring                openFileName;           /**< file open in read ahead thread, used only by the thread */
+        FILE*                       file{ nullptr };        /**< file handle of read ahead thread, used only by the thread */
+        bool                        stop{ false };          /**< read ahead thread should exit */
+        SyncEvent                   exit;                   /**< raised by read ahead thread before it exits */
+    };
+
+    bool start();
+    static void run(State& state);
+    static bool openFile(State& state, const std::wstring& fileName);
+    void queueStream(Object* obj, std::deque<Range>& ranges, GFileOffset& size);
+
+    std::shared_ptr<State>      m_state{ std::make_shared<State>() };   /**< state shared with read ahead thread */
+    std::thread                 m_thread;                               /**< read ahead thread */
+};
@@ -0,0 +1,93 @@
+/**
+* @file
+*
+* Priority scheduling between interactive and bulk requests.
+*/
+
+#include "RequestScheduler.hh"
+#include "xPDFInfo.hh"
+
+static std::mutex schedulerMutex;               /**< protects #interactiveRequests */
+static std::condition_variable schedulerCv;     /**< signals end of interactive requests */
+static unsigned interactiveRequests{ 0 };       /**< number of interactive requests in progress */
+
+/**
+* Check if request is a bulk request.
+*
+* @param[in]    field   index of the field
+* @return true for full text fields used by TC search
+*/
+bool RequestScheduler::isBulk(int field)
+{
+    return (field == fiText) || (field == fiOutlines);
+}
+
+/**
+* Check if request is an interactive request, which pauses bulk extraction.
+* Page counters interpret every page, they would stall search as long as they run.
+*
+* @param[in]    field   index of the field
+* @return true for cheap column values
+*/
+bool RequestScheduler::isInteractive(int field)
+{
+    switch (field)
+    {
+    case fiNumberOfFontlessPages:
+        [[fallthrough]];
+    case fiNumberOfPagesWithImages:
+        return false;
+    default:
+        return !isBulk(field);
+    }
+}
+
+/**
+* Mark start of an interactive request.
+*/
+void RequestScheduler::beginInteractive()
+{
+    std::lock_guard lock(schedulerMutex);
+    ++interactiveRequests;
+}
+
+/**
+* Mark end of an interactive request, wake up waiting bulk extractions.
+*/
+void RequestScheduler::endInteractive()
+{
+    std::lock_guard lock(schedulerMutex);
+    if (interactiveRequests > 0)
+    {
+        --interactiveRequests;
+    }
+    if (interactiveRequests == 0)
+    {
+        schedulerCv.notify_all();
+    }
+}
+
+/**
+* Called by bulk extraction at page boundary.
+* Wait while interactive requests are in progress, at most #SCHEDULER_YIELD_TIMEOUT.
+* Wait ends immediately if request is no longer active, e.g. it has been stopped by TC.
+*
+* @param[in]    data    request data of bulk extraction
+* @return time spent waiting
+*/
+std::chrono::steady_clock::duration RequestScheduler::yield(ThreadData* data)
+{
+    const auto start{ std::chrono::steady_clock::now() };
+    const auto deadline{ start + std::chrono::milliseconds(SCHEDULER_YIELD_TIMEOUT) };
+    std::unique_lock lock(schedulerMutex);
+    while ((interactiveRequests > 0) && data && (requestStatus::active == data->getStatus()))
+    {
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            TRACE(L"%hs!timeout\n", __FUNCTION__);
+            break;
+        }
+        schedulerCv.wait_for(lock, std::chrono::milliseconds(SCHEDULER_YIELD_STEP));
+    }
+    return std::chrono::steady_clock::now() - start;
+}
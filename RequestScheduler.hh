@@ -0,0 +1,58 @@
+/**
+* @file
+*
+* RequestScheduler class declaration.
+*/
+
+#pragma once
+
+#include "ThreadData.hh"
+#include <chrono>
+
+constexpr uint32_t SCHEDULER_YIELD_TIMEOUT{ 1000U };    /**< max time bulk extraction waits for interactive requests at one page boundary, in miliseconds */
+constexpr uint32_t SCHEDULER_YIELD_STEP{ 10U };         /**< interval of request status checks while bulk extraction waits, in miliseconds */
+
+/**
+* Priority scheduling between interactive and bulk requests.
+* Interactive requests are cheap column values of files shown in TC (metadata, first row).
+* Page counters check every page, they are neither interactive nor bulk, and don't pause bulk extraction.
+* Bulk requests are full text fields used by TC search (#fiText, #fiOutlines).
+* Each TC thread has its own PDFExtractor, so requests don't wait for each other,
+* but they compete for CPU and disk. While an interactive request is in progress,
+* bulk text extraction pauses at page boundaries, so the file list stays responsive during search.
+*/
+class RequestScheduler
+{
+public:
+    static bool isBulk(int field);
+    static bool isInteractive(int field);
+    static void beginInteractive();
+    static void endInteractive();
+    static std::chrono::steady_clock::duration yield(ThreadData* data);
+};
+
+/**
+* RAII wrapper marking interactive request in progress.
+*/
+class ScopedInteractiveRequest
+{
+private:
+    bool _interactive{ false };
+public:
+    explicit ScopedInteractiveRequest(int field) : _interactive(RequestScheduler::isInteractive(field))
+    {
+        if (_interactive)
+        {
+            RequestScheduler::beginInteractive();
+        }
+    }
+    ScopedInteractiveRequest(const ScopedInteractiveRequest&) = delete;
+    ScopedInteractiveRequest& operator=(const ScopedInteractiveRequest&) = delete;
+    ~ScopedInteractiveRequest()
+    {
+        if (_interactive)
+        {
+            RequestScheduler::endInteractive();
+        }
+    }
+};
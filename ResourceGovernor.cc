@@ -0,0 +1,181 @@
+/**
+* @file
+*
+* Limits of resources used by text extraction from one document.
+*/
+
+#include "ResourceGovernor.hh"
+#include "xPDFInfo.hh"
+#include <Gfx.h>
+#include <Stream.h>
+#include <psapi.h>
+#include <list>
+#include <algorithm>
+
+constexpr uint32_t HEAP_CHECK_INTERVAL{ 64U };  /**< number of abort checks between two checks of process memory */
+constexpr size_t MEGABYTE{ 1024U * 1024U };     /**< bytes in MB */
+
+static std::mutex flaggedMutex;                 /**< protects #flaggedFiles */
+static std::list<std::wstring> flaggedFiles;    /**< documents which exceeded a limit, oldest first */
+
+/**
+* Get private memory of plugin process.
+* Memory is measured for the whole process, so extraction in other threads is counted too.
+*
+* @return private bytes of the process, 0 on error
+*/
+size_t ResourceGovernor::getPrivateBytes()
+{
+    PROCESS_MEMORY_COUNTERS_EX pmc{ };
+    pmc.cb = sizeof(pmc);
+    if (GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&pmc), sizeof(pmc)))
+    {
+        return pmc.PrivateUsage;
+    }
+    return 0;
+}
+
+/**
+* Start measurement of resources used by extraction.
+* Must be called from extraction thread, operator and decoded size counters are per thread.
+*
+* @param[in]    data    request data, nullptr if extraction doesn't serve a request, e.g. in SearchPrefetcher
+* @param[in]    dev     text extractor
+*/
+void ResourceGovernor::start(ThreadData* data, TextOutputDev* dev)
+{
+    m_data = data;
+    m_dev = dev;
+    m_start = std::chrono::steady_clock::now();
+    m_outputWait = data ? data->getOutputWaitTime() : std::chrono::steady_clock::duration{ };
+    m_opCount = Gfx::getOpCount();
+    m_decodedSize = Stream::getDecodedSize();
+    m_privateBytes = globalOptionsFromIni.maxHeapGrowth ? getPrivateBytes() : 0;
+    m_checks = 0;
+    m_limit = resourceLimit::none;
+}
+
+/**
+* Check resources used since #start against limits from ini file.
+* Time spent waiting for TC to take the extracted text is not counted.
+*
+* @return exceeded limit, resourceLimit::none if no limit is exceeded
+*/
+resourceLimit ResourceGovernor::checkLimits()
+{
+    const auto& options{ globalOptionsFromIni };
+    if (options.maxExtractionTime)
+    {
+        auto busy{ std::chrono::steady_clock::now() - m_start };
+        if (m_data)
+        {
+            busy -= m_data->getOutputWaitTime() - m_outputWait;
+        }
+        if (std::chrono::duration_cast<std::chrono::milliseconds>(busy).count() > options.maxExtractionTime)
+        {
+            TRACE(L"%hs!time limit exceeded\n", __FUNCTION__);
+            return resourceLimit::time;
+        }
+    }
+
+    if (options.maxOperators && (Gfx::getOpCount() - m_opCount > options.maxOperators))
+    {
+        TRACE(L"%hs!operator limit exceeded\n", __FUNCTION__);
+        return resourceLimit::operators;
+    }
+
+    if (options.maxDecodedSize && (Stream::getDecodedSize() - m_decodedSize > options.maxDecodedSize * MEGABYTE))
+    {
+        TRACE(L"%hs!decoded size limit exceeded\n", __FUNCTION__);
+        return resourceLimit::decodedSize;
+    }
+
+    if (options.maxGlyphs && m_dev
+        && (static_cast<uint32_t>(m_dev->getNumVisibleChars() + m_dev->getNumInvisibleChars()) > options.maxGlyphs))
+    {
+        TRACE(L"%hs!glyph limit exceeded\n", __FUNCTION__);
+        return resourceLimit::glyphs;
+    }
+
+    if (options.maxHeapGrowth && (++m_checks >= HEAP_CHECK_INTERVAL))
+    {
+        m_checks = 0;
+        const auto privateBytes{ getPrivateBytes() };
+        if ((privateBytes > m_privateBytes) && (privateBytes - m_privateBytes > options.maxHeapGrowth * MEGABYTE))
+        {
+            TRACE(L"%hs!heap limit exceeded\n", __FUNCTION__);
+            return resourceLimit::heap;
+        }
+    }
+
+    return resourceLimit::none;
+}
+
+/**
+* Check if extraction should abort.
+* Extraction aborts if request is not active anymore, or if a limit is exceeded.
+*
+* @return true if extraction should abort
+*/
+bool ResourceGovernor::shouldAbort()
+{
+    if (m_data && (requestStatus::active != m_data->getStatus()))
+    {
+        return true;
+    }
+
+    if (!exceeded())
+    {
+        m_limit = checkLimits();
+    }
+    return exceeded();
+}
+
+/**
+* Remember document which exceeded a limit.
+* If there are too many flagged documents, the oldest one is forgotten.
+*
+* @param[in]    fileName    full path to PDF document
+*/
+void ResourceGovernor::flag(const wchar_t* fileName)
+{
+    if (fileName && !isFlagged(fileName))
+    {
+        std::lock_guard lock(flaggedMutex);
+        if (flaggedFiles.size() >= FLAGGED_FILES_SIZE)
+        {
+            flaggedFiles.pop_front();
+        }
+        flaggedFiles.emplace_back(fileName);
+        TRACE(L"%hs!%ls\n", __FUNCTION__, fileName);
+    }
+}
+
+/**
+* Check if document has exceeded a limit.
+*
+* @param[in]    fileName    full path to PDF document
+* @return true if document is flagged
+*/
+bool ResourceGovernor::isFlagged(const wchar_t* fileName)
+{
+    if (!fileName)
+    {
+        return false;
+    }
+
+    std::lock_guard lock(flaggedMutex);
+    return std::any_of(flaggedFiles.cbegin(), flaggedFiles.cend(), [fileName](const std::wstring& flagged)
+    {
+        return !wcsicmp(flagged.c_str(), fileName);
+    });
+}
+
+/**
+* Forget all flagged documents, e.g. when TC reads a new directory.
+*/
+void ResourceGovernor::clearFlags()
+{
+    std::lock_guard lock(flaggedMutex);
+    flaggedFiles.clear();
+}
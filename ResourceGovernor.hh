@@ -0,0 +1,68 @@
+/**
+* @file
+*
+* ResourceGovernor class declaration.
+*/
+
+#pragma once
+
+#include "ThreadData.hh"
+#include <string>
+#include <chrono>
+
+constexpr size_t FLAGGED_FILES_SIZE{ 64U };     /**< max number of remembered documents which exceeded a limit */
+
+/**
+* Resource limit exceeded by text extraction
+*/
+enum class resourceLimit
+{
+    none,           /**< no limit has been exceeded */
+    time,           /**< MaxExtractionTime */
+    operators,      /**< MaxOperators */
+    decodedSize,    /**< MaxDecodedSize */
+    glyphs,         /**< MaxGlyphs */
+    heap,           /**< MaxHeapGrowth */
+};
+
+/**
+* Limits of resources used by text extraction from one document.
+* Limits are set in ini file, 0 means unlimited.
+* Limits are checked from xpdf abort callback. When a limit is exceeded, extraction stops
+* with the text extracted so far, and the document is flagged, so next requests skip it.
+* Heap growth is measured for the whole process, it stops extraction but doesn't flag the document.
+*/
+class ResourceGovernor
+{
+public:
+    ResourceGovernor() = default;
+    ResourceGovernor(const ResourceGovernor&) = delete;
+    ResourceGovernor& operator=(const ResourceGovernor&) = delete;
+
+    void start(ThreadData* data, TextOutputDev* dev);
+    /** Don't count time when extraction is paused, e.g. by RequestScheduler::yield */
+    void pause(std::chrono::steady_clock::duration paused) { m_start += paused; }
+    bool shouldAbort();
+    /** @return true if a limit has been exceeded since last #start */
+    bool exceeded() const { return m_limit != resourceLimit::none; }
+    /** @return true if a limit of the document has been exceeded since last #start, next requests should skip it */
+    bool shouldFlag() const { return exceeded() && (m_limit != resourceLimit::heap); }
+
+    static void flag(const wchar_t* fileName);
+    static bool isFlagged(const wchar_t* fileName);
+    static void clearFlags();
+
+private:
+    resourceLimit checkLimits();
+    static size_t getPrivateBytes();
+
+    ThreadData*                             m_data{ nullptr };      /**< request data, extraction aborts if request is not active */
+    TextOutputDev*                          m_dev{ nullptr };       /**< text extractor, source of page glyph count */
+    std::chrono::steady_clock::time_point   m_start{ };             /**< time when extraction started */
+    std::chrono::steady_clock::duration     m_outputWait{ };        /**< time waited for TC before extraction, see ThreadData::getOutputWaitTime */
+    unsigned long long                      m_opCount{ 0 };         /**< number of operators executed in this thread before extraction */
+    unsigned long long                      m_decodedSize{ 0 };     /**< number of bytes decoded in this thread before extraction */
+    size_t                                  m_privateBytes{ 0 };    /**< process private bytes before extraction */
+    uint32_t                                m_checks{ 0 };          /**< number of abort checks since last heap check */
+    resourceLimit                           m_limit{ resourceLimit::none }; /**< exceeded limit */
+};
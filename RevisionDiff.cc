@@ -0,0 +1,576 @@
+/**
+* @file
+*
+* Pages changed by incremental updates of a common base revision.
+*/
+
+#include "RevisionDiff.hh"
+#include "xPDFInfo.hh"
+#include <Catalog.h>
+#include <share.h>
+#include <algorithm>
+#include <string>
+
+/**
+* Find pages whose text can differ in two documents with a common base revision.
+* If the files don't share a base revision, or document-level objects differ, analysis fails
+* and all pages have to be compared.
+*
+* @param[in]    fileName1   first file name
+* @param[in]    fileName2   second file name
+* @return true if #isIdentical or #getChangedPages are valid
+*/
+bool RevisionDiff::analyze(const wchar_t* fileName1, const wchar_t* fileName2)
+{
+    m_pages.clear();
+    if (!findBase(fileName1, fileName2) || m_identical)
+    {
+        return m_identical;
+    }
+
+    m_doc1 = std::make_unique<PDFDocEx>(fileName1, wcslen(fileName1));
+    m_doc2 = std::make_unique<PDFDocEx>(fileName2, wcslen(fileName2));
+    if (!m_doc1->isOk() || !m_doc2->isOk())
+    {
+        return false;
+    }
+
+    const auto cat1{ m_doc1->getCatalog() };
+    const auto cat2{ m_doc2->getCatalog() };
+    const auto numPages{ cat1->getNumPages() };
+    if (numPages != cat2->getNumPages())
+    {
+        return false;
+    }
+    // pages are compared one to one
+    for (int page{ 1 }; page <= numPages; ++page)
+    {
+        const auto ref1{ cat1->getPageRef(page) };
+        const auto ref2{ cat2->getPageRef(page) };
+        if (!ref1 || !ref2 || (ref1->num < 0) || (ref1->num != ref2->num) || (ref1->gen != ref2->gen))
+        {
+            return false;
+        }
+    }
+
+    m_unchanged.assign(m_doc1->getXRef()->getNumObjects(), 0);
+    m_changed.assign(m_unchanged.size(), 0);
+    m_visiting.assign(m_unchanged.size(), 0);
+    if (!sameDocumentObjects())
+    {
+        return false;
+    }
+
+    for (int page{ 1 }; page <= numPages; ++page)
+    {
+        if (!isPageUnchanged(*cat1->getPageRef(page)))
+        {
+            m_pages.push_back(page);
+        }
+    }
+    TRACE(L"%hs!base=%lld changed pages=%Iu of %d\n", __FUNCTION__, static_cast<long long>(m_base), m_pages.size(), numPages);
+    return true;
+}
+
+/**
+* Compare files from the beginning and find the end of their last common revision.
+* Revision ends with %%EOF, preceded by startxref keyword.
+*
+* @param[in]    fileName1   first file name
+* @param[in]    fileName2   second file name
+* @return true if files are identical or they have a common base revision
+*/
+bool RevisionDiff::findBase(const wchar_t* fileName1, const wchar_t* fileName2)
+{
+    m_base = 0;
+    m_identical = false;
+    const auto file1{ _wfsopen(fileName1, L"rb", _SH_DENYNO) };
+    const auto file2{ _wfsopen(fileName2, L"rb", _SH_DENYNO) };
+    if (file1 && file2)
+    {
+        static const std::string eof{ "%%EOF" };
+        static const std::string startxref{ "startxref" };
+        std::vector<char> buf1(REVISION_READ_BLOCK_SIZE);
+        std::vector<char> buf2(REVISION_READ_BLOCK_SIZE);
+        // end of previous block, %%EOF and startxref can be split between blocks
+        std::string window;
+        GFileOffset pos{ 0 };
+        for (;;)
+        {
+            const auto n1{ fread(buf1.data(), 1, buf1.size(), file1) };
+            const auto n2{ fread(buf2.data(), 1, buf2.size(), file2) };
+            const auto n{ std::min(n1, n2) };
+            const auto equal{ static_cast<size_t>(std::mismatch(buf1.begin(), buf1.begin() + n, buf2.begin()).first - buf1.begin()) };
+
+            const auto windowStart{ pos - static_cast<GFileOffset>(window.size()) };
+            window.append(buf1.data(), equal);
+            for (auto i{ window.find(eof) }; i != std::string::npos; i = window.find(eof, i + 1))
+            {
+                const auto start{ (i > REVISION_TRAILER_SIZE) ? i - REVISION_TRAILER_SIZE : 0 };
+                if (window.find(startxref, start) < i)
+                {
+                    m_base = std::max(m_base, windowStart + static_cast<GFileOffset>(i + eof.size()));
+                }
+            }
+            pos += static_cast<GFileOffset>(equal);
+
+            if ((equal < n) || (n1 != n2))
+            {
+                break;
+            }
+            if (n1 < buf1.size())
+            {
+                // both files end here
+                m_identical = true;
+                break;
+            }
+            window.erase(0, window.size() - std::min(window.size(), REVISION_TRAILER_SIZE + eof.size()));
+        }
+    }
+    if (file1)
+    {
+        fclose(file1);
+    }
+    if (file2)
+    {
+        fclose(file2);
+    }
+    return m_identical || (m_base > 0);
+}
+
+/**
+* Object is identical in both files.
+* Cross-reference entries must be equal and point to the common base revision.
+* Objects in object streams are identical if their object stream is identical.
+* Objects which are free or missing in both files are identical (null).
+*
+* @param[in]    num     object number
+* @return true if object is identical
+*/
+bool RevisionDiff::isClean(int num)
+{
+    const auto xref1{ m_doc1->getXRef() };
+    const auto xref2{ m_doc2->getXRef() };
+    if ((num < 0) || (num >= xref1->getNumObjects()) || (num >= xref2->getNumObjects()))
+    {
+        return (num >= xref1->getNumObjects()) && (num >= xref2->getNumObjects());
+    }
+
+    const auto entry1{ xref1->getEntry(num) };
+    const auto entry2{ xref2->getEntry(num) };
+    if ((entry1->type != entry2->type) || (entry1->offset != entry2->offset) || (entry1->gen != entry2->gen))
+    {
+        return false;
+    }
+    switch (entry1->type)
+    {
+    case xrefEntryFree:
+        return true;
+    case xrefEntryUncompressed:
+        return entry1->offset < m_base;
+    case xrefEntryCompressed:
+    {
+        // object stream can't be compressed
+        const auto objStm{ static_cast<int>(entry1->offset) };
+        return (objStm != num) && (objStm >= 0) && (objStm < xref1->getNumObjects())
+            && (xref1->getEntry(objStm)->type == xrefEntryUncompressed) && isClean(objStm);
+    }
+    default:
+        return false;
+    }
+}
+
+/**
+* Walk objects reachable from obj in the first document and check that they are identical in both.
+* Other pages and page tree nodes are not walked, they are referenced e.g. from link destinations
+* and annotations, page tree is checked in #isPageUnchanged.
+* Objects which reach a changed object are remembered, so walks from other pages stop on them.
+*
+* @param[in]    obj     object
+* @param[in]    depth   nesting depth of obj
+* @return true if all objects are identical
+*/
+bool RevisionDiff::isUnchanged(Object* obj, int depth)
+{
+    if (depth > REVISION_WALK_DEPTH_MAX)
+    {
+        return false;
+    }
+
+    auto ret{ true };
+    switch (obj->getType())
+    {
+    case objRef:
+    {
+        const auto num{ obj->getRefNum() };
+        const auto known{ (num >= 0) && (num < static_cast<int>(m_unchanged.size())) };
+        if (known && m_changed[num])
+        {
+            ret = false;
+            break;
+        }
+        if (known && (m_unchanged[num] || m_visiting[num]))
+        {
+            break;
+        }
+        Object objVal;
+        obj->fetch(m_doc1->getXRef(), &objVal);
+        if ((depth > 0) && objVal.isDict() && (objVal.dictIs("Page") || objVal.dictIs("Pages")))
+        {
+            // other pages are compared separately
+        }
+        else if (!isClean(num))
+        {
+            ret = false;
+        }
+        else if (known)
+        {
+            m_visiting[num] = 1;
+            m_walked.push_back(num);
+            ret = isUnchanged(&objVal, depth + 1);
+        }
+        if (!ret && known && (depth > 0))
+        {
+            // page itself (depth 0) is not remembered, other pages skip it anyway
+            m_changed[num] = 1;
+        }
+        objVal.free();
+        break;
+    }
+    case objArray:
+        for (int i{ 0 }; ret && (i < obj->arrayGetLength()); ++i)
+        {
+            Object objItem;
+            ret = isUnchanged(obj->arrayGetNF(i, &objItem), depth + 1);
+            objItem.free();
+        }
+        break;
+    case objDict:
+        [[fallthrough]];
+    case objStream:
+    {
+        const auto dict{ obj->isDict() ? obj->getDict() : obj->streamGetDict() };
+        for (int i{ 0 }; ret && (i < dict->getLength()); ++i)
+        {
+            Object objItem;
+            ret = isUnchanged(dict->getValNF(i, &objItem), depth + 1);
+            objItem.free();
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return ret;
+}
+
+/**
+* Check that all objects reachable from obj are identical.
+* If they are, walked objects are remembered, so they are not walked again from other pages.
+*
+* @param[in]    obj     object, usually a reference
+* @param[in]    depth   nesting depth of obj, page itself is walked at depth 0
+* @return true if all objects are identical
+*/
+bool RevisionDiff::isUnchangedGraph(Object* obj, int depth)
+{
+    m_walked.clear();
+    const auto ret{ isUnchanged(obj, depth) };
+    for (const auto num : m_walked)
+    {
+        m_visiting[num] = 0;
+        if (ret)
+        {
+            m_unchanged[num] = 1;
+        }
+    }
+    return ret;
+}
+
+/**
+* Page is identical in both documents.
+* Page, objects reachable from page, its parent page tree nodes and their inherited attributes must be identical.
+*
+* @param[in]    ref     page reference
+* @return true if page is identical
+*/
+bool RevisionDiff::isPageUnchanged(Ref ref)
+{
+    static const char* const inheritedKeys[]{ "Resources", "MediaBox", "CropBox", "Rotate" };
+    Object objPage, objRef;
+    auto ret{ isUnchangedGraph(objRef.initRef(ref.num, ref.gen), 0) };
+    if (ret && objRef.fetch(m_doc1->getXRef(), &objPage)->isDict())
+    {
+        Object objParent;
+        objPage.dictLookupNF("Parent", &objParent);
+        for (int depth{ 0 }; ret && objParent.isRef(); ++depth)
+        {
+            Object objNode;
+            if ((depth >= REVISION_PAGE_TREE_DEPTH_MAX) || !isClean(objParent.getRefNum()))
+            {
+                ret = false;
+            }
+            else if (objParent.fetch(m_doc1->getXRef(), &objNode)->isDict())
+            {
+                for (const auto key : inheritedKeys)
+                {
+                    Object objAttr;
+                    ret = ret && isUnchangedGraph(objNode.dictLookupNF(key, &objAttr), 1);
+                    objAttr.free();
+                }
+                objParent.free();
+                objNode.dictLookupNF("Parent", &objParent);
+            }
+            objNode.free();
+        }
+        objParent.free();
+    }
+    objPage.free();
+    objRef.free();
+    return ret;
+}
+
+/**
+* Compare value of object in the first document with value of object in the second document.
+* References to the same unchanged object are equal, other references are resolved and compared by value.
+* Changed streams are never equal, their data is not compared.
+*
+* @param[in]    obj1    object in the first document
+* @param[in]    obj2    object in the second document
+* @param[in]    depth   nesting depth of objects
+* @return true if objects are equal
+*/
+bool RevisionDiff::sameValue(Object* obj1, Object* obj2, int depth)
+{
+    if (depth > REVISION_WALK_DEPTH_MAX)
+    {
+        return false;
+    }
+    if (obj1->isRef() && obj2->isRef() && (obj1->getRefNum() == obj2->getRefNum()) && (obj1->getRefGen() == obj2->getRefGen())
+        && isUnchangedGraph(obj1, 1))
+    {
+        return true;
+    }
+
+    auto ret{ false };
+    Object val1, val2;
+    obj1->fetch(m_doc1->getXRef(), &val1);
+    obj2->fetch(m_doc2->getXRef(), &val2);
+    if (val1.getType() == val2.getType())
+    {
+        switch (val1.getType())
+        {
+        case objBool:
+            ret = val1.getBool() == val2.getBool();
+            break;
+        case objInt:
+            ret = val1.getInt() == val2.getInt();
+            break;
+        case objReal:
+            ret = val1.getReal() == val2.getReal();
+            break;
+        case objString:
+            ret = !val1.getString()->cmp(val2.getString());
+            break;
+        case objName:
+            ret = !strcmp(val1.getName(), val2.getName());
+            break;
+        case objNull:
+            ret = true;
+            break;
+        case objArray:
+            ret = val1.arrayGetLength() == val2.arrayGetLength();
+            for (int i{ 0 }; ret && (i < val1.arrayGetLength()); ++i)
+            {
+                Object item1, item2;
+                ret = sameValue(val1.arrayGetNF(i, &item1), val2.arrayGetNF(i, &item2), depth + 1);
+                item1.free();
+                item2.free();
+            }
+            break;
+        case objDict:
+            ret = sameDict(val1.getDict(), val2.getDict(), depth + 1, false);
+            break;
+        default:
+            break;
+        }
+    }
+    val1.free();
+    val2.free();
+    return ret;
+}
+
+/**
+* Compare dictionaries by value, see #sameValue.
+*
+* @param[in]    dict1   dictionary in the first document
+* @param[in]    dict2   dictionary in the second document
+* @param[in]    depth   nesting depth of dictionaries
+* @param[in]    form    dictionaries are AcroForm, Fields and SigFlags are not compared, see #sameFields
+* @return true if dictionaries are equal
+*/
+bool RevisionDiff::sameDict(Dict* dict1, Dict* dict2, int depth, bool form)
+{
+    const auto ignored{ [form](const char* key) { return form && (!strcmp(key, "Fields") || !strcmp(key, "SigFlags")); } };
+    int count1{ 0 };
+    int count2{ 0 };
+    auto ret{ true };
+    for (int i{ 0 }; ret && (i < dict1->getLength()); ++i)
+    {
+        const auto key{ dict1->getKey(i) };
+        if (!ignored(key))
+        {
+            Object val1, val2;
+            ++count1;
+            ret = !dict2->lookupNF(key, &val2)->isNull() && sameValue(dict1->getValNF(i, &val1), &val2, depth);
+            val1.free();
+            val2.free();
+        }
+    }
+    for (int i{ 0 }; i < dict2->getLength(); ++i)
+    {
+        count2 += ignored(dict2->getKey(i)) ? 0 : 1;
+    }
+    return ret && (count1 == count2);
+}
+
+/**
+* Compare AcroForm fields. Fields of the first document must be the same objects
+* in the same order in the second document, fields added to the end of the array must be new or changed objects.
+* Signing a document adds a signature field, its widget annotation changes the page where it is placed.
+* Values of fields are compared with their pages, see #isPageUnchanged.
+*
+* @param[in]    form1   AcroForm dictionary in the first document, or null
+* @param[in]    form2   AcroForm dictionary in the second document, or null
+* @return true if fields are compatible
+*/
+bool RevisionDiff::sameFields(Object* form1, Object* form2)
+{
+    Object fields1, fields2;
+    if (form1->isDict())
+    {
+        form1->dictLookup("Fields", &fields1);
+    }
+    else
+    {
+        fields1.initNull();
+    }
+    if (form2->isDict())
+    {
+        form2->dictLookup("Fields", &fields2);
+    }
+    else
+    {
+        fields2.initNull();
+    }
+    auto ret{ (fields1.isNull() || fields1.isArray()) && (fields2.isNull() || fields2.isArray()) };
+    if (ret)
+    {
+        const auto len1{ fields1.isArray() ? fields1.arrayGetLength() : 0 };
+        const auto len2{ fields2.isArray() ? fields2.arrayGetLength() : 0 };
+        for (int i{ 0 }; ret && (i < std::max(len1, len2)); ++i)
+        {
+            Object field1, field2;
+            if ((i < len1) && (i < len2))
+            {
+                ret = fields1.arrayGetNF(i, &field1)->isRef() && fields2.arrayGetNF(i, &field2)->isRef()
+                    && (field1.getRefNum() == field2.getRefNum()) && (field1.getRefGen() == field2.getRefGen());
+            }
+            else
+            {
+                const auto field{ (i < len1) ? fields1.arrayGetNF(i, &field1) : fields2.arrayGetNF(i, &field2) };
+                ret = field->isRef() && !isClean(field->getRefNum());
+            }
+            field1.free();
+            field2.free();
+        }
+    }
+    fields1.free();
+    fields2.free();
+    return ret;
+}
+
+/**
+* Compare document-level objects which affect text of pages.
+* Encryption, AcroForm (form field defaults and XFA), optional content and,
+* if embedded files are searched, name trees must be equal.
+*
+* @return true if objects are equal
+*/
+bool RevisionDiff::sameDocumentObjects()
+{
+    const auto xref1{ m_doc1->getXRef() };
+    const auto xref2{ m_doc2->getXRef() };
+    if (xref1->isEncrypted() != xref2->isEncrypted())
+    {
+        return false;
+    }
+
+    auto ret{ true };
+    if (xref1->isEncrypted())
+    {
+        // file key depends on Encrypt dictionary and the first document ID
+        Object encrypt1, encrypt2, id1, id2;
+        ret = sameValue(xref1->getTrailerDict()->dictLookupNF("Encrypt", &encrypt1), xref2->getTrailerDict()->dictLookupNF("Encrypt", &encrypt2), 0);
+        if (ret && xref1->getTrailerDict()->dictLookup("ID", &id1)->isArray() && xref2->getTrailerDict()->dictLookup("ID", &id2)->isArray())
+        {
+            Object item1, item2;
+            ret = (id1.arrayGetLength() > 0) && (id2.arrayGetLength() > 0)
+                && id1.arrayGet(0, &item1)->isString() && id2.arrayGet(0, &item2)->isString()
+                && !item1.getString()->cmp(item2.getString());
+            item1.free();
+            item2.free();
+        }
+        id1.free();
+        id2.free();
+        encrypt1.free();
+        encrypt2.free();
+    }
+
+    const auto cat1{ m_doc1->getCatalog()->getCatalogObj() };
+    const auto cat2{ m_doc2->getCatalog()->getCatalogObj() };
+    if (ret && cat1->isDict() && cat2->isDict())
+    {
+        Object form1, form2;
+        cat1->dictLookup("AcroForm", &form1);
+        cat2->dictLookup("AcroForm", &form2);
+        if (form1.isDict() && form2.isDict())
+        {
+            ret = sameDict(form1.getDict(), form2.getDict(), 1, true);
+        }
+        else if (form1.isDict() || form2.isDict())
+        {
+            // form added to a document without fields, e.g. by its first signature, has no fields on unchanged pages
+            const auto form{ form1.isDict() ? form1.getDict() : form2.getDict() };
+            for (int i{ 0 }; ret && (i < form->getLength()); ++i)
+            {
+                const auto key{ form->getKey(i) };
+                ret = !strcmp(key, "Fields") || !strcmp(key, "SigFlags") || !strcmp(key, "DA") || !strcmp(key, "DR");
+            }
+        }
+        else
+        {
+            ret = form1.isNull() && form2.isNull();
+        }
+        ret = ret && sameFields(&form1, &form2);
+        form2.free();
+        form1.free();
+
+        const char* keys[]{ "OCProperties", globalOptionsFromIni.searchEmbeddedFiles ? "Names" : nullptr };
+        for (const auto key : keys)
+        {
+            if (ret && key)
+            {
+                Object val1, val2;
+                ret = sameValue(cat1->dictLookupNF(key, &val1), cat2->dictLookupNF(key, &val2), 1);
+                val1.free();
+                val2.free();
+            }
+        }
+    }
+    else
+    {
+        ret = false;
+    }
+    return ret;
+}
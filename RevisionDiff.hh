@@ -0,0 +1,62 @@
+/**
+* @file
+*
+* RevisionDiff class declaration.
+*/
+
+#pragma once
+
+#include "PDFDocEx.hh"
+#include <memory>
+#include <vector>
+
+constexpr size_t REVISION_READ_BLOCK_SIZE{ 64U * 1024U };   /**< size of one read when common prefix of two files is searched, in bytes */
+constexpr size_t REVISION_TRAILER_SIZE{ 64U };              /**< max distance of startxref keyword before %%EOF, in bytes */
+constexpr int REVISION_WALK_DEPTH_MAX{ 256 };               /**< max nesting of objects walked from a page */
+constexpr int REVISION_PAGE_TREE_DEPTH_MAX{ 64 };           /**< max depth of page tree */
+
+/**
+* Pages whose text can differ in two revisions of one document.
+* When a document is updated incrementally, the update is appended to the original file,
+* so both files start with the same bytes up to the end (%%EOF) of their common base revision.
+* Objects whose cross-reference entries are equal in both files, and point to the common base,
+* are identical. A page can differ only if an object reachable from it is not identical.
+* Other pages are not extracted, so signing or filling a form on one page of a large document
+* compares text of that page only.
+* Document-level objects which affect text of all pages (form defaults, XFA, layers) must be equal,
+* otherwise all pages are compared as usual.
+*/
+class RevisionDiff
+{
+public:
+    RevisionDiff() = default;
+    RevisionDiff(const RevisionDiff&) = delete;
+    RevisionDiff& operator=(const RevisionDiff&) = delete;
+
+    bool analyze(const wchar_t* fileName1, const wchar_t* fileName2);
+    /** @return true if files are binary identical */
+    bool isIdentical() const { return m_identical; }
+    /** @return numbers of pages which can differ, valid if #analyze returned true */
+    const std::vector<int>& getChangedPages() const { return m_pages; }
+
+private:
+    bool findBase(const wchar_t* fileName1, const wchar_t* fileName2);
+    bool isClean(int num);
+    bool isUnchanged(Object* obj, int depth);
+    bool isUnchangedGraph(Object* obj, int depth);
+    bool isPageUnchanged(Ref ref);
+    bool sameValue(Object* obj1, Object* obj2, int depth);
+    bool sameDict(Dict* dict1, Dict* dict2, int depth, bool form);
+    bool sameFields(Object* form1, Object* form2);
+    bool sameDocumentObjects();
+
+    std::unique_ptr<PDFDocEx>   m_doc1{ nullptr };          /**< first document */
+    std::unique_ptr<PDFDocEx>   m_doc2{ nullptr };          /**< second document */
+    GFileOffset                 m_base{ 0 };                /**< end of common base revision */
+    bool                        m_identical{ false };       /**< files are binary identical */
+    std::vector<char>           m_unchanged;                /**< object and all objects reachable from it are unchanged, index is object number */
+    std::vector<char>           m_changed;                  /**< object or an object reachable from it is changed, index is object number */
+    std::vector<char>           m_visiting;                 /**< object is being walked, index is object number */
+    std::vector<int>            m_walked;                   /**< objects walked by current #isUnchangedGraph */
+    std::vector<int>            m_pages;                    /**< pages which can differ */
+};
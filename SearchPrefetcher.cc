@@ -0,0 +1,669 @@
+/**
+* @file
+*
+* Speculative text extraction of next documents in TC search.
+*/
+
+#include "SearchPrefetcher.hh"
+#include "TcOutputDev.hh"
+#include "DocReclaimer.hh"
+#include "xPDFInfo.hh"
+#include <Catalog.h>
+#include <strsafe.h>
+#include <algorithm>
+#include <chrono>
+
+/**
+* Destructor, stop worker threads if they are still running.
+*/
+SearchPrefetcher::~SearchPrefetcher()
+{
+    stop(PRODUCER_TIMEOUT);
+}
+
+/**
+* Callback function used in PDFDoc::displayPage to abort prefetch.
+*
+* @param[in,out]    worker  pointer to Worker
+* @return gTrue if prefetch of the document has been cancelled, or a resource limit is exceeded
+*/
+GBool SearchPrefetcher::abortPrefetch(void* worker)
+{
+    const auto w{ static_cast<Worker*>(worker) };
+    return !w || !w->doc || w->doc->failed || w->governor.shouldAbort();
+}
+
+/**
+* Callback function used in PDFDoc::displayPage to collect extracted text of a page.
+*
+* @param[in,out]    stream  pointer to Worker
+* @param[in]        text    extracted text
+* @param[in]        len     length of extracted text
+* @return 0 - extraction should continue
+*/
+int SearchPrefetcher::outputFunction(void* stream, const char* text, int len)
+{
+    auto worker{ static_cast<Worker*>(stream) };
+    wchar_t buffer[REQUEST_BUFFER_SIZE / sizeof(wchar_t)];
+    while (worker && text && (len > 0))
+    {
+        ptrdiff_t cbBuffer{ sizeof(buffer) };
+        const auto converted{ ThreadData::PdfTxtToUTF16(text, len, buffer, &cbBuffer) };
+        worker->text.append(buffer);
+        if (!converted)
+        {
+            break;
+        }
+        text += converted;
+        len -= static_cast<int>(converted);
+    }
+    return 0;
+}
+
+/**
+* Start worker threads, if not already started.
+* Must be called with #m_mutex locked.
+*
+* @return true if worker threads are running
+*/
+bool SearchPrefetcher::start()
+{
+    if (m_workers.empty())
+    {
+        const auto count{ std::min(globalOptionsFromIni.searchPrefetchThreads, PREFETCH_THREADS_MAX) };
+        // all workers must exist before any thread starts to steal tasks
+        for (unsigned i{ 0 }; i < count; ++i)
+        {
+            m_workers.emplace_back(std::make_unique<Worker>());
+            m_workers.back()->owner = this;
+        }
+        for (auto& worker : m_workers)
+        {
+            ++m_running;
+            worker->thread = std::thread([](Worker* w)
+            {
+                TRACE(L"%hs!prefetch thread start\n", __FUNCTION__);
+                w->owner->run(*w);
+                TRACE(L"%hs!prefetch thread end\n", __FUNCTION__);
+            }, worker.get());
+        }
+    }
+    return !m_workers.empty();
+}
+
+/**
+* Worker thread main function.
+* Execute tasks from own deque, or steal tasks from other workers.
+*
+* @param[in,out]    worker  this worker
+*/
+void SearchPrefetcher::run(Worker& worker)
+{
+    TcOutputDev::setTextOutputControl(worker.toc);
+    worker.dev = std::make_unique<TextOutputDev>(&outputFunction, &worker, &worker.toc);
+
+    Task task;
+    while (worker.dev->isOk() && pop(worker, task))
+    {
+        if (!task.doc->failed)
+        {
+            if (task.page == 0)
+            {
+                openDocument(worker, task.doc);
+            }
+            else
+            {
+                extractPage(worker, task);
+            }
+        }
+        task.doc.reset();
+    }
+
+    worker.dev.reset();
+    close(worker);
+
+    std::lock_guard lock(m_mutex);
+    --m_running;
+    m_cv.notify_all();
+}
+
+/**
+* Add task to worker's deque.
+* Caller must notify #m_cv, with #m_mutex locked or after it has been locked.
+*
+* @param[in,out]    worker  worker which owns the deque
+* @param[in]        task    new task
+*/
+void SearchPrefetcher::push(Worker& worker, Task&& task)
+{
+    std::lock_guard lock(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+    ++m_pending;
+}
+
+/**
+* Get next task.
+* Worker takes the newest task from its own deque, or the oldest task from other worker's deque.
+* If there are no tasks, wait for new ones. Open document is closed, so its file isn't locked,
+* immediately if its prefetch has been cancelled, otherwise if no task comes in #PRODUCER_TIMEOUT.
+*
+* @param[in,out]    worker  this worker
+* @param[out]       task    next task
+* @return false if worker should exit
+*/
+bool SearchPrefetcher::pop(Worker& worker, Task& task)
+{
+    for (;;)
+    {
+        {
+            std::lock_guard lock(worker.mutex);
+            if (!worker.tasks.empty())
+            {
+                task = std::move(worker.tasks.back());
+                worker.tasks.pop_back();
+                --m_pending;
+                return true;
+            }
+        }
+
+        for (auto& other : m_workers)
+        {
+            if (other.get() != &worker)
+            {
+                std::lock_guard lock(other->mutex);
+                if (!other->tasks.empty())
+                {
+                    task = std::move(other->tasks.front());
+                    other->tasks.pop_front();
+                    --m_pending;
+                    return true;
+                }
+            }
+        }
+
+        const auto ready{ [this] { return m_stop || (m_pending > 0); } };
+        std::unique_lock lock(m_mutex);
+        if (worker.pdf)
+        {
+            const auto dropped{ [this, &worker] { return find(worker.fileName.c_str()) == m_docs.end(); } };
+            if (dropped() || !m_cv.wait_for(lock, std::chrono::milliseconds(PRODUCER_TIMEOUT), [&] { return ready() || dropped(); }) || !ready())
+            {
+                lock.unlock();
+                close(worker);
+                lock.lock();
+            }
+        }
+        m_cv.wait(lock, ready);
+        if (m_stop)
+        {
+            return false;
+        }
+    }
+}
+
+/**
+* Open document in worker, if it isn't already open.
+*
+* @param[in,out]    worker      this worker
+* @param[in]        fileName    full path to PDF document
+* @return true if document is open
+*/
+bool SearchPrefetcher::open(Worker& worker, const std::wstring& fileName)
+{
+    if (!worker.pdf || wcsicmp(worker.fileName.c_str(), fileName.c_str()))
+    {
+        worker.pdf = std::make_unique<PDFDocEx>(fileName.c_str(), fileName.size());
+        worker.fileName = fileName;
+        if (!worker.pdf->isOk())
+        {
+            worker.pdf.reset();
+            worker.fileName.clear();
+        }
+    }
+    return worker.pdf != nullptr;
+}
+
+/**
+* Close document open in worker.
+* File is closed immediately, the rest of the document is destroyed in background, see DocReclaimer.
+*
+* @param[in,out]    worker      this worker
+*/
+void SearchPrefetcher::close(Worker& worker)
+{
+    if (worker.pdf)
+    {
+        DocReclaimer::reclaim(std::move(worker.pdf));
+    }
+    worker.fileName.clear();
+}
+
+/**
+* Open document, and queue its pages to worker's deque.
+* Page 1 is at the back of the deque, so worker extracts pages in order, and other workers steal last pages.
+*
+* @param[in,out]    worker  this worker
+* @param[in]        doc     prefetched document
+*/
+void SearchPrefetcher::openDocument(Worker& worker, const std::shared_ptr<Document>& doc)
+{
+    const auto ok{ open(worker, doc->fileName) };
+    const auto numPages{ ok ? worker.pdf->getNumPages() : 0 };
+
+    std::lock_guard lock(m_mutex);
+    if (ok && !doc->failed)
+    {
+        // page buffers must exist before any page task can be stolen
+        doc->pages.resize(numPages);
+        doc->done.assign(numPages, false);
+        doc->opened = true;
+        for (int page{ numPages }; page > 0; --page)
+        {
+            push(worker, Task{ doc, page });
+        }
+    }
+    else if (!ok)
+    {
+        TRACE(L"%hs!%ls!open failed\n", __FUNCTION__, doc->fileName.c_str());
+        drop(*doc);
+    }
+    m_cv.notify_all();
+}
+
+/**
+* Extract text of one page.
+* Resources used by extraction of the page are limited by ResourceGovernor, pages of one document
+* are extracted by several workers, so limits apply to each page separately.
+* If a limit is exceeded, prefetch of the document is cancelled. Unless the limit is heap growth of the process,
+* document is also flagged, so TC skips it like in PDFExtractor.
+* If too much text is waiting for TC, prefetch of the document is cancelled.
+*
+* @param[in,out]    worker  this worker
+* @param[in]        task    document and page number
+*/
+void SearchPrefetcher::extractPage(Worker& worker, const Task& task)
+{
+    auto& doc{ *task.doc };
+    const auto ok{ open(worker, doc.fileName) };
+    worker.text.clear();
+    if (ok)
+    {
+        worker.doc = &doc;
+        worker.governor.start(nullptr, worker.dev.get());
+        worker.pdf->displayPage(worker.dev.get(), task.page, 72.0, 72.0, 0, gFalse, gTrue, gFalse, abortPrefetch, &worker);
+        worker.pdf->getCatalog()->doneWithPage(task.page);
+        worker.doc = nullptr;
+    }
+
+    std::lock_guard lock(m_mutex);
+    if (!ok)
+    {
+        drop(doc);
+    }
+    else if (!doc.failed && worker.governor.exceeded())
+    {
+        TRACE(L"%hs!%ls!limit exceeded\n", __FUNCTION__, doc.fileName.c_str());
+        if (worker.governor.shouldFlag())
+        {
+            ResourceGovernor::flag(doc.fileName.c_str());
+        }
+        drop(doc);
+    }
+    else if (!doc.failed)
+    {
+        const auto index{ static_cast<size_t>(task.page) - 1 };
+        const auto size{ worker.text.size() * sizeof(wchar_t) };
+        doc.size += size;
+        m_size += size;
+        doc.pages[index] = std::move(worker.text);
+        doc.done[index] = true;
+        if (!doc.serving && ((doc.size > PREFETCH_TEXT_SIZE) || (m_size > PREFETCH_TOTAL_SIZE)))
+        {
+            // TC may never ask for this document, don't waste memory
+            TRACE(L"%hs!%ls!too much text\n", __FUNCTION__, doc.fileName.c_str());
+            drop(doc);
+        }
+    }
+    m_cv.notify_all();
+}
+
+/**
+* Copy text of extracted pages to TC buffer.
+* If next page is not extracted yet, wait for it up to #PREFETCH_TIMEOUT.
+* Must be called with #m_mutex locked.
+*
+* @param[in,out]    doc         prefetched document
+* @param[out]       dst         TC buffer
+* @param[in]        dstSize     size of dst in bytes
+* @param[in]        lock        lock of #m_mutex
+* @return #ft_fulltextw if text is copied, #ft_fieldempty at the end of document,
+*         #ft_timeout if next page is not extracted in time or prefetch has failed
+*/
+int SearchPrefetcher::copyText(Document& doc, wchar_t* dst, int dstSize, std::unique_lock<std::mutex>& lock)
+{
+    const auto cchDst{ static_cast<size_t>(dstSize) / sizeof(wchar_t) - 1 };
+    size_t count{ 0 };
+    while ((count < cchDst) && !doc.failed && (doc.next < doc.pages.size()))
+    {
+        if (!doc.done[doc.next])
+        {
+            if (count > 0)
+            {
+                // send what is already extracted
+                break;
+            }
+            const auto ready{ [&doc] { return doc.failed || doc.done[doc.next]; } };
+            if (!m_cv.wait_for(lock, std::chrono::milliseconds(PREFETCH_TIMEOUT), ready))
+            {
+                break;
+            }
+            continue;
+        }
+
+        auto& page{ doc.pages[doc.next] };
+        const auto len{ std::min(cchDst - count, page.size() - doc.offset) };
+        wmemcpy(dst + count, page.data() + doc.offset, len);
+        count += len;
+        doc.offset += len;
+        doc.size -= len * sizeof(wchar_t);
+        m_size -= len * sizeof(wchar_t);
+        if (doc.offset >= page.size())
+        {
+            // page has been sent, release its text
+            std::wstring().swap(page);
+            ++doc.next;
+            doc.offset = 0;
+        }
+    }
+    dst[count] = 0;
+
+    if (count > 0)
+    {
+        return ft_fulltextw;
+    }
+    if (!doc.failed && (doc.next >= doc.pages.size()))
+    {
+        return ft_fieldempty;
+    }
+    return ft_timeout;
+}
+
+/**
+* Find prefetched document.
+* Must be called with #m_mutex locked.
+*
+* @param[in]    fileName    full path to PDF document
+* @return iterator to document in #m_docs, or m_docs.end() if not found
+*/
+std::list<std::shared_ptr<SearchPrefetcher::Document>>::iterator SearchPrefetcher::find(const wchar_t* fileName)
+{
+    return std::find_if(m_docs.begin(), m_docs.end(), [fileName](const std::shared_ptr<Document>& doc)
+    {
+        return !wcsicmp(doc->fileName.c_str(), fileName);
+    });
+}
+
+/**
+* Cancel prefetch of document and release its text.
+* Must be called with #m_mutex locked.
+*
+* @param[in,out]    doc     prefetched document
+*/
+void SearchPrefetcher::drop(Document& doc)
+{
+    doc.failed = true;
+    m_size -= doc.size;
+    doc.size = 0;
+    doc.pages.clear();
+    doc.done.clear();
+}
+
+/**
+* Cancel prefetch of document and forget it.
+* Must be called with #m_mutex locked.
+*
+* @param[in]    doc     prefetched document
+*/
+void SearchPrefetcher::remove(const std::shared_ptr<Document>& doc)
+{
+    drop(*doc);
+    m_docs.remove(doc);
+}
+
+/**
+* Get PDF documents following fileName in its directory, in order of names.
+* Directory listing is cached until directory is changed or prefetch is cancelled.
+*
+* @param[in]    fileName    full path to PDF document
+* @param[in]    depth       max number of documents
+* @return full paths of next documents
+*/
+std::vector<std::wstring> SearchPrefetcher::nextFiles(const wchar_t* fileName, unsigned depth)
+{
+    std::vector<std::wstring> files;
+    const std::filesystem::path dir{ std::filesystem::path(fileName).parent_path() };
+
+    std::lock_guard lock(m_dirMutex);
+    if (dir != m_dir)
+    {
+        m_dir = dir;
+        m_files.clear();
+        std::error_code ec;
+        for (std::filesystem::directory_iterator it(dir, ec), end; !ec && (it != end); it.increment(ec))
+        {
+            if (it->is_regular_file(ec) && !wcsicmp(it->path().extension().wstring().c_str(), L".pdf"))
+            {
+                m_files.emplace_back(it->path().wstring());
+            }
+        }
+        std::sort(m_files.begin(), m_files.end(), [](const std::wstring& a, const std::wstring& b)
+        {
+            return wcsicmp(a.c_str(), b.c_str()) < 0;
+        });
+    }
+
+    auto it{ std::find_if(m_files.cbegin(), m_files.cend(), [fileName](const std::wstring& file)
+    {
+        return !wcsicmp(file.c_str(), fileName);
+    }) };
+    if (it != m_files.cend())
+    {
+        for (++it; (it != m_files.cend()) && (files.size() < depth); ++it)
+        {
+            files.push_back(*it);
+        }
+    }
+    return files;
+}
+
+/**
+* Queue documents which follow fileName for prefetch.
+* Called when TC starts to search in fileName. Documents out of the new window are dropped.
+* Prefetch is disabled if #options_t::searchPrefetchThreads is 0,
+* or if #options_t::extractAnnotations, #options_t::extractXFAData or #options_t::searchEmbeddedFiles is set
+* (text of annotations, XFA form data and embedded documents is not prefetched).
+*
+* @param[in]    fileName    full path to PDF document searched by TC
+*/
+void SearchPrefetcher::prefetch(const wchar_t* fileName)
+{
+    const auto& options{ globalOptionsFromIni };
+    if (!fileName || !options.searchPrefetchThreads || !options.searchPrefetchDepth || options.extractAnnotations || options.extractXFAData || options.searchEmbeddedFiles)
+    {
+        return;
+    }
+
+    const auto files{ nextFiles(fileName, std::min(options.searchPrefetchDepth, PREFETCH_DEPTH_MAX)) };
+    const auto inWindow{ [&files](const std::wstring& name)
+    {
+        return std::any_of(files.cbegin(), files.cend(), [&name](const std::wstring& file) { return !wcsicmp(file.c_str(), name.c_str()); });
+    } };
+
+    std::lock_guard lock(m_mutex);
+    if (m_stop || !start())
+    {
+        return;
+    }
+
+    for (auto it{ m_docs.begin() }; it != m_docs.end(); )
+    {
+        const auto doc{ *it };
+        if (wcsicmp(doc->fileName.c_str(), fileName) && !inWindow(doc->fileName))
+        {
+            drop(*doc);
+            it = m_docs.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    for (const auto& file : files)
+    {
+        if ((find(file.c_str()) == m_docs.end()) && !ResourceGovernor::isFlagged(file.c_str()))
+        {
+            auto doc{ std::make_shared<Document>() };
+            doc->fileName = file;
+            m_docs.push_back(doc);
+            push(*m_workers[m_nextWorker++ % m_workers.size()], Task{ doc, 0 });
+            TRACE(L"%hs!%ls queued\n", __FUNCTION__, file.c_str());
+        }
+    }
+    m_cv.notify_all();
+}
+
+/**
+* Get text of prefetched document.
+* Unit 0 starts reading, positive units continue, unit -1 means TC has found searched string.
+* If the document is not prefetched, or its prefetch has failed, caller should extract text itself.
+* If next page is not extracted in time, prefetch of the document is dropped, and caller should
+* extract the rest of the text as a new request starting at firstPage, TC is not blocked.
+* Text of a partially sent page is sent again.
+*
+* @param[in]    fileName    full path to PDF document
+* @param[in]    unit        index of the unit, -1 when searched string is found
+* @param[out]   dst         buffer for retrieved data
+* @param[in]    dstSize     sizeof dst buffer in bytes
+* @param[out]   result      result of an extraction
+* @param[out]   firstPage   page to start extraction from if the rest of the text is handed to caller, 0 otherwise
+* @return true if request has been handled from prefetched text
+*/
+bool SearchPrefetcher::fetch(const wchar_t* fileName, int unit, void* dst, int dstSize, int& result, int& firstPage)
+{
+    firstPage = 0;
+    if (!fileName)
+    {
+        return false;
+    }
+
+    std::unique_lock lock(m_mutex);
+    const auto it{ find(fileName) };
+    if (it == m_docs.end())
+    {
+        return false;
+    }
+
+    const auto doc{ *it };
+    if (unit == -1)
+    {
+        const auto serving{ doc->serving };
+        remove(doc);
+        result = ft_fieldempty;
+        return serving;
+    }
+
+    if (unit == 0)
+    {
+        if (!dst || (dstSize < static_cast<int>(2 * sizeof(wchar_t))) || doc->serving)
+        {
+            // text can't be sent again from beginning, released pages are lost
+            remove(doc);
+            return false;
+        }
+
+        // don't block TC, if the first page is not ready, extract the document locally
+        const auto ready{ [&doc] { return doc->failed || (doc->opened && (doc->done.empty() || doc->done[0])); } };
+        if (!m_cv.wait_for(lock, std::chrono::milliseconds(PREFETCH_TIMEOUT), ready) || doc->failed)
+        {
+            remove(doc);
+            return false;
+        }
+        doc->serving = true;
+    }
+    else if (!doc->serving || !dst || (dstSize < static_cast<int>(2 * sizeof(wchar_t))))
+    {
+        return false;
+    }
+
+    result = copyText(*doc, static_cast<wchar_t*>(dst), dstSize, lock);
+    if (result == ft_timeout)
+    {
+        // don't block TC, rest of the document is extracted by caller
+        firstPage = static_cast<int>(doc->next) + 1;
+        remove(doc);
+        TRACE(L"%hs!%ls!%d handed over from page %d\n", __FUNCTION__, fileName, unit, firstPage);
+        return false;
+    }
+    if (result == ft_fieldempty)
+    {
+        remove(doc);
+    }
+    TRACE(L"%hs!%ls!%d result=%d\n", __FUNCTION__, fileName, unit, result);
+    return true;
+}
+
+/**
+* Cancel all prefetched documents and queued tasks, e.g. when TC stops search.
+* Worker threads keep running and wait for new tasks, they close their documents, see #pop.
+*/
+void SearchPrefetcher::cancel()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        for (auto& doc : m_docs)
+        {
+            drop(*doc);
+        }
+        m_docs.clear();
+        for (auto& worker : m_workers)
+        {
+            std::lock_guard workerLock(worker->mutex);
+            m_pending -= static_cast<unsigned>(worker->tasks.size());
+            worker->tasks.clear();
+        }
+        m_cv.notify_all();
+    }
+
+    std::lock_guard lock(m_dirMutex);
+    m_dir.clear();
+    m_files.clear();
+}
+
+/**
+* Stop worker threads.
+* Worker threads are detached, not joined, see ThreadData::closeWorker.
+* If a worker doesn't exit in time, it is left to finish on its own, and workers are not released.
+*
+* @param[in]    timeout     time to wait for worker threads to exit in miliseconds
+*/
+void SearchPrefetcher::stop(uint32_t timeout)
+{
+    cancel();
+
+    std::unique_lock lock(m_mutex);
+    m_stop = true;
+    m_cv.notify_all();
+    const auto exited{ m_cv.wait_for(lock, std::chrono::milliseconds(timeout), [this] { return m_running == 0; }) };
+    for (auto& worker : m_workers)
+    {
+        if (worker->thread.joinable())
+        {
+            worker->thread.detach();
+        }
+    }
+    if (exited)
+    {
+        m_workers.clear();
+    }
+}
@@ -0,0 +1,122 @@
+/**
+* @file
+*
+* SearchPrefetcher class declaration.
+*/
+
+#pragma once
+
+#include "ThreadData.hh"
+#include "ResourceGovernor.hh"
+#include "PDFDocEx.hh"
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <memory>
+#include <filesystem>
+
+constexpr unsigned PREFETCH_THREADS_MAX{ 16U };                 /**< max number of prefetch threads */
+constexpr unsigned PREFETCH_DEPTH_MAX{ 16U };                   /**< max number of documents prefetched ahead of TC search */
+constexpr size_t PREFETCH_TEXT_SIZE{ 8U * 1024U * 1024U };      /**< max size of prefetched text of one document waiting for TC, in bytes */
+constexpr size_t PREFETCH_TOTAL_SIZE{ 32U * 1024U * 1024U };    /**< max size of prefetched text of all documents waiting for TC, in bytes */
+constexpr uint32_t PREFETCH_TIMEOUT{ 100U };                    /**< max time TC waits for prefetched text, in miliseconds */
+
+/**
+* Speculative text extraction of documents which TC search will ask for next.
+* TC search calls ContentGetValueW for #fiText file by file in one thread.
+* When TC starts to search in a document, next documents from the same directory are queued,
+* and their pages are extracted by a pool of worker threads.
+* Each worker has its own deque of page tasks, idle workers steal tasks from other workers,
+* so pages of one large document are extracted in parallel.
+* When TC asks for a prefetched document, text is sent from buffered pages.
+* TC waits only briefly for text which is not extracted yet, if the next page is not ready,
+* the rest of the document is extracted by PDFExtractor, starting at that page.
+*/
+class SearchPrefetcher
+{
+public:
+    SearchPrefetcher() = default;
+    SearchPrefetcher(const SearchPrefetcher&) = delete;
+    SearchPrefetcher& operator=(const SearchPrefetcher&) = delete;
+    ~SearchPrefetcher();
+
+    void prefetch(const wchar_t* fileName);
+    bool fetch(const wchar_t* fileName, int unit, void* dst, int dstSize, int& result, int& firstPage);
+    void cancel();
+    void stop(uint32_t timeout);
+
+private:
+    /**
+    * Prefetched document
+    */
+    struct Document
+    {
+        std::wstring                fileName;               /**< full path to PDF document */
+        std::vector<std::wstring>   pages;                  /**< extracted text of each page */
+        std::vector<bool>           done;                   /**< text of page is extracted */
+        size_t                      next{ 0 };              /**< index of next page to send to TC */
+        size_t                      offset{ 0 };            /**< number of chars of next page already sent to TC */
+        size_t                      size{ 0 };              /**< size of text waiting for TC in bytes */
+        bool                        opened{ false };        /**< document is opened, number of pages is known */
+        bool                        serving{ false };       /**< TC is reading text of this document */
+        std::atomic_bool            failed{ false };        /**< document can't be prefetched or prefetch is cancelled */
+    };
+
+    /**
+    * Task for worker thread, open document or extract text of one page
+    */
+    struct Task
+    {
+        std::shared_ptr<Document>   doc;                    /**< prefetched document */
+        int                         page{ 0 };              /**< page number, 0 to open document */
+    };
+
+    /**
+    * Worker thread with its own task deque and open document
+    */
+    struct Worker
+    {
+        SearchPrefetcher*               owner{ nullptr };   /**< pool the worker belongs to */
+        std::mutex                      mutex;              /**< protects tasks */
+        std::deque<Task>                tasks;              /**< owner takes tasks from back, thieves from front */
+        std::thread                     thread;             /**< worker thread */
+        std::wstring                    fileName;           /**< file name of open document */
+        std::unique_ptr<PDFDocEx>       pdf{ nullptr };     /**< open document, closed when worker is idle */
+        std::unique_ptr<TextOutputDev>  dev{ nullptr };     /**< text extractor */
+        TextOutputControl               toc;                /**< settings for TextOutputDev */
+        std::wstring                    text;               /**< text of page being extracted */
+        Document*                       doc{ nullptr };     /**< document of page being extracted */
+        ResourceGovernor                governor;           /**< limits of resources used by extraction of a page */
+    };
+
+    bool start();
+    void run(Worker& worker);
+    void push(Worker& worker, Task&& task);
+    bool pop(Worker& worker, Task& task);
+    bool open(Worker& worker, const std::wstring& fileName);
+    void close(Worker& worker);
+    void openDocument(Worker& worker, const std::shared_ptr<Document>& doc);
+    void extractPage(Worker& worker, const Task& task);
+    int copyText(Document& doc, wchar_t* dst, int dstSize, std::unique_lock<std::mutex>& lock);
+    std::list<std::shared_ptr<Document>>::iterator find(const wchar_t* fileName);
+    void drop(Document& doc);
+    void remove(const std::shared_ptr<Document>& doc);
+    std::vector<std::wstring> nextFiles(const wchar_t* fileName, unsigned depth);
+
+    static GBool abortPrefetch(void* worker);
+    static int outputFunction(void* stream, const char* text, int len);
+
+    std::mutex                              m_mutex;                /**< protects documents and worker state */
+    std::condition_variable                 m_cv;                   /**< signals new task, extracted page or worker exit */
+    std::list<std::shared_ptr<Document>>    m_docs;                 /**< prefetched documents */
+    std::vector<std::unique_ptr<Worker>>    m_workers;              /**< worker threads */
+    std::atomic<unsigned>                   m_pending{ 0 };         /**< number of tasks in all deques */
+    size_t                                  m_size{ 0 };            /**< size of text of all documents waiting for TC in bytes */
+    unsigned                                m_running{ 0 };         /**< number of running worker threads */
+    unsigned                                m_nextWorker{ 0 };      /**< worker for next open task, round robin */
+    bool                                    m_stop{ false };        /**< worker threads should exit */
+    std::mutex                              m_dirMutex;             /**< protects directory listing */
+    std::filesystem::path                   m_dir;                  /**< directory of last listing */
+    std::vector<std::wstring>               m_files;                /**< sorted PDF files in #m_dir */
+};
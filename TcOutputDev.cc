@@ -6,18 +6,26 @@
 
 #include "TcOutputDev.hh"
 #include "xPDFInfo.hh"
+#include "RequestScheduler.hh"
+#include "PDFDocEx.hh"
+#include "XFADataExtractor.hh"
+#include <Catalog.h>
+#include <Page.h>
+#include <AcroForm.h>
+#include <algorithm>
+#include <climits>
 
 /**
 * Callback function used in PdfDoc::displayPage to abort text extraction.
-* If #Request::status is not #active, extraction should abort.
+* If #Request::status is not #active, or a resource limit is exceeded, extraction should abort.
 * 
-* @param[in] stream     pointer to ThreadData structure
+* @param[in] governor   pointer to ResourceGovernor of the extraction
 * @return gTrue if extraction should abort
 */
-static GBool abortExtraction(void* stream)
+static GBool abortExtraction(void* governor)
 {
-    const auto data{ static_cast<ThreadData*>(stream) };
-    if (data && (requestStatus::active == data->getStatus()))
+    const auto gov{ static_cast<ResourceGovernor*>(governor) };
+    if (gov && !gov->shouldAbort())
     {
         return gFalse;
     }
@@ -54,40 +62,416 @@ static int outputFunction(void *stream, const char *text, int len)
 }
 
 /**
-* Start text extraction.
-* Extraction goes through all document pages until search string is found.
+* Copy Unicode string from annotation or form field to request structure.
+* Each string is terminated with EOL, so it doesn't merge with the page text.
+*
+* @param[in,out]    data    pointer to ThreadData structure
+* @param[in]        text    Unicode string
+* @param[in]        len     number of Unicode characters in text
+* @return   0 - extraction shuld continue, 1 - extraction should abort
+*/
+static int outputUnicode(ThreadData* data, const Unicode* text, int len)
+{
+    static const Unicode eol{ '\n' };
+    if ((requestStatus::active == data->getStatus()) && text && (len > 0))
+    {
+        if (data->output(reinterpret_cast<const char*>(text), len, true))
+        {
+            return 1;
+        }
+        return data->output(reinterpret_cast<const char*>(&eol), 1, true);
+    }
+    return 0;
+}
+
+/**
+* Convert annotation rich text (/RC, XHTML) to Unicode and remove markup.
+* Entities are not decoded, they are only a small fraction of the rich text.
+*
+* @param[in]    rc      rich text string
+* @param[out]   text    Unicode text without markup
+*/
+static void richTextToUnicode(GString* rc, std::vector<Unicode>& text)
+{
+    TextString ts(rc);
+    const auto u{ ts.getUnicode() };
+    auto inTag{ false };
+    text.clear();
+    text.reserve(ts.getLength());
+    for (int i{ 0 }; i < ts.getLength(); ++i)
+    {
+        if (u[i] == '<')
+        {
+            inTag = true;
+        }
+        else if (u[i] == '>')
+        {
+            inTag = false;
+            // tags separate words, e.g. </p><p>
+            if (!text.empty() && (text.back() != ' '))
+            {
+                text.push_back(' ');
+            }
+        }
+        else if (!inTag)
+        {
+            text.push_back(u[i]);
+        }
+    }
+}
+
+/**
+* Find page number of each AcroForm field.
+* AcroFormField::getPageNum searches the annotations of all pages,
+* do it only once per document, not for every page.
+*
+* @param[in]    doc     pointer to xPDF PdcDoc instance
+*/
+void TcOutputDev::loadFieldPages(PDFDoc* doc)
+{
+    m_fieldPages.clear();
+    const auto form{ doc->getCatalog()->getForm() };
+    if (form)
+    {
+        const auto numFields{ form->getNumFields() };
+        m_fieldPages.reserve(numFields);
+        for (int i{ 0 }; i < numFields; ++i)
+        {
+            m_fieldPages.push_back(form->getField(i)->getPageNum());
+        }
+    }
+}
+
+/**
+* Extract text from page annotations directly from annotation dictionaries.
+* /Contents is used, /RC (rich text) only if annotation doesn't have /Contents.
+* Appearance streams are neither generated nor interpreted.
+* Widget annotations are handled as form fields, Popup annotations repeat /Contents of the parent annotation.
 *
 * @param[in]        doc     pointer to xPDF PdcDoc instance
+* @param[in]        page    page number
 * @param[in,out]    data    pointer to request data
+* @return   0 - extraction shuld continue, 1 - extraction should abort
 */
-void TcOutputDev::output(PDFDoc* doc, ThreadData* data)
+int TcOutputDev::outputAnnotations(PDFDoc* doc, int page, ThreadData* data)
 {
-    if (data && doc && doc->isOk())
+    int ret{ 0 };
+    const auto pageObj{ doc->getCatalog()->getPage(page) };
+    if (pageObj)
     {
-        if (!m_dev)
+        Object annotsObj;
+        if (pageObj->getAnnots(&annotsObj)->isArray())
         {
-            toc.discardInvisibleText = globalOptionsFromIni.discardInvisibleText;
-            toc.discardDiagonalText = globalOptionsFromIni.discardDiagonalText;
-            toc.discardClippedText = globalOptionsFromIni.discardClippedText;
-            toc.marginBottom = globalOptionsFromIni.marginBottom;
-            toc.marginTop = globalOptionsFromIni.marginTop;
-            toc.marginLeft = globalOptionsFromIni.marginLeft;
-            toc.marginRight = globalOptionsFromIni.marginRight;
-            toc.mode = globalOptionsFromIni.textOutputMode;
-
-            // register #outputFunction as a callback function for text extraction
-            m_dev = std::make_unique<TextOutputDev>(&outputFunction, data, &toc);
+            std::vector<Unicode> richText;
+            for (int i{ 0 }; !ret && (i < annotsObj.arrayGetLength()); ++i)
+            {
+                Object annotObj;
+                if (annotsObj.arrayGet(i, &annotObj)->isDict())
+                {
+                    Object subtypeObj;
+                    annotObj.dictLookup("Subtype", &subtypeObj);
+                    if (!subtypeObj.isName("Widget") && !subtypeObj.isName("Popup"))
+                    {
+                        Object textObj;
+                        if (annotObj.dictLookup("Contents", &textObj)->isString() && textObj.getString()->getLength())
+                        {
+                            TextString ts(textObj.getString());
+                            ret = outputUnicode(data, ts.getUnicode(), ts.getLength());
+                        }
+                        else
+                        {
+                            textObj.free();
+                            if (annotObj.dictLookup("RC", &textObj)->isString())
+                            {
+                                richTextToUnicode(textObj.getString(), richText);
+                                ret = outputUnicode(data, richText.data(), static_cast<int>(richText.size()));
+                            }
+                        }
+                        textObj.free();
+                    }
+                    subtypeObj.free();
+                }
+                annotObj.free();
+            }
         }
+        annotsObj.free();
+    }
+    return ret;
+}
 
-        if (m_dev && m_dev->isOk())
+/**
+* Extract values (/V) of text, combo box and list box form fields located on the page.
+* Values from XFA form have precedence, see AcroFormField::getValue.
+* Appearance streams are neither generated nor interpreted.
+*
+* @param[in]        doc     pointer to xPDF PdcDoc instance
+* @param[in]        page    page number
+* @param[in,out]    data    pointer to request data
+* @return   0 - extraction shuld continue, 1 - extraction should abort
+*/
+int TcOutputDev::outputFormFields(PDFDoc* doc, int page, ThreadData* data)
+{
+    int ret{ 0 };
+    const auto form{ doc->getCatalog()->getForm() };
+    if (form)
+    {
+        const auto numFields{ static_cast<int>(m_fieldPages.size()) };
+        for (int i{ 0 }; !ret && (i < numFields) && (i < form->getNumFields()); ++i)
         {
+            if (m_fieldPages[i] != page)
+            {
+                continue;
+            }
+
+            const auto field{ form->getField(i) };
+            switch (field->getAcroFormFieldType())
+            {
+            case acroFormFieldMultilineText:
+                [[fallthrough]];
+            case acroFormFieldText:
+                [[fallthrough]];
+            case acroFormFieldComboBox:
+                [[fallthrough]];
+            case acroFormFieldListBox:
+            {
+                int len{ 0 };
+                const auto value{ field->getValue(&len) };
+                if (value)
+                {
+                    ret = outputUnicode(data, value, len);
+                    gfree(value);
+                }
+                break;
+            }
+            default:
+                // buttons, signatures and barcodes don't have searchable text value
+                break;
+            }
+        }
+    }
+    return ret;
+}
+
+/**
+* Set text extraction options from ini file.
+* If #options_t::maxPageTextMemory is set, pages with more characters than fit in the limit
+* are extracted in parts, layout (reading order) is done within each part.
+*
+* @param[out]   control     settings for TextOutputDev
+*/
+void TcOutputDev::setTextOutputControl(TextOutputControl& control)
+{
+    if (globalOptionsFromIni.maxPageTextMemory)
+    {
+        const auto chars{ static_cast<size_t>(globalOptionsFromIni.maxPageTextMemory) * 1024U * 1024U / TEXT_MEMORY_PER_CHAR };
+        control.maxPageChars = static_cast<int>(std::clamp(chars, TEXT_PART_CHARS_MIN, static_cast<size_t>(INT_MAX)));
+    }
+    control.discardInvisibleText = globalOptionsFromIni.discardInvisibleText;
+    control.discardDiagonalText = globalOptionsFromIni.discardDiagonalText;
+    control.discardClippedText = globalOptionsFromIni.discardClippedText;
+    control.skipHiddenContent = globalOptionsFromIni.skipHiddenContent;
+    control.marginBottom = globalOptionsFromIni.marginBottom;
+    control.marginTop = globalOptionsFromIni.marginTop;
+    control.marginLeft = globalOptionsFromIni.marginLeft;
+    control.marginRight = globalOptionsFromIni.marginRight;
+    control.mode = globalOptionsFromIni.textOutputMode;
+}
+
+/**
+* Create text extractor on the first extraction.
+*
+* @param[in,out]    data    pointer to request data
+* @return true if text extractor is valid
+*/
+bool TcOutputDev::initDevice(ThreadData* data)
+{
+    if (!m_dev)
+    {
+        setTextOutputControl(toc);
+
+        // register #outputFunction as a callback function for text extraction
+        m_dev = std::make_unique<TextOutputDev>(&outputFunction, data, &toc);
+    }
+    return m_dev && m_dev->isOk();
+}
+
+/**
+* Start text extraction.
+* Extraction goes through all document pages until search string is found.
+* If #options_t::extractAnnotations is set, text of annotations and form fields
+* is extracted after the text of each page.
+* If a resource limit is exceeded, extraction stops with the text extracted so far.
+* Resources are measured from firstPage, extraction which resumes previous call
+* (e.g. after PDFDocEx::isFirstPageOnly document) counts them together with it.
+* Search (bulk) extraction pauses between pages while interactive requests are in progress,
+* decodes content streams of next pages in a helper thread, see ContentDecoder,
+* and reads content streams of the page after them ahead, see ReadAhead.
+*
+* @param[in]        doc         pointer to xPDF PdcDoc instance
+* @param[in,out]    data        pointer to request data
+* @param[in]        firstPage   number of the first page to extract
+* @param[in]        resume      extraction continues previous call, resource limits are not reset
+*/
+void TcOutputDev::output(PDFDoc* doc, ThreadData* data, int firstPage, bool resume)
+{
+    if (data && doc && doc->isOk())
+    {
+        if (initDevice(data))
+        {
+            const auto annotations{ globalOptionsFromIni.extractAnnotations && (data->getRequestField() == fiText) };
+            if (annotations)
+            {
+                loadFieldPages(doc);
+            }
+            const auto bulk{ RequestScheduler::isBulk(data->getRequestField()) };
+            const auto decodeAhead{ bulk ? static_cast<int>(globalOptionsFromIni.decodeAheadPages) : 0 };
+            GBool (*savedContentsCbk)(void*, int, Object*) { nullptr };
+            void* savedContentsCbkData{ nullptr };
+            if (decodeAhead)
+            {
+                Page::getContentsCbk(&savedContentsCbk, &savedContentsCbkData);
+                Page::setContentsCbk(&ContentDecoder::getContents, &m_decoder);
+            }
+            // continuation of previous extraction keeps measured resources
+            if (!resume)
+            {
+                m_governor.start(data, m_dev.get());
+            }
             // for each page
-            for (int page{ 1 }; (page <= doc->getNumPages()) && (requestStatus::active == data->getStatus()); ++page) {
+            for (int page{ firstPage }; (page <= doc->getNumPages()) && (requestStatus::active == data->getStatus()) && !m_governor.exceeded(); ++page) {
+                if (bulk)
+                {
+                    // current page has been queued with previous page, except the first one
+                    if (decodeAhead)
+                    {
+                        m_decoder.queuePages(doc, (page == firstPage) ? page + 1 : page, page + decodeAhead);
+                    }
+                    m_readAhead.queuePage(doc, page + 1 + decodeAhead);
+                }
                 // extract text from page
-                doc->displayPage(m_dev.get(), page, 72.0, 72.0, 0, gFalse, gTrue, gFalse, abortExtraction, data);
+                doc->displayPage(m_dev.get(), page, 72.0, 72.0, 0, gFalse, gTrue, gFalse, abortExtraction, &m_governor);
+                // extract text from annotations and form fields
+                if (annotations && !outputAnnotations(doc, page, data))
+                {
+                    outputFormFields(doc, page, data);
+                }
                 // release page resources
                 doc->getCatalog()->doneWithPage(page);
+                // let column values of visible files overtake search
+                if (bulk)
+                {
+                    m_governor.pause(RequestScheduler::yield(data));
+                }
+            }
+            m_readAhead.cancel();
+            if (decodeAhead)
+            {
+                m_decoder.cancel();
+                Page::setContentsCbk(savedContentsCbk, savedContentsCbkData);
+            }
+        }
+    }
+}
+
+/**
+* Extract text of selected pages only, in compare of two revisions of a document, see RevisionDiff.
+* Pages are not decoded or read ahead, they are usually few and far apart.
+* If #options_t::extractAnnotations is set, text of annotations and form fields
+* is extracted after the text of each page.
+*
+* @param[in]        doc     pointer to xPDF PdcDoc instance
+* @param[in,out]    data    pointer to request data
+* @param[in]        pages   page numbers in ascending order
+*/
+void TcOutputDev::outputPages(PDFDoc* doc, ThreadData* data, const std::vector<int>& pages)
+{
+    if (data && doc && doc->isOk() && initDevice(data))
+    {
+        const auto annotations{ globalOptionsFromIni.extractAnnotations && (data->getRequestField() == fiText) };
+        if (annotations)
+        {
+            loadFieldPages(doc);
+        }
+        m_governor.start(data, m_dev.get());
+        for (const auto page : pages)
+        {
+            if ((page < 1) || (page > doc->getNumPages()) || (requestStatus::active != data->getStatus()) || m_governor.exceeded())
+            {
+                break;
+            }
+            doc->displayPage(m_dev.get(), page, 72.0, 72.0, 0, gFalse, gTrue, gFalse, abortExtraction, &m_governor);
+            if (annotations && !outputAnnotations(doc, page, data))
+            {
+                outputFormFields(doc, page, data);
             }
+            doc->getCatalog()->doneWithPage(page);
         }
     }
 }
+
+/**
+* Extract text from embedded PDF documents, after the text of parent document.
+* Embedded documents are extracted with the same text extractor and resource limits as the parent,
+* limits are not restarted. Annotations of embedded documents are not extracted.
+* Embedded file stream referred by more file specifications of one document is extracted once, see PDFDocEx::forEachEmbeddedPDF.
+* Decoding of embedded files can be aborted like decoding of content streams, see #abortExtraction.
+*
+* @param[in]        doc     parent PDF document
+* @param[in,out]    data    pointer to request data
+* @param[in]        depth   max nesting depth of embedded documents, 0 = none
+*/
+void TcOutputDev::outputEmbeddedFiles(PDFDocEx* doc, ThreadData* data, unsigned depth)
+{
+    if (!data || !doc || !doc->isOk() || !m_dev || !m_dev->isOk() || !depth)
+    {
+        return;
+    }
+
+    const auto bulk{ RequestScheduler::isBulk(data->getRequestField()) };
+    const auto canContinue{ [&]() { return (requestStatus::active == data->getStatus()) && !m_governor.exceeded(); } };
+    GBool (*savedAbortCbk)(void*) { nullptr };
+    void* savedAbortCbkData{ nullptr };
+    Stream::getAbortCheckCbk(&savedAbortCbk, &savedAbortCbkData);
+    Stream::setAbortCheckCbk(abortExtraction, &m_governor);
+    doc->forEachEmbeddedPDF([&](PDFDocEx* embedded)
+    {
+        for (int page{ 1 }; (page <= embedded->getNumPages()) && canContinue(); ++page)
+        {
+            embedded->displayPage(m_dev.get(), page, 72.0, 72.0, 0, gFalse, gTrue, gFalse, abortExtraction, &m_governor);
+            embedded->getCatalog()->doneWithPage(page);
+            if (bulk)
+            {
+                m_governor.pause(RequestScheduler::yield(data));
+            }
+        }
+        if ((depth > 1) && canContinue())
+        {
+            outputEmbeddedFiles(embedded, data, depth - 1);
+        }
+        return canContinue();
+    });
+    Stream::setAbortCheckCbk(savedAbortCbk, savedAbortCbkData);
+}
+
+/**
+* Extract text of XFA form data (values entered to XFA form), after the text of pages.
+* Datasets packet is streamed, DOM of XFA is not built, see XFADataExtractor.
+* Reading of XFA streams can be aborted like decoding of content streams, see #abortExtraction.
+*
+* @param[in]        doc     PDF document
+* @param[in,out]    data    pointer to request data
+*/
+void TcOutputDev::outputXFAData(PDFDoc* doc, ThreadData* data)
+{
+    if (!data || !doc || !doc->isOk() || (requestStatus::active != data->getStatus()) || m_governor.exceeded())
+    {
+        return;
+    }
+
+    GBool (*savedAbortCbk)(void*) { nullptr };
+    void* savedAbortCbkData{ nullptr };
+    Stream::getAbortCheckCbk(&savedAbortCbk, &savedAbortCbkData);
+    Stream::setAbortCheckCbk(abortExtraction, &m_governor);
+    XFADataExtractor(data).output(doc);
+    Stream::setAbortCheckCbk(savedAbortCbk, savedAbortCbkData);
+}
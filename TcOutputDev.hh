@@ -6,7 +6,17 @@
 
 #pragma once
 #include "ThreadData.hh"
+#include "ResourceGovernor.hh"
+#include "ReadAhead.hh"
+#include "ContentDecoder.hh"
 #include <memory>
+#include <vector>
+
+constexpr size_t TEXT_MEMORY_PER_CHAR{ 256U };      /**< approximate peak memory used by text layout per character on a page, in bytes */
+constexpr size_t TEXT_PART_CHARS_MIN{ 4096U };      /**< min number of characters in one part of a page extracted in parts */
+constexpr unsigned EMBEDDED_DEPTH_MAX{ 8U };        /**< max nesting depth of searched embedded PDF documents */
+
+class PDFDocEx;
 
 /**
 * Class for text extraction from PDF to TC.
@@ -18,8 +28,25 @@ public:
     TcOutputDev(const TcOutputDev&) = delete;
     TcOutputDev& operator=(const TcOutputDev&) = delete;
 
-    void output(PDFDoc* doc, ThreadData* data);
+    void output(PDFDoc* doc, ThreadData* data, int firstPage = 1, bool resume = false);
+    void outputPages(PDFDoc* doc, ThreadData* data, const std::vector<int>& pages);
+    void outputEmbeddedFiles(PDFDocEx* doc, ThreadData* data, unsigned depth);
+    void outputXFAData(PDFDoc* doc, ThreadData* data);
+    /** @return true if a resource limit has been exceeded in last #output */
+    bool limitExceeded() const { return m_governor.exceeded(); }
+    /** @return true if a resource limit of the document has been exceeded in last #output, see ResourceGovernor::shouldFlag */
+    bool shouldFlag() const { return m_governor.shouldFlag(); }
+    static void setTextOutputControl(TextOutputControl& control);
 private:
+    bool initDevice(ThreadData* data);
+    void loadFieldPages(PDFDoc* doc);
+    int outputAnnotations(PDFDoc* doc, int page, ThreadData* data);
+    int outputFormFields(PDFDoc* doc, int page, ThreadData* data);
+
     std::unique_ptr<TextOutputDev>  m_dev{ nullptr };   /**< text extractor */
     TextOutputControl               toc;                /**< settings for TextOutputDev */
+    std::vector<int>                m_fieldPages;       /**< page number of each AcroForm field, index is field index */
+    ResourceGovernor                m_governor;         /**< limits of resources used by extraction */
+    ReadAhead                       m_readAhead;        /**< read ahead of next page during search */
+    ContentDecoder                  m_decoder;          /**< decoding of next pages during search */
 };
@@ -5,8 +5,13 @@
 */
 
 #include "ThreadData.hh"
-#include "xPDFInfo.hh"
-#include <GlobalParams.h>
+#include "FieldIndexes.hh"
+#include "contentplug.h"
+#include <cwchar>
+#include <chrono>
+
+/** debug trace through #ThreadData::traceHook, no-op when hook is not set */
+#define TRACE(...) do { if (traceHook) traceHook(__VA_ARGS__); } while (false)
 
 /**
 * Convert PDF string to UTF-16 wide string (wchar_t), change byte endianess.
@@ -18,10 +23,10 @@
 * @param[in,out]    cbDst   [in] size of dst in bytes, [out] remaining dst size in bytes
 * @return number of src chars converted to dst
 */
-static ptrdiff_t PdfTxtToUTF16(const char* src, const ptrdiff_t cchSrc, wchar_t* dst, ptrdiff_t *cbDst)
+ptrdiff_t ThreadData::PdfTxtToUTF16(const char* src, const ptrdiff_t cchSrc, wchar_t* dst, ptrdiff_t *cbDst)
 {
     ptrdiff_t i{ 0 };
-    for (; (i < cchSrc) && (*cbDst > static_cast<ptrdiff_t>(sizeOfWchar) + 1); i += sizeOfWchar)
+    for (; (i < cchSrc) && (*cbDst > static_cast<ptrdiff_t>(sizeOfWchar) + 1); i += 2)   // source is UCS-2, 2 bytes per char
     {
         // swap bytes
         *dst = (*(src + i + 1) & 0xFF) | ((*(src + i) << 8U) & 0xFF00);
@@ -62,97 +67,131 @@ ptrdiff_t ThreadData::UnicodeToUTF16(const Unicode* src, ptrdiff_t cchSrc, wchar
 }
 
 /**
-* Create event that triggers producer action.
-* Event has automatic reset, initialy unlocked.
+* Append wide string to the NUL terminated string in a buffer of cbDst bytes.
+* String src is not appended if it doesn't fit into the buffer.
+*
+* @param[in,out]    dst     NUL terminated string
+* @param[in]        cbDst   size of dst buffer in bytes
+* @param[in]        src     string to append
+* @return true if src has been appended
 */
-void ThreadData::createProducer()
+static bool wcsCatBuf(wchar_t* dst, size_t cbDst, const wchar_t* src)
 {
-    if (!hasProducer())
-        handles[PRODUCER_HANDLE] = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    const auto cchDst{ cbDst / sizeof(wchar_t) };
+    const auto dstLen{ wcsnlen(dst, cchDst) };
+    const auto srcLen{ wcslen(src) };
+    if (dstLen + srcLen < cchDst)
+    {
+        wmemcpy(dst + dstLen, src, srcLen + 1);
+        return true;
+    }
+    return false;
 }
 
 /**
-* Create event that notifies consumer that data from producer is ready.
-* Event has automatic reset, initialy unlocked.
+* Copy wide string to a buffer of cbDst bytes.
+* String src is not copied if it doesn't fit into the buffer.
+*
+* @param[out]       dst     destination buffer
+* @param[in]        cbDst   size of dst buffer in bytes
+* @param[in]        src     string to copy
+* @return true if src has been copied
 */
-void ThreadData::createConsumer()
+static bool wcsCopyBuf(wchar_t* dst, size_t cbDst, const wchar_t* src)
 {
-    if (!hasConsumer())
-        handles[CONSUMER_HANDLE] = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    const auto srcLen{ wcslen(src) };
+    if (srcLen < cbDst / sizeof(wchar_t))
+    {
+        wmemcpy(dst, src, srcLen + 1);
+        return true;
+    }
+    return false;
 }
 
 /**
-* Create worker (producer) thread.
-* @param[in]    func    pointer to thread function
-* @param[in]    args    parameter for thread function
-* @return thread ID if worker thread has been successfully created or already running, 0 if error.
+* Raise event and release one waiting thread.
+* If there is no waiting thread, event stays signaled until the next wait.
 */
-uint32_t ThreadData::createWorker(_beginthreadex_proc_type func, void* args)
+void SyncEvent::set()
 {
-    static auto threadID{ 0U };
-    // if worker thread has not been created...
-    if (!hasWorker())
-    {
-        // start new worker thread
-        handles[WORKER_HANDLE] = reinterpret_cast<HANDLE>(_beginthreadex(nullptr, 0, func, args, 0, &threadID));
-        if (handles[WORKER_HANDLE])
-        {
-            // wait a little bit for thread to start...
-            const auto dwRet{ WaitForSingleObject(handles[WORKER_HANDLE], 10UL) };
-            if (dwRet != WAIT_TIMEOUT)
-            {
-                TRACE(L"%hs!new thread %x ended prematurely\n", __FUNCTION__, handles[WORKER_HANDLE]);
-                threadID = 0;
-            }
-        }
-        else
-        {
-            TRACE(L"%hs!unable to start new thread\n", __FUNCTION__);
-        }
-    }
-#if 0
-    else
-    {
-        // get running thread ID
-        threadID = GetThreadId(handles[WORKER_HANDLE]);
-    }
-#endif
-    return threadID;
+    // notify under lock, waiting thread may destroy event as soon as wait returns
+    std::lock_guard lock(m_mutex);
+    m_signaled = true;
+    m_cv.notify_one();
 }
 
 /**
-* Close consumer event handle.
+* Reset event to non-signaled state.
 */
-void ThreadData::closeConsumer()
+void SyncEvent::reset()
 {
-    if (hasConsumer())
+    std::lock_guard lock(m_mutex);
+    m_signaled = false;
+}
+
+/**
+* Wait until event is raised or timeout expires.
+* Event is reset when wait is satisfied.
+*
+* @param[in]    timeout     timeout in miliseconds, #INFINITE_TIMEOUT to wait without timeout
+* @return #waitResult::signaled if event has been raised, #waitResult::timeout if timeout expired
+*/
+waitResult SyncEvent::wait(uint32_t timeout)
+{
+    std::unique_lock lock(m_mutex);
+    const auto isSignaled{ [this] { return m_signaled; } };
+    if (timeout == INFINITE_TIMEOUT)
     {
-        CloseHandle(handles[CONSUMER_HANDLE]);
-        handles[CONSUMER_HANDLE] = nullptr;
+        m_cv.wait(lock, isSignaled);
     }
+    else if (!m_cv.wait_for(lock, std::chrono::milliseconds(timeout), isSignaled))
+    {
+        return waitResult::timeout;
+    }
+    m_signaled = false;
+    return waitResult::signaled;
 }
 
 /**
-* Close producer event handle.
+* Create worker (producer) thread.
+* @param[in]    func    pointer to thread function
+* @param[in]    args    parameter for thread function
+* @return true if worker thread has been successfully created or already running, false if error.
 */
-void ThreadData::closeProducer()
+bool ThreadData::createWorker(void (*func)(void*), void* args)
 {
-    if (hasProducer())
+    // if worker thread has not been created...
+    if (!hasWorker())
     {
-        CloseHandle(handles[PRODUCER_HANDLE]);
-        handles[PRODUCER_HANDLE] = nullptr;
+        // thread keeps its own reference to exit event, ThreadData may be released before the thread ends
+        workerExit = std::make_shared<SyncEvent>();
+        // start new worker thread
+        worker = std::thread([exit = workerExit, func, args]()
+        {
+            func(args);
+            exit->set();
+        });
+        // wait a little bit for thread to start...
+        if (workerExit->wait(10U) != waitResult::timeout)
+        {
+            TRACE(L"%hs!new thread ended prematurely\n", __FUNCTION__);
+            closeWorker();
+            return false;
+        }
     }
+    return true;
 }
 
 /**
-* Close worker thread handle.
+* Release worker thread.
+* Thread is detached, not joined. Worker raises #workerExit through its own reference, so ThreadData
+* may be released as soon as the thread function returns, and joining a thread from DllMain would deadlock on the loader lock.
 */
 void ThreadData::closeWorker()
 {
     if (hasWorker())
     {
-        CloseHandle(handles[WORKER_HANDLE]);
-        handles[WORKER_HANDLE] = nullptr;
+        worker.detach();
     }
 }
 
@@ -160,28 +199,22 @@ void ThreadData::closeWorker()
 * Wait until producer event is raised or timeout expires.
 *
 * @param[in]    timeout     timeout in miliseconds
-* @return 1 if producer event is not created; for other return values check MSDN WaitForSingleObject
+* @return result of wait, see #SyncEvent::wait
 */
-DWORD ThreadData::waitForProducer(DWORD timeout)
+waitResult ThreadData::waitForProducer(uint32_t timeout)
 {
-    if (hasProducer())
-        return WaitForSingleObject(handles[PRODUCER_HANDLE], timeout);
-
-    return 1UL;
+    return producer.wait(timeout);
 }
 
 /**
 * Wait until consumer event is raised or timeout expires.
 *
 * @param[in]    timeout     timeout in miliseconds
-* @return 1 if consumer event is not created; for other return values check MSDN WaitForSingleObject
+* @return result of wait, see #SyncEvent::wait
 */
-DWORD ThreadData::waitForConsumer(DWORD timeout)
+waitResult ThreadData::waitForConsumer(uint32_t timeout)
 {
-    if (hasConsumer())
-        return WaitForSingleObject(handles[CONSUMER_HANDLE], timeout);
-
-    return 1UL;
+    return consumer.wait(timeout);
 }
 
 /**
@@ -189,14 +222,17 @@ DWORD ThreadData::waitForConsumer(DWORD timeout)
 * Event is raised if producer thread is running.
 *
 * @param[in]    timeout     timeout in miliseconds
-* @return 1 if producer event is not created; for other return values check MSDN SignalObjectAndWait
+* @return #waitResult::failed if worker thread is not running, otherwise result of wait for thread exit
 */
-DWORD ThreadData::notifyProducerAndWait(DWORD timeout)
+waitResult ThreadData::notifyProducerAndWait(uint32_t timeout)
 {
-    if (hasProducer() && hasWorker())
-        return SignalObjectAndWait(handles[PRODUCER_HANDLE], handles[WORKER_HANDLE], timeout, FALSE);
+    if (hasWorker())
+    {
+        notifyProducer();
+        return workerExit->wait(timeout);
+    }
 
-    return 1UL;
+    return waitResult::failed;
 }
 
 /**
@@ -205,22 +241,23 @@ DWORD ThreadData::notifyProducerAndWait(DWORD timeout)
 * If timeout expires, producer event is reset.
 *
 * @param[in]    timeout     timeout in miliseconds
-* @return 1 if producer event is not created; for other return values check MSDN SignalObjectAndWait
+* @return #waitResult::failed if producer thread is not active, otherwise result of wait for consumer event
 */
-DWORD ThreadData::notifyProducerWaitForConsumer(DWORD timeout)
+waitResult ThreadData::notifyProducerWaitForConsumer(uint32_t timeout)
 {
-    auto dwRet{ WAIT_FAILED };
-    if (isActive() && hasProducer() && hasConsumer())
+    auto ret{ waitResult::failed };
+    if (isActive())
     {
         TRACE(L"%hs\n", __FUNCTION__);
-        dwRet = SignalObjectAndWait(handles[PRODUCER_HANDLE], handles[CONSUMER_HANDLE], timeout, FALSE);
-        if (dwRet != WAIT_OBJECT_0)
+        notifyProducer();
+        ret = waitForConsumer(timeout);
+        if (ret != waitResult::signaled)
         {
             // producer should wait for next call
             resetProducer();
         }
     }
-    return dwRet;
+    return ret;
 }
 
 
@@ -232,23 +269,30 @@ DWORD ThreadData::notifyProducerWaitForConsumer(DWORD timeout)
 * @param[in]    timeout     timeout in miliseconds
 * @return compared results of extractions
 */
-int ThreadData::compareWaitForConsumers(ThreadData* searcher, DWORD timeout)
+int ThreadData::compareWaitForConsumers(ThreadData* searcher, uint32_t timeout)
 {
     auto result{ ft_fileerror };
 
-    if (isActive() && hasProducer() && hasConsumer()
-        && searcher && searcher->isActive()
-        && searcher->hasProducer() && searcher->hasConsumer())
+    if (isActive() && searcher && searcher->isActive())
     {
         notifyProducer();
         searcher->notifyProducer();
 
-        const HANDLE consumers[] { handles[CONSUMER_HANDLE] , searcher->handles[CONSUMER_HANDLE] };
-        // wait unitl both threads signal that they completed extraction
-        const auto dwRet{ WaitForMultipleObjects(ARRAYSIZE(consumers), consumers, TRUE, timeout) };
-        switch (dwRet)
+        // wait unitl both threads signal that they completed extraction, timeout is shared by both waits
+        const auto startTime{ std::chrono::steady_clock::now() };
+        auto ret{ waitForConsumer(timeout) };
+        if ((ret == waitResult::signaled) && (timeout != INFINITE_TIMEOUT))
         {
-        case WAIT_OBJECT_0:
+            const auto elapsed{ std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count() };
+            timeout = (elapsed < timeout) ? static_cast<uint32_t>(timeout - elapsed) : 0U;
+        }
+        if (ret == waitResult::signaled)
+        {
+            ret = searcher->waitForConsumer(timeout);
+        }
+        switch (ret)
+        {
+        case waitResult::signaled:
         {
             auto result1{ ft_fileerror };
             auto result2{ ft_fileerror };
@@ -264,35 +308,43 @@ int ThreadData::compareWaitForConsumers(ThreadData* searcher, DWORD timeout)
             result = (result1 == result2) ? result1 : ft_compare_not_eq;
             break;
         }
-        case WAIT_TIMEOUT:
+        case waitResult::timeout:
             [[fallthrough]];
         default:
             result = ft_compare_abort;
             break;
         }
-        TRACE(L"%hs!consumers!dw=0x%lx result=%d\n", __FUNCTION__, dwRet, result);
+        TRACE(L"%hs!consumers!ret=%d result=%d\n", __FUNCTION__, static_cast<int>(ret), result);
     }
     return result;
 }
 
 /**
 * Create extraction (producer) thread.
-* Create producer and consumer events if they don't already exist.
 *
 * @param[in]    func    pointer to thread function
 * @param[in]    args    parameter for thread function
-* @return thread ID if worker thread has been successfully created or already running, 0 if error.
+* @return true if worker thread has been successfully created or already running, false if error.
 */
-uint32_t ThreadData::start(_beginthreadex_proc_type func, void* args)
+bool ThreadData::start(void (*func)(void*), void* args)
 {
-    createConsumer();
-    createProducer();
+    return createWorker(func, args);
+}
 
-    if (hasConsumer() && hasProducer())
+/**
+* Wake producer up after its request has been cancelled or completed, and wait until it is idle.
+* Cancel-to-idle latency is measured, abort checks in Gfx and stream decoders should keep it
+* below #CANCEL_LATENCY, longer cancels are traced.
+*/
+void ThreadData::waitForCancel()
+{
+    const auto start{ std::chrono::steady_clock::now() };
+    const auto ret{ notifyProducerWaitForConsumer(CONSUMER_TIMEOUT) };
+    const auto latency{ std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() };
+    if ((ret != waitResult::failed) && (latency > CANCEL_LATENCY))
     {
-        return createWorker(func, args);
+        TRACE(L"%hs!cancel latency %lld ms\n", __FUNCTION__, static_cast<long long>(latency));
     }
-    return 0;
 }
 
 /**
@@ -308,7 +360,7 @@ void ThreadData::stop()
         // reset consumer event that producer might have set
         resetConsumer();
         // wake up producer and close document
-        notifyProducerWaitForConsumer(CONSUMER_TIMEOUT);
+        waitForCancel();
     }
 }
 
@@ -324,7 +376,7 @@ void ThreadData::done()
         // reset consumer event that producer might have set
         resetConsumer();
         // wake up producer and close document
-        notifyProducerWaitForConsumer(CONSUMER_TIMEOUT);
+        waitForCancel();
     }
 }
 
@@ -353,12 +405,11 @@ void ThreadData::abort()
 
 /**
 * Destructor
-* Close handles and delete #Request::buffer
+* Release worker thread and delete #Request::buffer
 */
 ThreadData::~ThreadData()
 {
-    closeConsumer();
-    closeProducer();
+    closeWorker();
     request.release();
 }
 
@@ -372,7 +423,7 @@ ThreadData::~ThreadData()
 * @param[in]    timeout         producer timeout (in text extraction)
 * @return       ft_setsuccess if there is no available data to read, ft_timeout if consumer should get data
 */
-int ThreadData::initRequest(const wchar_t* fileName, int field, int unit, int flags, DWORD timeout)
+int ThreadData::initRequest(const wchar_t* fileName, int field, int unit, int flags, uint32_t timeout)
 {
     int result{ ft_setsuccess };
     std::lock_guard lock(mutex);
@@ -381,6 +432,8 @@ int ThreadData::initRequest(const wchar_t* fileName, int field, int unit, int fl
     request.unit = unit;
     request.flags = flags;
     request.timeout = timeout;
+    request.pages.clear();
+    request.firstPage = 1;
 
     // for continuous full text search, don't move ptr to the beginning, it may point to extracted data
     if (!(((field == fiText) || (field == fiOutlines)) && (unit > 0)))
@@ -403,6 +456,52 @@ int ThreadData::initRequest(const wchar_t* fileName, int field, int unit, int fl
     return result;
 }
 
+/**
+* Set pages to extract text from, after #initRequest.
+* Used by compare, when only some pages of two revisions of a document can differ.
+*
+* @param[in]    pages           page numbers in ascending order, empty = all pages
+*/
+void ThreadData::setRequestPages(const std::vector<int>& pages)
+{
+    std::lock_guard lock(mutex);
+    request.pages = pages;
+}
+
+/**
+* Get pages to extract text from.
+*
+* @return page numbers in ascending order, empty = all pages
+*/
+std::vector<int> ThreadData::getRequestPages()
+{
+    std::lock_guard lock(mutex);
+    return request.pages;
+}
+
+/**
+* Set page to start text extraction from, after #initRequest.
+* Used when TC continues to search in text which has been partially prefetched, see SearchPrefetcher.
+*
+* @param[in]    firstPage       number of the first page
+*/
+void ThreadData::setRequestFirstPage(int firstPage)
+{
+    std::lock_guard lock(mutex);
+    request.firstPage = firstPage;
+}
+
+/**
+* Get page to start text extraction from.
+*
+* @return number of the first page
+*/
+int ThreadData::getRequestFirstPage()
+{
+    std::lock_guard lock(mutex);
+    return request.firstPage;
+}
+
 /**
 * Convert data from PDF text extraction to TC output buffer.
 * Used for #fiFirstRow, #fiDocStart, #fiText and #fiOutlines.
@@ -420,7 +519,6 @@ int ThreadData::initRequest(const wchar_t* fileName, int field, int unit, int fl
 */
 int ThreadData::output(const char *text, ptrdiff_t len, bool textIsUnicode)
 {
-    static const auto eol{ globalParams->getTextEOL() };
     do
     {
         int field{ 0 };
@@ -430,11 +528,14 @@ int ThreadData::output(const char *text, ptrdiff_t len, bool textIsUnicode)
             // get data from request structure for later use outside of lock
             const auto timeout{ request.timeout };
             cbDstW = request.remaining();
-            while (cbDstW <= 2)
+            while (cbDstW <= sizeOfWchar)
             {
                 lock.unlock();
                 // wait for TC to get data
-                if (waitForProducer(timeout) != WAIT_OBJECT_0)
+                const auto start{ std::chrono::steady_clock::now() };
+                const auto ret{ waitForProducer(timeout) };
+                outputWait += std::chrono::steady_clock::now() - start;
+                if (ret != waitResult::signaled)
                 {
                     setStatusCond(requestStatus::cancelled, requestStatus::active);
                     return 1;
@@ -481,22 +582,22 @@ int ThreadData::output(const char *text, ptrdiff_t len, bool textIsUnicode)
                 else if (field == fiOutlines)
                 {
                     request.result = ft_fulltextw;
-                    if (cbDstW > 4)
+                    if (cbDstW > 2 * sizeOfWchar)
                     {
                         if (eol == eolUnix)
                         {
-                            StringCbCatW(dstW, cbDstWtmp, L"\n");
-                            cbDstW -= 2;
+                            wcsCatBuf(dstW, cbDstWtmp, L"\n");
+                            cbDstW -= sizeOfWchar;
                         }
                         else if (eol == eolDOS)
                         {
-                            StringCbCatW(dstW, cbDstWtmp, L"\r\n");
-                            cbDstW -= 4;
+                            wcsCatBuf(dstW, cbDstWtmp, L"\r\n");
+                            cbDstW -= 2 * sizeOfWchar;
                         }
                         else if (eol == eolMac)
                         {
-                            StringCbCatW(dstW, cbDstWtmp, L"\r");
-                            cbDstW -= 2;
+                            wcsCatBuf(dstW, cbDstWtmp, L"\r");
+                            cbDstW -= sizeOfWchar;
                         }
                     }
                     TRACE(L"%hs!outlines!buffer=%p ptr=%p!outline=[%ls]", __FUNCTION__, request.buffer, request.ptr, static_cast<const wchar_t*>(request.buffer));
@@ -513,7 +614,7 @@ int ThreadData::output(const char *text, ptrdiff_t len, bool textIsUnicode)
                         cbDstW = 0;     // flag to exit extraction
                         len = 0;        // stop conversion, ft_stringw doesn't support multiple calls as ft_fulltextw does
                     }
-                    else if (cbDstW <= 2)
+                    else if (cbDstW <= sizeOfWchar)
                     {
                         len = 0;        // stop conversion
                     }
@@ -530,7 +631,7 @@ int ThreadData::output(const char *text, ptrdiff_t len, bool textIsUnicode)
         }
 
         // if no bytes left in dest buffer
-        if (cbDstW <= 2)
+        if (cbDstW <= sizeOfWchar)
         {
             if ((field == fiText) || (field == fiOutlines))
             {
@@ -581,7 +682,7 @@ void ThreadData::setWcharValue(wchar_t* value, int type)
         auto len{ REQUEST_BUFFER_SIZE };
         std::lock_guard lock(mutex);
         auto dst{ static_cast<wchar_t*>(getRequestBuffer()) };
-        if (SUCCEEDED(StringCbCopyW(dst, len, value)))
+        if (wcsCopyBuf(dst, len, value))
         {
             setRequestResult(type);
         }
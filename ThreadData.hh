@@ -6,31 +6,27 @@
 
 #pragma once
 
-#include <Windows.h>
-#include <process.h>
 #include <TextOutputDev.h>
 #include <GList.h>
 #include <Outline.h>
 #include <PDFDoc.h>
 #include <TextString.h>
+#include <GlobalParams.h>
 
 #include <mutex>
 #include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <chrono>
 
-#include <strsafe.h>
-
-/**
-* @defgroup handles ThreadData::handles indexes
-* @{ */
-constexpr auto WORKER_HANDLE{ 0U };     /**< worker thread handle index in #ThreadData::handles[] */
-constexpr auto CONSUMER_HANDLE{ 1U };   /**< consumer event handle index in #ThreadData::handles[] */
-constexpr auto PRODUCER_HANDLE{ 2U };   /**< producer event handle index in #ThreadData::handles[] */
-constexpr auto MAX_THREAD_HANDLES{ 3U }; /**< max ThreadData handles */
-/** @} */
+constexpr uint32_t INFINITE_TIMEOUT{ UINT32_MAX };  /**< wait without timeout */
 
 #if 0
-constexpr auto CONSUMER_TIMEOUT{ INFINITE };
-constexpr auto PRODUCER_TIMEOUT{ 100UL };
+constexpr auto CONSUMER_TIMEOUT{ INFINITE_TIMEOUT };
+constexpr uint32_t PRODUCER_TIMEOUT{ 100U };
 #else
 /**
 * wait for 10 s for producer to produce data (form PDF)
@@ -39,14 +35,53 @@ constexpr auto PRODUCER_TIMEOUT{ 100UL };
 * it is a bad idea to have infinite wait
 */
 
-constexpr auto CONSUMER_TIMEOUT{ 10000UL };  /**< time for one data extraction */
-constexpr auto PRODUCER_TIMEOUT{ 100UL };    /**< extractor waits for next request from TC, or closes PDF document */
+constexpr uint32_t CONSUMER_TIMEOUT{ 10000U };  /**< time for one data extraction */
+constexpr uint32_t PRODUCER_TIMEOUT{ 100U };    /**< extractor waits for next request from TC, or closes PDF document */
 #endif
 
+constexpr uint32_t CANCEL_LATENCY{ 100U };      /**< expected max time from cancel to idle producer, longer cancels are traced */
+
 constexpr auto REQUEST_BUFFER_SIZE{ 2048U };    /**< size of Request.buffer, if not provided form TC */
 
 constexpr auto sizeOfWchar{ static_cast<int>(sizeof(wchar_t)) };/**< sizeof wchar_t */
 
+/**
+* Debug trace function, see #ThreadData::setTraceHook
+*/
+typedef bool (*TraceHook)(const wchar_t* format, ...);
+
+/**
+* Result of waiting for #SyncEvent
+*/
+enum class waitResult
+{
+    signaled,   /**< event has been signaled */
+    timeout,    /**< timeout expired before event was signaled */
+    failed,     /**< wait is not possible, e.g. thread is not active */
+};
+
+/**
+* Auto-reset event.
+* Portable replacement for Win32 event object created with CreateEventW(nullptr, FALSE, FALSE, nullptr).
+* Signaled event releases one waiting thread and resets itself.
+*/
+class SyncEvent
+{
+public:
+    SyncEvent() = default;
+    SyncEvent(const SyncEvent&) = delete;
+    SyncEvent& operator=(const SyncEvent&) = delete;
+
+    void set();
+    void reset();
+    waitResult wait(uint32_t timeout);
+
+private:
+    std::mutex              m_mutex;                /**< protects #m_signaled */
+    std::condition_variable m_cv;                   /**< wakes up waiting thread */
+    bool                    m_signaled{ false };    /**< event state */
+};
+
 /** 
 * Request status enumeration 
 */
@@ -67,11 +102,13 @@ struct Request
     int unit{ 0 };                      /**< unit index */
     int flags{ 0 };                     /**< flags from TC */
     int result{ 0 };                    /**< result of an extraction */
-    DWORD timeout{ 0 };                 /**< time to wait in text extraction procedure */
+    uint32_t timeout{ 0 };              /**< time to wait in text extraction procedure */
     std::atomic<requestStatus> status{ requestStatus::closed };   /**< request status, @see request_status */
     void* buffer{ new char[REQUEST_BUFFER_SIZE] };                  /**< extracted data buffer */
     void* ptr{ buffer };                                            /**< pointer to end of extracted data, offset pointer to buffer */
     const wchar_t* fileName{ nullptr }; /**< name of PDF document */
+    std::vector<int> pages;             /**< pages to extract text from, empty = all pages */
+    int firstPage{ 1 };                 /**< page to start text extraction from */
     auto remaining() const { return (buffer ? (REQUEST_BUFFER_SIZE - (static_cast<char*>(ptr) - static_cast<char*>(buffer))) : 0); }
     void release() { delete[] static_cast<char*>(buffer); buffer = nullptr; ptr = nullptr; }
 };
@@ -85,26 +122,27 @@ public:
     std::mutex mutex;                  /**< mutex to protect Request structure while exchanging data */
 
 public:
-    ThreadData() = default;
+    explicit ThreadData(EndOfLineKind eol = eolUnix) : eol{ eol } { };
     ThreadData(const ThreadData&) = delete;
     ThreadData& operator=(const ThreadData&) = delete;
     ~ThreadData();
 
-    inline void resetProducer() { ResetEvent(handles[PRODUCER_HANDLE]); }
-    inline void notifyConsumer() { SetEvent(handles[CONSUMER_HANDLE]); };
-    auto hasProducer() const { return (handles[PRODUCER_HANDLE] != nullptr); }
-    auto hasConsumer() const { return (handles[CONSUMER_HANDLE] != nullptr); }
-    DWORD waitForProducer(DWORD timeout);
-    DWORD waitForConsumer(DWORD timeout);
-    int compareWaitForConsumers(ThreadData* searcher, DWORD timeout);
-    DWORD notifyProducerWaitForConsumer(DWORD timeout);
-    // DWORD notifyConsumerWaitForProducer(DWORD timeout);
-    DWORD notifyProducerAndWait(DWORD timeout);
-    uint32_t start(_beginthreadex_proc_type func, void* args);
+    inline void resetProducer() { producer.reset(); }
+    inline void notifyConsumer() { consumer.set(); };
+    waitResult waitForProducer(uint32_t timeout);
+    waitResult waitForConsumer(uint32_t timeout);
+    int compareWaitForConsumers(ThreadData* searcher, uint32_t timeout);
+    waitResult notifyProducerWaitForConsumer(uint32_t timeout);
+    waitResult notifyProducerAndWait(uint32_t timeout);
+    bool start(void (*func)(void*), void* args);
     void abort();
     void done();
     void stop();
     int output(const char* text, ptrdiff_t len, bool textIsUnicode);
+    /** @return total time the producer has waited in #output for TC to take the text, used by producer thread only */
+    auto getOutputWaitTime() const { return outputWait; }
+    static void setTraceHook(TraceHook hook) { traceHook = hook; }
+    static ptrdiff_t PdfTxtToUTF16(const char* src, const ptrdiff_t cchSrc, wchar_t* dst, ptrdiff_t *cbDst);
     inline bool isActive() const { return active; }
     inline bool setActive(bool state) { return active.exchange(state); }
     inline requestStatus getStatus() const { return request.status; }
@@ -115,7 +153,7 @@ public:
         request.status.compare_exchange_strong(expected, new_status);
         return expected;
     }
-    int initRequest(const wchar_t* fileName, int field, int unit, int flags, DWORD timeout);
+    int initRequest(const wchar_t* fileName, int field, int unit, int flags, uint32_t timeout);
 
     template<typename T> void setValue(T value, int type);
 #if defined(_MSC_VER) && !defined(__llvm__)
@@ -130,8 +168,12 @@ public:
     auto getRequestBuffer() const { return request.buffer; }
     auto getRequestPtr() const { return request.ptr; }
     auto getRequestFileName() const { return request.fileName; }
+    std::vector<int> getRequestPages();
+    int getRequestFirstPage();
 
     void setRequestResult(int result) { request.result = result; }
+    void setRequestPages(const std::vector<int>& pages);
+    void setRequestFirstPage(int firstPage);
     void setRequestPtr(void* ptr)
     { 
         if (request.buffer && (ptr >= request.buffer) && (ptr < static_cast<char*>(request.buffer) + REQUEST_BUFFER_SIZE))
@@ -141,16 +183,19 @@ public:
 private:
     Request request;                    /**< extraction request */
     std::atomic_bool active{ false };   /**< thread status, true when active */
-    HANDLE handles[MAX_THREAD_HANDLES]{ nullptr };  /**< thread, producer and consumer event handles */
-    void createProducer();
-    void createConsumer();
-    uint32_t createWorker(_beginthreadex_proc_type func, void* args);
-    void closeProducer();
-    void closeConsumer();
+    SyncEvent producer;                 /**< raised by consumer (TC) to start or continue extraction */
+    SyncEvent consumer;                 /**< raised by producer (worker) when extracted data is ready */
+    std::shared_ptr<SyncEvent> workerExit;  /**< raised by worker thread before it exits, shared with the thread */
+    std::thread worker;                 /**< worker (producer) thread */
+    const EndOfLineKind eol;            /**< end of line appended to outline items */
+    std::chrono::steady_clock::duration outputWait{ };  /**< time spent in #output waiting for TC, see #getOutputWaitTime */
+    static inline TraceHook traceHook{ nullptr };   /**< debug trace, set by plugin before any thread starts */
+    bool createWorker(void (*func)(void*), void* args);
     void closeWorker();
-    inline auto hasWorker() const { return (handles[WORKER_HANDLE] != nullptr); }
-    inline void notifyProducer() { SetEvent(handles[PRODUCER_HANDLE]); }
-    inline void resetConsumer() { ResetEvent(handles[CONSUMER_HANDLE]); }
+    inline auto hasWorker() const { return worker.joinable(); }
+    inline void notifyProducer() { producer.set(); }
+    inline void resetConsumer() { consumer.reset(); }
+    void waitForCancel();
     void setGStringValue(GString* value, int type);
     void setWcharValue(wchar_t* value, int type);
 
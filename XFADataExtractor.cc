@@ -0,0 +1,449 @@
+/**
+* @file
+*
+* Extraction of text of XFA form data.
+*/
+
+#include "XFADataExtractor.hh"
+#include <Catalog.h>
+#include <charconv>
+
+/**
+* Output text of datasets packet of XFA form.
+* XFA is either one stream with whole XDP document, or an array of packet names and streams.
+* From the array, only datasets packet is read.
+*
+* @param[in]    doc     PDF document
+* @return   0 - extraction should continue, 1 - extraction should abort
+*/
+int XFADataExtractor::output(PDFDoc* doc)
+{
+    int ret{ 0 };
+    const auto acroForm{ doc->getCatalog()->getAcroForm() };
+    if (!acroForm->isDict())
+    {
+        return ret;
+    }
+
+    Object xfa;
+    if (acroForm->dictLookup("XFA", &xfa)->isStream())
+    {
+        ret = outputStream(xfa.getStream());
+    }
+    else if (xfa.isArray())
+    {
+        for (int i{ 0 }; !ret && (i + 1 < xfa.arrayGetLength()); i += 2)
+        {
+            Object name, packet;
+            if (xfa.arrayGet(i, &name)->isString() && !name.getString()->cmp("datasets")
+                && xfa.arrayGet(i + 1, &packet)->isStream())
+            {
+                ret = outputStream(packet.getStream());
+            }
+            packet.free();
+            name.free();
+        }
+    }
+    xfa.free();
+    return ret;
+}
+
+/**
+* Read XFA stream in blocks and output text of its datasets packet.
+*
+* @param[in]    str     XFA stream
+* @return   0 - extraction should continue, 1 - extraction should abort
+*/
+int XFADataExtractor::outputStream(Stream* str)
+{
+    m_state = xmlState::text;
+    m_depth = 0;
+    m_inText = false;
+    m_utf8Bytes = 0;
+
+    int ret{ 0 };
+    std::vector<char> buf(XFA_READ_BLOCK_SIZE);
+    str->reset();
+    while (!ret && !Stream::checkForAbort())
+    {
+        const auto n{ str->getBlock(buf.data(), static_cast<int>(buf.size())) };
+        if (n <= 0)
+        {
+            break;
+        }
+        ret = parse(buf.data(), static_cast<size_t>(n));
+    }
+    str->close();
+
+    endText();
+    return ret ? ret : flush();
+}
+
+/**
+* Tokenize a block of XML, collect text inside xfa:datasets element.
+* Tokenizer state is kept between blocks.
+*
+* @param[in]    buf     block of XML
+* @param[in]    len     length of block in bytes
+* @return   0 - extraction should continue, 1 - extraction should abort
+*/
+int XFADataExtractor::parse(const char* buf, size_t len)
+{
+    for (size_t i{ 0 }; i < len; ++i)
+    {
+        const auto c{ buf[i] };
+        switch (m_state)
+        {
+        case xmlState::text:
+            if (c == '<')
+            {
+                m_state = xmlState::tagStart;
+            }
+            else if (m_depth > 0)
+            {
+                if (c == '&')
+                {
+                    m_entity.clear();
+                    m_state = xmlState::entity;
+                }
+                else
+                {
+                    addByte(static_cast<unsigned char>(c));
+                }
+            }
+            break;
+        case xmlState::entity:
+            if (c == ';')
+            {
+                addEntity();
+                m_state = xmlState::text;
+            }
+            else if ((c == '<') || (m_entity.size() >= XFA_ENTITY_MAX))
+            {
+                // not a reference, keep the text as it is
+                addChar('&');
+                for (const auto e : m_entity)
+                {
+                    addByte(static_cast<unsigned char>(e));
+                }
+                if (c == '<')
+                {
+                    m_state = xmlState::tagStart;
+                }
+                else
+                {
+                    addByte(static_cast<unsigned char>(c));
+                    m_state = xmlState::text;
+                }
+            }
+            else
+            {
+                m_entity.push_back(c);
+            }
+            break;
+        case xmlState::tagStart:
+            m_name.clear();
+            m_endTag = false;
+            m_emptyTag = false;
+            if ((c == '!') || (c == '?'))
+            {
+                m_name.push_back(c);
+                m_prev[0] = m_prev[1] = '\0';
+                m_state = xmlState::markup;
+            }
+            else
+            {
+                // element separates text nodes
+                endText();
+                if (c == '/')
+                {
+                    m_endTag = true;
+                }
+                else
+                {
+                    m_name.push_back(c);
+                }
+                m_state = xmlState::tagName;
+            }
+            break;
+        case xmlState::tagName:
+            if (c == '>')
+            {
+                endTag();
+            }
+            else if (c == '/')
+            {
+                m_emptyTag = true;
+                m_state = xmlState::tag;
+            }
+            else if ((c == ' ') || (c == '\t') || (c == '\r') || (c == '\n'))
+            {
+                m_state = xmlState::tag;
+            }
+            else if (m_name.size() < XFA_NAME_MAX)
+            {
+                m_name.push_back(c);
+            }
+            break;
+        case xmlState::tag:
+            if (c == '>')
+            {
+                endTag();
+            }
+            else if ((c == '"') || (c == '\''))
+            {
+                m_quote = c;
+                m_state = xmlState::attrValue;
+            }
+            else if (c == '/')
+            {
+                m_emptyTag = true;
+            }
+            else if ((c != ' ') && (c != '\t') && (c != '\r') && (c != '\n'))
+            {
+                m_emptyTag = false;
+            }
+            break;
+        case xmlState::attrValue:
+            if (c == m_quote)
+            {
+                m_state = xmlState::tag;
+            }
+            break;
+        case xmlState::markup:
+            // m_name holds start of markup until its type is known
+            if (m_name.size() < sizeof("![CDATA[") - 1)
+            {
+                m_name.push_back(c);
+                if (m_name == "![CDATA[")
+                {
+                    m_brackets = 0;
+                    m_state = xmlState::cdata;
+                    break;
+                }
+            }
+            // end of processing instruction ?>, comment --> or DOCTYPE >
+            if ((c == '>')
+                && ((m_name[0] == '?') ? (m_prev[1] == '?')
+                    : (m_name.compare(0, 3, "!--") || ((m_prev[0] == '-') && (m_prev[1] == '-')))))
+            {
+                m_state = xmlState::text;
+            }
+            m_prev[0] = m_prev[1];
+            m_prev[1] = c;
+            break;
+        case xmlState::cdata:
+            // ] is added to text when it is known that it is not a part of ]]>
+            if (c == ']')
+            {
+                ++m_brackets;
+                break;
+            }
+            if ((c == '>') && (m_brackets >= 2))
+            {
+                m_brackets -= 2;
+                m_state = xmlState::text;
+            }
+            for (; m_brackets > 0; --m_brackets)
+            {
+                if (m_depth > 0)
+                {
+                    addChar(']');
+                }
+            }
+            if ((m_state == xmlState::cdata) && (m_depth > 0))
+            {
+                addByte(static_cast<unsigned char>(c));
+            }
+            break;
+        }
+
+        if (m_text.size() >= XFA_OUTPUT_CHARS)
+        {
+            const auto ret{ flush() };
+            if (ret)
+            {
+                return ret;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+* End of start or end tag. Elements are counted inside xfa:datasets element,
+* element name prefix is ignored.
+*/
+void XFADataExtractor::endTag()
+{
+    m_state = xmlState::text;
+    if (m_endTag)
+    {
+        if (m_depth > 0)
+        {
+            --m_depth;
+        }
+    }
+    else if (!m_emptyTag)
+    {
+        if (m_depth > 0)
+        {
+            ++m_depth;
+        }
+        else
+        {
+            const auto colon{ m_name.find(':') };
+            if (!m_name.compare((colon == std::string::npos) ? 0 : colon + 1, std::string::npos, "datasets"))
+            {
+                m_depth = 1;
+            }
+        }
+    }
+}
+
+/**
+* End of text node, text of each element is terminated with EOL, so it doesn't merge with the next one.
+*/
+void XFADataExtractor::endText()
+{
+    if (m_inText)
+    {
+        m_text.push_back('\n');
+        m_inText = false;
+    }
+    m_utf8Bytes = 0;
+}
+
+/**
+* Output collected text.
+*
+* @return   0 - extraction should continue, 1 - extraction should abort
+*/
+int XFADataExtractor::flush()
+{
+    int ret{ 0 };
+    if (requestStatus::active != m_data->getStatus())
+    {
+        ret = 1;
+    }
+    else if (!m_text.empty())
+    {
+        ret = m_data->output(reinterpret_cast<const char*>(m_text.data()), m_text.size(), true);
+    }
+    m_text.clear();
+    return ret;
+}
+
+/**
+* Add character to text. Whitespace at the start of text node is skipped,
+* whitespace-only text nodes between elements are not output.
+*
+* @param[in]    u   Unicode character
+*/
+void XFADataExtractor::addChar(Unicode u)
+{
+    if (!m_inText && ((u == ' ') || (u == '\t') || (u == '\r') || (u == '\n')))
+    {
+        return;
+    }
+    m_inText = true;
+    m_text.push_back(u);
+}
+
+/**
+* Add byte of UTF-8 encoded text. Invalid sequences are skipped.
+*
+* @param[in]    c   byte of UTF-8 text
+*/
+void XFADataExtractor::addByte(unsigned char c)
+{
+    if (c < 0x80U)
+    {
+        m_utf8Bytes = 0;
+        addChar(c);
+    }
+    else if ((c & 0xC0U) == 0x80U)
+    {
+        if (m_utf8Bytes > 0)
+        {
+            m_utf8 = (m_utf8 << 6U) | (c & 0x3FU);
+            if (--m_utf8Bytes == 0)
+            {
+                addChar(m_utf8);
+            }
+        }
+    }
+    else if ((c & 0xE0U) == 0xC0U)
+    {
+        m_utf8 = c & 0x1FU;
+        m_utf8Bytes = 1;
+    }
+    else if ((c & 0xF0U) == 0xE0U)
+    {
+        m_utf8 = c & 0x0FU;
+        m_utf8Bytes = 2;
+    }
+    else if ((c & 0xF8U) == 0xF0U)
+    {
+        m_utf8 = c & 0x07U;
+        m_utf8Bytes = 3;
+    }
+    else
+    {
+        m_utf8Bytes = 0;
+    }
+}
+
+/**
+* Decode predefined entity or character reference in #m_entity and add it to text.
+* Unknown entities are added as they are.
+*/
+void XFADataExtractor::addEntity()
+{
+    Unicode u{ 0 };
+    if (m_entity == "lt")
+    {
+        u = '<';
+    }
+    else if (m_entity == "gt")
+    {
+        u = '>';
+    }
+    else if (m_entity == "amp")
+    {
+        u = '&';
+    }
+    else if (m_entity == "quot")
+    {
+        u = '"';
+    }
+    else if (m_entity == "apos")
+    {
+        u = '\'';
+    }
+    else if ((m_entity.size() > 1) && (m_entity[0] == '#'))
+    {
+        const auto hex{ (m_entity[1] == 'x') || (m_entity[1] == 'X') };
+        const auto first{ m_entity.data() + (hex ? 2 : 1) };
+        const auto last{ m_entity.data() + m_entity.size() };
+        const auto res{ std::from_chars(first, last, u, hex ? 16 : 10) };
+        if ((res.ec != std::errc()) || (res.ptr != last))
+        {
+            u = 0;
+        }
+    }
+
+    if (u)
+    {
+        addChar(u);
+    }
+    else
+    {
+        addChar('&');
+        for (const auto e : m_entity)
+        {
+            addByte(static_cast<unsigned char>(e));
+        }
+        addChar(';');
+    }
+}
@@ -0,0 +1,74 @@
+/**
+* @file
+*
+* XFADataExtractor class declaration.
+*/
+
+#pragma once
+
+#include "ThreadData.hh"
+#include <string>
+#include <vector>
+
+constexpr size_t XFA_READ_BLOCK_SIZE{ 64U * 1024U };     /**< size of one read of XFA stream, in bytes */
+constexpr size_t XFA_OUTPUT_CHARS{ 4096U };             /**< number of characters collected before they are output */
+constexpr size_t XFA_NAME_MAX{ 64U };                   /**< max length of element name kept by tokenizer */
+constexpr size_t XFA_ENTITY_MAX{ 12U };                 /**< max length of character reference */
+
+/**
+* Extraction of text of XFA form data.
+* Values entered to XFA forms are stored in datasets packet of /AcroForm /XFA,
+* which is not drawn on pages. XFAScanner builds DOM of the whole XFA (template, datasets, ...),
+* this class streams the datasets packet through a simple XML tokenizer instead,
+* and outputs text of elements inside xfa:datasets. Attributes, comments and
+* processing instructions are skipped, character references are decoded.
+*/
+class XFADataExtractor
+{
+public:
+    explicit XFADataExtractor(ThreadData* data) : m_data{ data } { };
+    XFADataExtractor(const XFADataExtractor&) = delete;
+    XFADataExtractor& operator=(const XFADataExtractor&) = delete;
+
+    int output(PDFDoc* doc);
+
+private:
+    /**
+    * State of tokenizer between bytes
+    */
+    enum class xmlState
+    {
+        text,       /**< character data */
+        entity,     /**< character reference after & */
+        tagStart,   /**< after < */
+        tagName,    /**< element name */
+        tag,        /**< rest of start or end tag, attributes */
+        attrValue,  /**< quoted attribute value */
+        markup,     /**< comment, CDATA section, DOCTYPE or processing instruction */
+        cdata       /**< content of CDATA section */
+    };
+
+    int outputStream(Stream* str);
+    int parse(const char* buf, size_t len);
+    void endTag();
+    void endText();
+    int flush();
+    void addChar(Unicode u);
+    void addByte(unsigned char c);
+    void addEntity();
+
+    ThreadData*             m_data{ nullptr };              /**< request data */
+    xmlState                m_state{ xmlState::text };      /**< tokenizer state */
+    std::vector<Unicode>    m_text;                         /**< collected text, text of each element ends with EOL */
+    bool                    m_inText{ false };              /**< current text node has non-whitespace text */
+    std::string             m_name;                         /**< name of current tag, or start of markup */
+    std::string             m_entity;                       /**< current character reference */
+    char                    m_quote{ '\0' };                /**< quote of current attribute value */
+    char                    m_prev[2]{ };                   /**< last two characters of markup */
+    int                     m_brackets{ 0 };                /**< number of ] in CDATA section not added to text yet */
+    bool                    m_endTag{ false };              /**< current tag is end tag */
+    bool                    m_emptyTag{ false };            /**< current tag is empty element tag */
+    int                     m_depth{ 0 };                   /**< depth of elements inside xfa:datasets, 0 = outside */
+    Unicode                 m_utf8{ 0 };                    /**< code point of partial UTF-8 sequence */
+    int                     m_utf8Bytes{ 0 };               /**< number of continuation bytes missing in UTF-8 sequence */
+};
@@ -84,9 +84,13 @@
 #undef HAVE_MKSTEMPS
 #undef HAVE_POPEN
 #undef HAVE_STD_SORT
-#undef HAVE_FSEEKO
 #undef HAVE_FSEEK64
+#ifdef _WIN32
+#undef HAVE_FSEEKO
 #define HAVE_FSEEKI64           1   /**< use _fseeki64, _ftelli64 functions */
+#else
+#define HAVE_FSEEKO             1   /**< use fseeko, ftello functions in native (Linux) test build */
+#endif
 #define _FILE_OFFSET_BITS       64  /**< not used */
 #define _LARGE_FILES            1   /**< not used */
 #define _LARGEFILE_SOURCE       1   /**< not used */
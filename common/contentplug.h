@@ -4,7 +4,9 @@
 */
 
 #pragma once
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 
 /**
 * @defgroup ft_types ContentGetSupportedField return values
@@ -96,6 +98,7 @@
 #define CONTENT_PASSTHROUGH         2
 /** @} */
 
+#ifdef _WIN32
 /**
 * Used in ContentSetDefaultParams to inform the plugin about the current plugin interface version and ini file location.
 */
@@ -169,3 +172,4 @@ extern "C" {
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
+#endif /* _WIN32 */
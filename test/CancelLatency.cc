@@ -0,0 +1,260 @@
+/**
+* @file
+*
+* Cancel-to-idle latency test.
+* Worker thread extracts text of a page with a large content stream, the way TcOutputDev does:
+* Gfx calls abort check which tests status of the request. Consumer cancels the request at
+* different times with ThreadData::stop, like TC does when search finds a hit, and measures
+* how long it takes until the worker is idle again. The test fails if cancel takes longer than
+* #CANCEL_LATENCY or if the page has been completed before it was cancelled.
+*
+* Usage: CancelLatency [number of content stream lines]
+*/
+
+#include "ThreadData.hh"
+#include "FieldIndexes.hh"
+#include "contentplug.h"
+#include <Gfx.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+constexpr auto PDF_FILE_NAME{ "./CancelLatency.pdf" };   /**< generated test document */
+constexpr uint32_t CANCEL_DELAYS[]{ 0U, 10U, 50U, 200U };   /**< time from request start to cancel in miliseconds */
+
+using Clock = std::chrono::steady_clock;
+
+/**
+* Write one page PDF document. The page content stream draws many paths
+* with occasional text, so most of the time is spent in the Gfx operator loop.
+*
+* @param[in]    fileName    name of PDF document
+* @param[in]    lines       number of content stream lines
+* @return number of operators in the content stream, 0 on error
+*/
+static long long writePdf(const char* fileName, int lines)
+{
+    std::string content;
+    long long ops{ 0 };
+    for (int i = 0; i < lines; i++)
+    {
+        if (i % 100)
+        {
+            content += "q 0.5 w 10 10 m 200 " + std::to_string(i % 700) + " l S Q\n";
+            ops += 6;
+        }
+        else
+        {
+            content += "BT /F1 10 Tf 72 " + std::to_string(i % 700) + " Td (line " + std::to_string(i) + ") Tj ET\n";
+            ops += 5;
+        }
+    }
+
+    auto f{ fopen(fileName, "wb") };
+    if (!f)
+        return 0;
+
+    long offsets[5]{};
+    fprintf(f, "%%PDF-1.4\n");
+    offsets[1] = ftell(f);
+    fprintf(f, "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+    offsets[2] = ftell(f);
+    fprintf(f, "2 0 obj\n<< /Type /Pages /Kids [3 0 R] /Count 1 >>\nendobj\n");
+    offsets[3] = ftell(f);
+    fprintf(f, "3 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] /Contents 4 0 R"
+        " /Resources << /Font << /F1 << /Type /Font /Subtype /Type1 /BaseFont /Helvetica >> >> >> >>\nendobj\n");
+    offsets[4] = ftell(f);
+    fprintf(f, "4 0 obj\n<< /Length %zu >>\nstream\n", content.size());
+    fwrite(content.data(), 1, content.size(), f);
+    fprintf(f, "\nendstream\nendobj\n");
+    const auto xref{ ftell(f) };
+    fprintf(f, "xref\n0 5\n0000000000 65535 f \n");
+    for (int i = 1; i < 5; i++)
+    {
+        fprintf(f, "%010ld 00000 n \n", offsets[i]);
+    }
+    fprintf(f, "trailer\n<< /Size 5 /Root 1 0 R >>\nstartxref\n%ld\n%%%%EOF\n", xref);
+    fclose(f);
+    return ops;
+}
+
+/**
+* Text extractor, worker side of PDFExtractor and TcOutputDev reduced to one page.
+*/
+class PageExtractor
+{
+public:
+    explicit PageExtractor(PDFDoc* doc) : m_doc{ doc } { };
+    ~PageExtractor() { m_data.abort(); };
+
+    bool start();
+    long long cancelAfter(uint32_t delay);
+    long long getLastOps() const { return m_lastOps; }
+
+private:
+    ThreadData                      m_data;                 /**< tested thread data */
+    PDFDoc*                         m_doc;                  /**< test document */
+    std::unique_ptr<TextOutputDev>  m_dev;                  /**< text output device */
+    long long                       m_lastOps{ 0 };         /**< operators executed by the last request */
+
+    static void threadFunc(void* param);
+    static int outputFunction(void* stream, const char* text, int len);
+    static GBool abortExtraction(void* data);
+    void waitForProducer();
+};
+
+/**
+* Copy extracted text to request buffer, same as TcOutputDev outputFunction.
+*/
+int PageExtractor::outputFunction(void* stream, const char* text, int len)
+{
+    auto data{ static_cast<ThreadData*>(stream) };
+    if (data && (requestStatus::active == data->getStatus()) && text && (len > 0))
+    {
+        return data->output(text, len, false);
+    }
+    return 0;
+}
+
+/**
+* Abort check called by Gfx, request status part of ResourceGovernor::shouldAbort.
+*/
+GBool PageExtractor::abortExtraction(void* data)
+{
+    return (requestStatus::active != static_cast<ThreadData*>(data)->getStatus()) ? gTrue : gFalse;
+}
+
+/**
+* Worker thread entry function.
+*
+* @param[in]    param   pointer to PageExtractor object (this)
+*/
+void PageExtractor::threadFunc(void* param)
+{
+    static_cast<PageExtractor*>(param)->waitForProducer();
+}
+
+/**
+* Producer loop, same state handling as PDFExtractor::waitForProducer.
+*/
+void PageExtractor::waitForProducer()
+{
+    m_data.setActive(true);
+    auto timeout{ PRODUCER_TIMEOUT };
+
+    while (m_data.isActive())
+    {
+        const auto ret{ m_data.waitForProducer(timeout) };
+        if (ret == waitResult::signaled)
+        {
+            if (m_data.getStatus() == requestStatus::active)
+            {
+                const auto ops{ Gfx::getOpCount() };
+                m_doc->displayPage(m_dev.get(), 1, 72.0, 72.0, 0, gFalse, gTrue, gFalse, abortExtraction, &m_data);
+                m_lastOps = static_cast<long long>(Gfx::getOpCount() - ops);
+            }
+            m_data.setStatusCond(requestStatus::complete, requestStatus::active);
+            m_data.setStatusCond(requestStatus::closed, requestStatus::cancelled);
+            m_data.resetProducer();
+            m_data.notifyConsumer();
+            timeout = PRODUCER_TIMEOUT;
+        }
+        else if (ret == waitResult::timeout)
+        {
+            timeout = INFINITE_TIMEOUT;
+        }
+        else
+        {
+            m_data.setActive(false);
+        }
+    }
+}
+
+/**
+* Create text output device.
+*
+* @return true if device is valid
+*/
+bool PageExtractor::start()
+{
+    TextOutputControl toc;
+    toc.mode = textOutReadingOrder;
+    m_dev = std::make_unique<TextOutputDev>(&outputFunction, &m_data, &toc);
+    return m_dev->isOk();
+}
+
+/**
+* Start text extraction, cancel it after delay and measure cancel-to-idle latency.
+*
+* @param[in]    delay   time from start to cancel in miliseconds
+* @return cancel latency in microseconds, -1 if extraction could not be started
+*/
+long long PageExtractor::cancelAfter(uint32_t delay)
+{
+    m_data.initRequest(L"CancelLatency.pdf", fiText, 0, 0, PRODUCER_TIMEOUT);
+    m_data.setStatusCond(requestStatus::active, requestStatus::complete);
+    m_data.setStatusCond(requestStatus::active, requestStatus::closed);
+    if (!m_data.start(threadFunc, this))
+    {
+        return -1;
+    }
+    // TC waits for first block, the page is still being parsed
+    if (m_data.notifyProducerWaitForConsumer(delay) == waitResult::failed)
+    {
+        return -1;
+    }
+
+    const auto start{ Clock::now() };
+    m_data.stop();
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    const auto lines{ (argc > 1) ? atoi(argv[1]) : 2000000 };
+    const auto ops{ writePdf(PDF_FILE_NAME, lines) };
+    if (!ops)
+    {
+        fprintf(stderr, "cannot write %s\n", PDF_FILE_NAME);
+        return EXIT_FAILURE;
+    }
+
+    globalParams = new GlobalParams(nullptr);
+    globalParams->setTextEncoding("UCS-2");
+    globalParams->setTextPageBreaks(gFalse);
+    globalParams->setErrQuiet(gTrue);
+
+    auto failed{ false };
+    {
+        PDFDoc doc(new GString(PDF_FILE_NAME));
+        PageExtractor extractor(&doc);
+        if (!doc.isOk() || !extractor.start())
+        {
+            fprintf(stderr, "cannot open %s\n", PDF_FILE_NAME);
+            failed = true;
+        }
+        for (const auto delay : CANCEL_DELAYS)
+        {
+            if (failed)
+                break;
+
+            const auto latency{ extractor.cancelAfter(delay) };
+            const auto executed{ extractor.getLastOps() };
+            printf("cancel after %3u ms: latency=%lld us, executed %lld of %lld operators\n", delay, latency, executed, ops);
+            if ((latency < 0) || (latency > CANCEL_LATENCY * 1000LL))
+            {
+                failed = true;
+            }
+            else if (executed >= ops)
+            {
+                fprintf(stderr, "page completed before cancel, increase number of lines\n");
+                failed = true;
+            }
+        }
+    }
+
+    delete globalParams;
+    remove(PDF_FILE_NAME);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,854 @@
+/**
+* @file
+*
+* Throughput benchmark of xpdf filter streams.
+* Test data is encoded by simple encoders below, then decoded by the filter streams.
+* Before throughput is measured, decoded data read with getChar, getBlock with different
+* block sizes and mixed lookChar/getChar/getBlock calls is compared with the original data.
+* Content stream lexer, which reads its stream in blocks, is compared with the lexer which
+* reads the same stream by characters.
+* LZW decoder is also compared with the decoder of xpdf 4.05 (#BaselineLZWStream) on random
+* inputs, and throughput of both decoders is reported.
+* Throughput is reported in MB of decoded data per second, best of #RUNS runs.
+*
+* Usage: StreamBench [MB of decoded data per filter]
+*/
+
+#include <aconf.h>
+#include <GlobalParams.h>
+#include <Object.h>
+#include <Stream.h>
+#include <Decrypt.h>
+#include <Lexer.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+constexpr int RUNS{ 5 };                /**< number of measured runs, the best one is reported */
+constexpr int READ_BLOCK_SIZE{ 65536 }; /**< getBlock size used for throughput */
+constexpr int CHECK_BLOCK_SIZES[]{ 1, 3, 100, 4096, 65536 };   /**< getBlock sizes used in equality checks */
+
+using Clock = std::chrono::steady_clock;
+
+/**
+* Deterministic pseudo random numbers, the same data on every run.
+*/
+class Random
+{
+public:
+    explicit Random(uint32_t seed) : m_state{ seed } { };
+    uint32_t next() { m_state = m_state * 1103515245U + 12345U; return m_state >> 8; }
+    int below(int n) { return static_cast<int>(next() % static_cast<uint32_t>(n)); }
+
+private:
+    uint32_t m_state;   /**< generator state */
+};
+
+/**
+* Text-like data, similar to uncompressed page content stream.
+*
+* @param[in]    size    minimal size of data in bytes
+* @return generated data
+*/
+static std::string makeText(size_t size)
+{
+    static const char* const words[]{ "Lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit" };
+    Random rnd(1);
+    std::string data;
+    char line[160];
+    while (data.size() < size)
+    {
+        snprintf(line, sizeof(line), "BT /F%d 12 Tf %d.%d %d Td (%s %s %s) Tj ET\n%d %d m %d %d l S\n",
+            rnd.below(4), rnd.below(600), rnd.below(10), rnd.below(800),
+            words[rnd.below(8)], words[rnd.below(8)], words[rnd.below(8)],
+            rnd.below(600), rnd.below(800), rnd.below(600), rnd.below(800));
+        data += line;
+    }
+    return data;
+}
+
+/**
+* Image-like data, gradients with runs and noise.
+*
+* @param[in]    size    size of data in bytes
+* @return generated data
+*/
+static std::string makeImage(size_t size)
+{
+    Random rnd(2);
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; )
+    {
+        const auto run{ static_cast<size_t>(1 + rnd.below(64)) };
+        const auto value{ static_cast<char>((i / 97) & 0xff) };
+        for (size_t j = 0; (j < run) && (i < size); j++, i++)
+        {
+            data[i] = (rnd.below(4) == 0) ? static_cast<char>(rnd.below(256)) : value;
+        }
+    }
+    return data;
+}
+
+/**
+* ASCIIHexDecode encoder, 64 digits per line.
+*/
+static std::string encodeHex(const std::string& data)
+{
+    static const char digits[]{ "0123456789ABCDEF" };
+    std::string out;
+    out.reserve(data.size() * 2 + data.size() / 32 + 1);
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        const auto c{ static_cast<unsigned char>(data[i]) };
+        out += digits[c >> 4];
+        out += digits[c & 0x0f];
+        if ((i % 32) == 31)
+            out += '\n';
+    }
+    out += '>';
+    return out;
+}
+
+/**
+* ASCII85Decode encoder, 'z' for zero groups, 75 characters per line.
+*/
+static std::string encodeA85(const std::string& data)
+{
+    std::string out;
+    out.reserve(data.size() * 5 / 4 + data.size() / 60 + 8);
+    size_t column{ 0 };
+    for (size_t i = 0; i < data.size(); i += 4)
+    {
+        const auto n{ std::min<size_t>(4, data.size() - i) };
+        uint32_t group{ 0 };
+        for (size_t j = 0; j < 4; j++)
+        {
+            group = (group << 8) | ((j < n) ? static_cast<unsigned char>(data[i + j]) : 0U);
+        }
+        if ((group == 0) && (n == 4))
+        {
+            out += 'z';
+            column++;
+        }
+        else
+        {
+            char enc[5];
+            for (int j = 4; j >= 0; j--)
+            {
+                enc[j] = static_cast<char>('!' + group % 85);
+                group /= 85;
+            }
+            out.append(enc, n + 1);
+            column += n + 1;
+        }
+        if (column >= 75)
+        {
+            out += '\n';
+            column = 0;
+        }
+    }
+    out += "~>";
+    return out;
+}
+
+/**
+* RunLengthDecode encoder.
+*/
+static std::string encodeRunLength(const std::string& data)
+{
+    std::string out;
+    size_t i{ 0 };
+    while (i < data.size())
+    {
+        size_t run{ 1 };
+        while ((i + run < data.size()) && (run < 128) && (data[i + run] == data[i]))
+            run++;
+        if (run > 1)
+        {
+            out += static_cast<char>(257 - run);
+            out += data[i];
+            i += run;
+        }
+        else
+        {
+            size_t lit{ 1 };
+            while ((i + lit < data.size()) && (lit < 128)
+                && !((i + lit + 1 < data.size()) && (data[i + lit] == data[i + lit + 1])))
+                lit++;
+            out += static_cast<char>(lit - 1);
+            out.append(data, i, lit);
+            i += lit;
+        }
+    }
+    out += static_cast<char>(128);
+    return out;
+}
+
+/**
+* LZWDecode encoder.
+*
+* @param[in]    data        data to encode
+* @param[in]    early       EarlyChange parameter
+* @param[in]    clearAt     table size at which clear-table code is written
+* @return encoded data
+*/
+static std::string encodeLZW(const std::string& data, int early, int clearAt = 4094)
+{
+    std::string out;
+    uint32_t bitBuf{ 0 };
+    int bitCount{ 0 };
+    int bits{ 9 };
+    auto put{ [&](int code)
+    {
+        bitBuf = (bitBuf << bits) | static_cast<uint32_t>(code);
+        bitCount += bits;
+        while (bitCount >= 8)
+        {
+            out += static_cast<char>((bitBuf >> (bitCount - 8)) & 0xff);
+            bitCount -= 8;
+        }
+    } };
+
+    // child[code * 256 + byte] = code of sequence <code> followed by <byte>
+    std::vector<int> child(4096 * 256, -1);
+    int nextCode{ 258 };
+    auto clear{ [&]()
+    {
+        put(256);
+        for (int code = 0; code < nextCode; code++)
+            std::fill_n(child.begin() + code * 256, 256, -1);
+        nextCode = 258;
+        bits = 9;
+    } };
+
+    auto setBits{ [&]()
+    {
+        if (nextCode + early > 2048)
+            bits = 12;
+        else if (nextCode + early > 1024)
+            bits = 11;
+        else if (nextCode + early > 512)
+            bits = 10;
+    } };
+
+    put(256);
+    int prefix{ -1 };
+    for (const auto ch : data)
+    {
+        const auto c{ static_cast<unsigned char>(ch) };
+        if (prefix < 0)
+        {
+            prefix = c;
+            continue;
+        }
+        const auto next{ child[prefix * 256 + c] };
+        if (next >= 0)
+        {
+            prefix = next;
+            continue;
+        }
+        put(prefix);
+        child[prefix * 256 + c] = nextCode++;
+        setBits();
+        if (nextCode >= clearAt)
+            clear();
+        prefix = c;
+    }
+    if (prefix >= 0)
+    {
+        put(prefix);
+        // decoder adds an entry for the last code too, EOD may need a longer code
+        nextCode++;
+        setBits();
+    }
+    put(257);
+    if (bitCount > 0)
+        out += static_cast<char>((bitBuf << (8 - bitCount)) & 0xff);
+    return out;
+}
+
+/**
+* LZW decoder of xpdf 4.05, before table-driven bulk decoding.
+* Predictors and decompression bomb checks are left out, they are not used in the benchmark.
+*/
+class BaselineLZWStream : public FilterStream
+{
+public:
+    BaselineLZWStream(Stream* strA, int earlyA) : FilterStream(strA), early{ earlyA } { };
+    virtual ~BaselineLZWStream() { delete str; }
+    virtual Stream* copy() { return new BaselineLZWStream(str->copy(), early); }
+    virtual StreamKind getKind() { return strLZW; }
+    virtual void reset();
+    virtual int getChar();
+    virtual int lookChar();
+    virtual int getBlock(char* blk, int size);
+    virtual GString* getPSFilter(int psLevel, const char* indent, GBool okToReadStream) { return nullptr; }
+    virtual GBool isBinary(GBool last = gTrue) { return str->isBinary(gTrue); }
+
+private:
+    int early;                  /**< EarlyChange parameter */
+    GBool eof{ gFalse };        /**< true if at eof */
+    int inputBuf{ 0 };          /**< input buffer */
+    int inputBits{ 0 };         /**< number of bits in input buffer */
+    struct
+    {
+        int length{ 0 };
+        int head{ 0 };
+        Guchar tail{ 0 };
+    } table[4097]{};            /**< decoding table */
+    int nextCode{ 258 };        /**< next code to be used */
+    int nextBits{ 9 };          /**< number of bits in next code word */
+    int prevCode{ 0 };          /**< previous code used in stream */
+    int newChar{ 0 };           /**< next char to be added to table */
+    Guchar seqBuf[4097]{};      /**< buffer for current sequence */
+    int seqLength{ 0 };         /**< length of current sequence */
+    int seqIndex{ 0 };          /**< index into current sequence */
+    GBool first{ gTrue };       /**< first code after a table clear */
+
+    GBool processNextCode();
+    void clearTable();
+    int getCode();
+};
+
+int BaselineLZWStream::getChar()
+{
+    if (eof)
+        return EOF;
+    if ((seqIndex >= seqLength) && !processNextCode())
+        return EOF;
+    return seqBuf[seqIndex++];
+}
+
+int BaselineLZWStream::lookChar()
+{
+    if (eof)
+        return EOF;
+    if ((seqIndex >= seqLength) && !processNextCode())
+        return EOF;
+    return seqBuf[seqIndex];
+}
+
+int BaselineLZWStream::getBlock(char* blk, int size)
+{
+    if (eof)
+        return 0;
+    int n{ 0 };
+    while (n < size)
+    {
+        if ((seqIndex >= seqLength) && !processNextCode())
+            break;
+        const auto m{ std::min(seqLength - seqIndex, size - n) };
+        memcpy(blk + n, seqBuf + seqIndex, m);
+        seqIndex += m;
+        n += m;
+    }
+    return n;
+}
+
+void BaselineLZWStream::reset()
+{
+    str->reset();
+    eof = gFalse;
+    inputBits = 0;
+    clearTable();
+}
+
+GBool BaselineLZWStream::processNextCode()
+{
+    if (eof)
+        return gFalse;
+
+    int code;
+    for (;;)
+    {
+        code = getCode();
+        if ((code == EOF) || (code == 257))
+        {
+            eof = gTrue;
+            return gFalse;
+        }
+        if (code != 256)
+            break;
+        clearTable();
+    }
+    if (nextCode >= 4097)
+        clearTable();
+
+    const auto nextLength{ seqLength + 1 };
+    if (code < 256)
+    {
+        seqBuf[0] = static_cast<Guchar>(code);
+        seqLength = 1;
+    }
+    else if (code < nextCode)
+    {
+        seqLength = table[code].length;
+        int i, j;
+        for (i = seqLength - 1, j = code; i > 0; --i)
+        {
+            seqBuf[i] = table[j].tail;
+            j = table[j].head;
+        }
+        seqBuf[0] = static_cast<Guchar>(j);
+    }
+    else if (code == nextCode)
+    {
+        seqBuf[seqLength] = static_cast<Guchar>(newChar);
+        ++seqLength;
+    }
+    else
+    {
+        eof = gTrue;
+        return gFalse;
+    }
+    newChar = seqBuf[0];
+    if (first)
+    {
+        first = gFalse;
+    }
+    else if (nextCode < 4097)
+    {
+        table[nextCode].length = nextLength;
+        table[nextCode].head = prevCode;
+        table[nextCode].tail = static_cast<Guchar>(newChar);
+        ++nextCode;
+        if (nextCode + early == 512)
+            nextBits = 10;
+        else if (nextCode + early == 1024)
+            nextBits = 11;
+        else if (nextCode + early == 2048)
+            nextBits = 12;
+    }
+    prevCode = code;
+    seqIndex = 0;
+    return gTrue;
+}
+
+void BaselineLZWStream::clearTable()
+{
+    nextCode = 258;
+    nextBits = 9;
+    seqIndex = seqLength = 0;
+    first = gTrue;
+}
+
+int BaselineLZWStream::getCode()
+{
+    while (inputBits < nextBits)
+    {
+        const auto c{ str->getChar() };
+        if (c == EOF)
+            return EOF;
+        inputBuf = (inputBuf << 8) | (c & 0xff);
+        inputBits += 8;
+    }
+    const auto code{ (inputBuf >> (inputBits - nextBits)) & ((1 << nextBits) - 1) };
+    inputBits -= nextBits;
+    return code;
+}
+
+/**
+* Object key of DecryptStream, see DecryptStream::DecryptStream.
+*/
+static void makeObjKey(const Guchar* fileKey, int keyLength, GBool aes, int objNum, int objGen, Guchar* objKey)
+{
+    Guchar key[32];
+    memcpy(key, fileKey, keyLength);
+    key[keyLength] = static_cast<Guchar>(objNum & 0xff);
+    key[keyLength + 1] = static_cast<Guchar>((objNum >> 8) & 0xff);
+    key[keyLength + 2] = static_cast<Guchar>((objNum >> 16) & 0xff);
+    key[keyLength + 3] = static_cast<Guchar>(objGen & 0xff);
+    key[keyLength + 4] = static_cast<Guchar>((objGen >> 8) & 0xff);
+    auto n{ keyLength + 5 };
+    if (aes)
+    {
+        memcpy(key + n, "sAlT", 4);
+        n += 4;
+    }
+    md5(key, n, objKey);
+}
+
+/**
+* AES-128 CBC encoder with IV and padding, as expected by DecryptStream.
+*/
+static std::string encryptAES(const std::string& data, const Guchar* fileKey, int keyLength, int objNum, int objGen)
+{
+    Guchar objKey[16];
+    makeObjKey(fileKey, keyLength, gTrue, objNum, objGen, objKey);
+
+    DecryptAESState state;
+    aesKeyExpansion(&state, objKey, 16, gFalse);
+    std::string out;
+    out.reserve(data.size() + 32);
+    for (int i = 0; i < 16; i++)
+    {
+        state.cbc[i] = static_cast<Guchar>(i * 17);
+        out += static_cast<char>(state.cbc[i]);
+    }
+    const auto pad{ 16 - data.size() % 16 };
+    std::string padded{ data + std::string(pad, static_cast<char>(pad)) };
+    for (size_t i = 0; i < padded.size(); i += 16)
+    {
+        aesEncryptBlock(&state, reinterpret_cast<Guchar*>(&padded[i]));
+        out.append(reinterpret_cast<const char*>(state.buf), 16);
+    }
+    return out;
+}
+
+/**
+* Filter test case.
+*/
+struct FilterCase
+{
+    const char* name;                               /**< name of filter and data */
+    std::string plain;                              /**< decoded data */
+    std::string encoded;                            /**< encoded data */
+    std::function<Stream*(Stream*)> makeDecoder;    /**< create decoder reading from given stream */
+};
+
+/**
+* Create decoder reading encoded data of the test case.
+*/
+static Stream* openCase(const FilterCase& fc)
+{
+    Object dict;
+    dict.initNull();
+    auto str{ fc.makeDecoder(new MemStream(const_cast<char*>(fc.encoded.data()), 0, static_cast<Guint>(fc.encoded.size()), &dict)) };
+    str->reset();
+    return str;
+}
+
+/**
+* Read whole stream with getChar.
+*/
+static std::string readByChar(Stream* str)
+{
+    std::string out;
+    int c;
+    while ((c = str->getChar()) != EOF)
+    {
+        out += static_cast<char>(c);
+    }
+    return out;
+}
+
+/**
+* Read whole stream with getBlock.
+*/
+static std::string readByBlock(Stream* str, int size)
+{
+    std::string out;
+    std::vector<char> blk(size);
+    int n;
+    while ((n = str->getBlock(blk.data(), size)) > 0)
+    {
+        out.append(blk.data(), n);
+    }
+    return out;
+}
+
+/**
+* Read whole stream with mixed lookChar, getChar and getBlock calls of random size.
+*/
+static std::string readMixed(Stream* str)
+{
+    Random rnd(3);
+    std::string out;
+    char blk[300];
+    for (;;)
+    {
+        const auto op{ rnd.below(3) };
+        if (op == 0)
+        {
+            const auto c{ str->lookChar() };
+            if (c != str->getChar())
+                return out + "<lookChar mismatch>";
+            if (c == EOF)
+                break;
+            out += static_cast<char>(c);
+        }
+        else if (op == 1)
+        {
+            const auto c{ str->getChar() };
+            if (c == EOF)
+                break;
+            out += static_cast<char>(c);
+        }
+        else
+        {
+            const auto n{ str->getBlock(blk, 1 + rnd.below(sizeof(blk))) };
+            if (n <= 0)
+                break;
+            out.append(blk, n);
+        }
+    }
+    return out;
+}
+
+/**
+* Compare data read in all ways with decoded data.
+*
+* @return true if all reads match
+*/
+static bool checkCase(const FilterCase& fc)
+{
+    std::vector<std::pair<std::string, std::function<std::string(Stream*)>>> reads{
+        { "getChar", readByChar },
+        { "mixed", readMixed },
+    };
+    for (const auto size : CHECK_BLOCK_SIZES)
+    {
+        reads.emplace_back("getBlock(" + std::to_string(size) + ")", [size](Stream* str) { return readByBlock(str, size); });
+    }
+
+    auto ok{ true };
+    for (const auto& read : reads)
+    {
+        auto str{ openCase(fc) };
+        if (read.second(str) != fc.plain)
+        {
+            printf("%-24s %s differs\n", fc.name, read.first.c_str());
+            ok = false;
+        }
+        // read again after reset
+        str->reset();
+        if (readByBlock(str, READ_BLOCK_SIZE) != fc.plain)
+        {
+            printf("%-24s %s differs after reset\n", fc.name, read.first.c_str());
+            ok = false;
+        }
+        delete str;
+    }
+    return ok;
+}
+
+/**
+* Measure time of reading whole stream.
+*
+* @param[in]    read    function which reads the stream
+* @return throughput in MB/s, best of #RUNS runs
+*/
+static double measure(const FilterCase& fc, const std::function<size_t(Stream*)>& read)
+{
+    double best{ 0.0 };
+    for (int run = 0; run < RUNS; run++)
+    {
+        auto str{ openCase(fc) };
+        const auto start{ Clock::now() };
+        const auto size{ read(str) };
+        const std::chrono::duration<double> elapsed{ Clock::now() - start };
+        delete str;
+        if (elapsed.count() > 0)
+            best = std::max(best, size / elapsed.count() / 1e6);
+    }
+    return best;
+}
+
+/**
+* Run checks and throughput measurement of filter test case.
+*
+* @return true if checks passed
+*/
+static bool benchCase(const FilterCase& fc)
+{
+    if (!checkCase(fc))
+        return false;
+
+    const auto block{ measure(fc, [](Stream* str)
+    {
+        static char blk[READ_BLOCK_SIZE];
+        size_t size{ 0 };
+        int n;
+        while ((n = str->getBlock(blk, sizeof(blk))) > 0)
+            size += n;
+        return size;
+    }) };
+    const auto chars{ measure(fc, [](Stream* str)
+    {
+        size_t size{ 0 };
+        while (str->getChar() != EOF)
+            size++;
+        return size;
+    }) };
+    printf("%-24s %8.1f MB/s getBlock %8.1f MB/s getChar\n", fc.name, block, chars);
+    return true;
+}
+
+/**
+* Tokens of a lexer, as strings.
+*/
+static std::vector<std::string> readTokens(Lexer& lexer)
+{
+    std::vector<std::string> tokens;
+    Object obj;
+    char buf[64];
+    while (!lexer.getObj(&obj)->isEOF())
+    {
+        if (obj.isInt())
+            snprintf(buf, sizeof(buf), "i%d", obj.getInt());
+        else if (obj.isReal())
+            snprintf(buf, sizeof(buf), "r%g", obj.getReal());
+        else if (obj.isString())
+            snprintf(buf, sizeof(buf), "s%s", obj.getString()->getCString());
+        else if (obj.isName())
+            snprintf(buf, sizeof(buf), "n%s", obj.getName());
+        else if (obj.isCmd())
+            snprintf(buf, sizeof(buf), "c%s", obj.getCmd());
+        else
+            snprintf(buf, sizeof(buf), "t%s", obj.getTypeName());
+        tokens.emplace_back(buf);
+        obj.free();
+    }
+    obj.free();
+    return tokens;
+}
+
+/**
+* Compare tokens of content stream lexer (block reads) and lexer over a stream (character reads),
+* measure content stream lexer throughput.
+*
+* @return true if tokens match
+*/
+static bool benchLexer(const std::string& content)
+{
+    Object dict;
+    auto open{ [&content, &dict]()
+    {
+        dict.initNull();
+        return new MemStream(const_cast<char*>(content.data()), 0, static_cast<Guint>(content.size()), &dict);
+    } };
+
+    std::vector<std::string> byChar;
+    {
+        Lexer lexer(nullptr, open());
+        byChar = readTokens(lexer);
+    }
+
+    double best{ 0.0 };
+    auto ok{ true };
+    for (int run = 0; run < RUNS; run++)
+    {
+        Object obj;
+        obj.initStream(open());
+        const auto start{ Clock::now() };
+        std::vector<std::string> byBlock;
+        {
+            Lexer lexer(nullptr, &obj);
+            byBlock = readTokens(lexer);
+        }
+        const std::chrono::duration<double> elapsed{ Clock::now() - start };
+        obj.free();
+        if (byBlock != byChar)
+        {
+            ok = false;
+            break;
+        }
+        if (elapsed.count() > 0)
+            best = std::max(best, content.size() / elapsed.count() / 1e6);
+    }
+    if (ok)
+        printf("%-24s %8.1f MB/s (%zu tokens)\n", "content lexer", best, byChar.size());
+    else
+        printf("%-24s tokens differ from character lexer\n", "content lexer");
+    return ok;
+}
+
+/**
+* Decode random LZW inputs with the current and the baseline decoder.
+* Inputs use small alphabets, so long sequences and KwKwK codes are frequent.
+*
+* @param[in]    count   number of random inputs
+* @return true if outputs of both decoders match the input
+*/
+static bool compareLZW(int count)
+{
+    Random rnd(4);
+    Object dict;
+    auto failed{ 0 };
+    for (int i = 0; i < count; i++)
+    {
+        std::string data(rnd.below(20000), '\0');
+        const auto alphabet{ 1 + rnd.below((i % 2) ? 4 : 256) };
+        for (auto& c : data)
+            c = static_cast<char>(rnd.below(alphabet));
+        const auto early{ rnd.below(2) };
+        const auto encoded{ encodeLZW(data, early, (i % 3) ? 4094 : 300 + rnd.below(1000)) };
+
+        dict.initNull();
+        LZWStream current(new MemStream(const_cast<char*>(encoded.data()), 0, static_cast<Guint>(encoded.size()), &dict), 1, 0, 0, 0, early);
+        dict.initNull();
+        BaselineLZWStream baseline(new MemStream(const_cast<char*>(encoded.data()), 0, static_cast<Guint>(encoded.size()), &dict), early);
+        current.reset();
+        baseline.reset();
+        const auto blockSize{ 1 + rnd.below(5000) };
+        const auto decoded{ (i % 4) ? readByBlock(&current, blockSize) : readMixed(&current) };
+        if ((decoded != data) || (readByBlock(&baseline, blockSize) != data))
+            failed++;
+    }
+    printf("%-24s %d of %d random inputs differ\n", "LZW baseline compare", failed, count);
+    return failed == 0;
+}
+
+int main(int argc, char* argv[])
+{
+    const auto size{ static_cast<size_t>((argc > 1) ? atoi(argv[1]) : 4) << 20 };
+
+    globalParams = new GlobalParams(nullptr);
+    globalParams->setErrQuiet(gTrue);
+
+    const auto text{ makeText(size) };
+    const auto image{ makeImage(size) };
+    static Guchar fileKey[16]{ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+    constexpr int objNum{ 12 };
+    constexpr int objGen{ 0 };
+
+    std::vector<FilterCase> cases;
+    cases.push_back({ "ASCIIHex text", text, encodeHex(text), [](Stream* str) { return new ASCIIHexStream(str); } });
+    cases.push_back({ "ASCII85 image", image, encodeA85(image), [](Stream* str) { return new ASCII85Stream(str); } });
+    cases.push_back({ "RunLength image", image, encodeRunLength(image), [](Stream* str) { return new RunLengthStream(str); } });
+    cases.push_back({ "RunLength/ASCIIHex", image, encodeHex(encodeRunLength(image)),
+        [](Stream* str) { return new RunLengthStream(new ASCIIHexStream(str)); } });
+    {
+        // RC4 is symmetric, decrypt plain data to get encrypted data
+        FilterCase rc4{ "RC4 text", text, std::string(), [](Stream* str) { return new DecryptStream(str, fileKey, cryptRC4, 16, objNum, objGen); } };
+        rc4.encoded = text;
+        auto str{ openCase(rc4) };
+        rc4.encoded = readByBlock(str, READ_BLOCK_SIZE);
+        delete str;
+        cases.push_back(rc4);
+    }
+    cases.push_back({ "AES text", text, encryptAES(text, fileKey, 16, objNum, objGen),
+        [](Stream* str) { return new DecryptStream(str, fileKey, cryptAES, 16, objNum, objGen); } });
+
+    for (const auto early : { 1, 0 })
+    {
+        auto lzw{ [early](Stream* str) { return new LZWStream(str, 1, 0, 0, 0, early); } };
+        auto baseline{ [early](Stream* str) { return new BaselineLZWStream(str, early); } };
+        const auto lzwText{ encodeLZW(text, early) };
+        const auto lzwImage{ encodeLZW(image, early) };
+        const auto lzwClears{ encodeLZW(text, early, 600) };
+        cases.push_back({ early ? "LZW text" : "LZW text early 0", text, lzwText, lzw });
+        cases.push_back({ early ? "  baseline" : "  baseline early 0", text, lzwText, baseline });
+        cases.push_back({ early ? "LZW image" : "LZW image early 0", image, lzwImage, lzw });
+        cases.push_back({ early ? "  baseline" : "  baseline early 0", image, lzwImage, baseline });
+        cases.push_back({ early ? "LZW text, clears" : "LZW text, clears, early 0", text, lzwClears, lzw });
+        cases.push_back({ early ? "  baseline" : "  baseline early 0", text, lzwClears, baseline });
+    }
+    cases.push_back({ "LZW/ASCII85 text", text, encodeA85(encodeLZW(text, 1)),
+        [](Stream* str) { return new LZWStream(new ASCII85Stream(str), 1, 0, 0, 0, 1); } });
+
+    auto ok{ true };
+    for (const auto& fc : cases)
+    {
+        ok = benchCase(fc) && ok;
+    }
+    ok = benchLexer(text) && ok;
+    ok = compareLZW(2000) && ok;
+
+    delete globalParams;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
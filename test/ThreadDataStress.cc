@@ -0,0 +1,298 @@
+/**
+* @file
+*
+* Stress test of producer/consumer handoff in ThreadData.
+* Many simulated extractors run in parallel, each one drives its ThreadData the way
+* PDFExtractor does: TC thread (consumer) requests text in blocks, worker thread (producer)
+* outputs text of simulated pages. Some requests are stopped in the middle, like TC does when
+* search finds a hit. Handoff and cancel latencies are measured and reported.
+*
+* Usage: ThreadDataStress [extractors] [requests per extractor] [pages per request]
+*/
+
+#include "ThreadData.hh"
+#include "FieldIndexes.hh"
+#include "contentplug.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cwchar>
+
+constexpr int PAGE_LENGTH{ 1500 };      /**< number of characters on simulated page */
+constexpr int STOP_EVERY{ 7 };          /**< every n-th request is stopped after first block */
+
+using Clock = std::chrono::steady_clock;
+
+/**
+* Expected character of simulated text.
+*
+* @param[in]    pos     position of character in extracted text
+* @return character at position pos
+*/
+static Unicode expectedChar(long long pos)
+{
+    return static_cast<Unicode>(L'A' + pos % 26);
+}
+
+/**
+* Simulated PDFExtractor, without PDF document.
+*/
+class SimExtractor
+{
+public:
+    /**
+    * Statistics of one extractor.
+    */
+    struct Stats
+    {
+        std::vector<long long> handoff;     /**< latencies of consumer waits in microseconds */
+        std::vector<long long> cancel;      /**< latencies of stop() calls in microseconds */
+        int completed{ 0 };                 /**< number of requests extracted to the end */
+        int stopped{ 0 };                   /**< number of requests stopped by consumer */
+        int timedOut{ 0 };                  /**< number of requests cancelled by producer timeout */
+        int errors{ 0 };                    /**< number of corrupted or lost text blocks */
+    };
+
+    SimExtractor(int pages) : m_pages{ pages } { };
+    ~SimExtractor() { m_data.abort(); };
+
+    void run(int requests);
+    const Stats& stats() const { return m_stats; }
+
+private:
+    ThreadData  m_data;                 /**< tested thread data */
+    const int   m_pages;                /**< number of pages of simulated document */
+    Stats       m_stats;                /**< collected statistics */
+
+    static void threadFunc(void* param);
+    void waitForProducer();
+    void doWork();
+    waitResult waitForConsumer(uint32_t timeout);
+    long long fetch(long long pos);
+};
+
+/**
+* Worker thread entry function.
+*
+* @param[in]    param   pointer to SimExtractor object (this)
+*/
+void SimExtractor::threadFunc(void* param)
+{
+    static_cast<SimExtractor*>(param)->waitForProducer();
+}
+
+/**
+* Producer loop, same state handling as PDFExtractor::waitForProducer.
+*/
+void SimExtractor::waitForProducer()
+{
+    m_data.setActive(true);
+    auto timeout{ PRODUCER_TIMEOUT };
+
+    while (m_data.isActive())
+    {
+        const auto ret{ m_data.waitForProducer(timeout) };
+        if (ret == waitResult::signaled)
+        {
+            const auto status{ m_data.getStatus() };
+            if ((status != requestStatus::cancelled) && (status != requestStatus::complete))
+            {
+                doWork();
+            }
+            m_data.setStatusCond(requestStatus::complete, requestStatus::active);
+            m_data.setStatusCond(requestStatus::closed, requestStatus::cancelled);
+            m_data.resetProducer();
+            m_data.notifyConsumer();
+            timeout = PRODUCER_TIMEOUT;
+        }
+        else if (ret == waitResult::timeout)
+        {
+            timeout = INFINITE_TIMEOUT;
+        }
+        else
+        {
+            m_data.setActive(false);
+        }
+    }
+}
+
+/**
+* Output text of simulated pages, page by page like TcOutputDev::output.
+*/
+void SimExtractor::doWork()
+{
+    std::vector<Unicode> page(PAGE_LENGTH);
+    for (int pg = 0; (pg < m_pages) && (m_data.getStatus() == requestStatus::active); pg++)
+    {
+        for (int i = 0; i < PAGE_LENGTH; i++)
+        {
+            page[i] = expectedChar(static_cast<long long>(pg) * PAGE_LENGTH + i);
+        }
+        if (m_data.output(reinterpret_cast<const char*>(page.data()), PAGE_LENGTH, true))
+        {
+            break;
+        }
+    }
+}
+
+/**
+* Raise producer event and wait for next text block, measure handoff latency.
+*
+* @param[in]    timeout     time to wait for producer in miliseconds
+* @return result of wait
+*/
+waitResult SimExtractor::waitForConsumer(uint32_t timeout)
+{
+    const auto start{ Clock::now() };
+    const auto ret{ m_data.notifyProducerWaitForConsumer(timeout) };
+    m_stats.handoff.push_back(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+    return ret;
+}
+
+/**
+* Move extracted text out of request buffer and check it, like PDFExtractor::extract.
+*
+* @param[in]    pos     position of the first character of the block in extracted text
+* @return number of fetched characters
+*/
+long long SimExtractor::fetch(long long pos)
+{
+    std::lock_guard lock(m_data.mutex);
+    const auto src{ static_cast<wchar_t*>(m_data.getRequestBuffer()) };
+    const auto len{ static_cast<long long>(static_cast<wchar_t*>(m_data.getRequestPtr()) - src) };
+    for (long long i = 0; i < len; i++)
+    {
+        if (static_cast<Unicode>(src[i]) != expectedChar(pos + i))
+        {
+            m_stats.errors++;
+            break;
+        }
+    }
+    m_data.setRequestPtr(src);
+    *src = 0;
+    return len;
+}
+
+/**
+* Consumer (TC) side, extract whole text of simulated document in blocks.
+*
+* @param[in]    requests    number of requests to run
+*/
+void SimExtractor::run(int requests)
+{
+    const auto total{ static_cast<long long>(m_pages) * PAGE_LENGTH };
+    for (int r = 0; r < requests; r++)
+    {
+        const auto stopEarly{ (r % STOP_EVERY) == STOP_EVERY - 1 };
+        long long pos{ 0 };
+        int unit{ 0 };
+        for (;; unit++)
+        {
+            m_data.initRequest(L"sim.pdf", fiText, unit, 0, PRODUCER_TIMEOUT);
+            if (unit == 0)
+            {
+                m_data.setStatusCond(requestStatus::active, requestStatus::complete);
+                m_data.setStatusCond(requestStatus::active, requestStatus::closed);
+                if (!m_data.start(threadFunc, this))
+                {
+                    m_stats.errors++;
+                    return;
+                }
+            }
+            if (waitForConsumer(CONSUMER_TIMEOUT) != waitResult::signaled)
+            {
+                m_stats.errors++;
+                break;
+            }
+            pos += fetch(pos);
+            if (stopEarly)
+            {
+                const auto start{ Clock::now() };
+                m_data.stop();
+                m_stats.cancel.push_back(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+                m_stats.stopped++;
+                break;
+            }
+            const auto status{ m_data.getStatus() };
+            if (status != requestStatus::active)
+            {
+                // producer has finished, take text it has output after last handoff
+                pos += fetch(pos);
+                if (status == requestStatus::complete)
+                {
+                    m_stats.completed++;
+                    if (pos != total)
+                        m_stats.errors++;
+                }
+                else
+                {
+                    m_stats.timedOut++;
+                }
+                break;
+            }
+        }
+    }
+}
+
+/**
+* Print percentiles of latencies.
+*
+* @param[in]        name    name of measured latency
+* @param[in,out]    values  latencies in microseconds
+*/
+static void printLatency(const char* name, std::vector<long long>& values)
+{
+    if (values.empty())
+        return;
+
+    std::sort(values.begin(), values.end());
+    const auto at{ [&values](double p) { return values[static_cast<size_t>(p * (values.size() - 1))]; } };
+    printf("%-8s n=%zu p50=%lld us p99=%lld us max=%lld us\n", name, values.size(), at(0.5), at(0.99), values.back());
+}
+
+int main(int argc, char* argv[])
+{
+    const auto extractors{ (argc > 1) ? atoi(argv[1]) : 64 };
+    const auto requests{ (argc > 2) ? atoi(argv[2]) : 50 };
+    const auto pages{ (argc > 3) ? atoi(argv[3]) : 8 };
+
+    std::vector<std::unique_ptr<SimExtractor>> sims;
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < extractors; i++)
+    {
+        sims.push_back(std::make_unique<SimExtractor>(pages));
+    }
+    const auto start{ Clock::now() };
+    for (auto& sim : sims)
+    {
+        consumers.emplace_back([&sim, requests] { sim->run(requests); });
+    }
+    for (auto& consumer : consumers)
+    {
+        consumer.join();
+    }
+    const auto elapsed{ std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count() };
+
+    SimExtractor::Stats all;
+    for (const auto& sim : sims)
+    {
+        const auto& stats{ sim->stats() };
+        all.handoff.insert(all.handoff.end(), stats.handoff.begin(), stats.handoff.end());
+        all.cancel.insert(all.cancel.end(), stats.cancel.begin(), stats.cancel.end());
+        all.completed += stats.completed;
+        all.stopped += stats.stopped;
+        all.timedOut += stats.timedOut;
+        all.errors += stats.errors;
+    }
+    sims.clear();
+
+    printf("%d extractors x %d requests in %lld ms: completed=%d stopped=%d timed out=%d errors=%d\n",
+        extractors, requests, static_cast<long long>(elapsed), all.completed, all.stopped, all.timedOut, all.errors);
+    printLatency("handoff", all.handoff);
+    printLatency("cancel", all.cancel);
+
+    // cancel must not wait for consumer timeout
+    const auto slowCancel{ !all.cancel.empty() && (all.cancel.back() >= CONSUMER_TIMEOUT * 1000LL) };
+    return (all.errors || slowCancel || (all.completed + all.stopped + all.timedOut != extractors * requests)) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
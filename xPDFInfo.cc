@@ -8,7 +8,13 @@
 #include "xPDFInfo.hh"
 #include <wchar.h>
 #include "PDFExtractor.hh"
+#include "BackgroundQueue.hh"
+#include "ResourceGovernor.hh"
+#include "RequestScheduler.hh"
+#include "SearchPrefetcher.hh"
+#include "DocReclaimer.hh"
 #include <GlobalParams.h>
+#include <Decrypt.h>
 #include <strsafe.h>
 
 /** enableDateTimeField is used to indicate if date time fields are supported by currently used Total Commander version. */
@@ -72,6 +78,12 @@ static PDFExtractor* g_extractor{ nullptr };
 
 static HMODULE hModule{ nullptr };
 
+/** Background extraction of slow fields requested with CONTENT_DELAYIFSLOW flag, shared by all TC threads. */
+static BackgroundQueue g_queue;
+
+/** Speculative text extraction of next documents in TC search, shared by all TC threads. */
+static SearchPrefetcher g_prefetcher;
+
 #ifdef _DEBUG
 /** Writes debug trace.
 * Please note that output trace is limited to 1024 characters!
@@ -143,13 +155,30 @@ BOOL WINAPI DllMain(HINSTANCE hDLL, DWORD reason, LPVOID)
         globalParams->setTextEncoding("UCS-2");         // extracted text encoding (not for metadata)
         globalParams->setTextPageBreaks(gFalse);        // don't add \f for page breaks
         globalParams->setTextEOL("unix");               // extracted text line endings
+#ifdef _DEBUG
+        ThreadData::setTraceHook(_trace);
+#endif
         hModule = static_cast<HMODULE>(hDLL);
         break;
     case DLL_PROCESS_DETACH:
         destroy();              // Release PDFExtractor instance, if any
-        TRACE(L"%hs!globalParams\n", __FUNCTION__);
-        delete globalParams;    // Clean up
-        globalParams = nullptr;
+        g_queue.stop(PRODUCER_TIMEOUT); // Release background extractor before globalParams
+        g_prefetcher.stop(PRODUCER_TIMEOUT);
+        {
+            const auto reclaimed{ DocReclaimer::stop(PRODUCER_TIMEOUT) };  // Destroy closed documents before globalParams
+            Decrypt::clearFileKeyCache();
+            if (reclaimed)
+            {
+                TRACE(L"%hs!globalParams\n", __FUNCTION__);
+                delete globalParams;    // Clean up
+                globalParams = nullptr;
+            }
+            else
+            {
+                // a document is still being destroyed in background, leave globalParams
+                TRACE(L"%hs!globalParams left\n", __FUNCTION__);
+            }
+        }
         hModule = nullptr;
         break;
     case DLL_THREAD_ATTACH:
@@ -240,6 +269,10 @@ void __stdcall ContentSendStateInformationW(int state, const wchar_t* path)
        {
            g_extractor->stop();
        }
+       // values for files from previous directory are not needed
+       g_queue.clear();
+       g_prefetcher.cancel();
+       ResourceGovernor::clearFlags();
        break;
    default:
        break;
@@ -260,6 +293,9 @@ int __stdcall ContentGetValue(const char* fileName, int fieldIndex, int unitInde
 * See "Content Plugin Interface" document.
 * Creates PDFExtractor object, if not already created, calls extraction function.
 * If fieldIndex is out of bounds, current PDF document is closed.
+* If CONTENT_DELAYIFSLOW flag is set, slow fields are queued for background extraction and #ft_delayed is returned,
+* other fields are extracted immediately. When TC asks again from its background thread, value from queue is used.
+* When TC starts to search in a document, next documents in the directory are prefetched, see SearchPrefetcher.
 *
 * @param[in]    fileName        full path to PDF document
 * @param[in]    fieldIndex      index of the field
@@ -277,7 +313,42 @@ int __stdcall ContentGetValueW(const wchar_t* fileName, int fieldIndex, int unit
     {
         if (CONTENT_DELAYIFSLOW & flags)
         {
-            return ft_delayed;
+            if (BackgroundQueue::isSlowField(fieldIndex))
+            {
+                g_queue.enqueue(fileName, fieldIndex, unitIndex);
+                return ft_delayed;
+            }
+        }
+        else
+        {
+            // value may be already extracted in background
+            int result{ ft_fieldempty };
+            if (g_queue.fetch(fileName, fieldIndex, unitIndex, fieldValue, cbfieldValue, result))
+            {
+                return result;
+            }
+        }
+
+        int firstPage{ 1 };
+        if (fieldIndex == fiText)
+        {
+            if (unitIndex == 0)
+            {
+                g_prefetcher.prefetch(fileName);
+            }
+            // text may be already extracted by prefetch
+            int result{ ft_fieldempty };
+            int nextPage{ 0 };
+            if (g_prefetcher.fetch(fileName, unitIndex, fieldValue, cbfieldValue, result, nextPage))
+            {
+                return result;
+            }
+            if (nextPage > 0)
+            {
+                // prefetched text is not ready, extract the rest of the document as a new request
+                unitIndex = 0;
+                firstPage = nextPage;
+            }
         }
 
         if (!g_extractor)
@@ -288,7 +359,9 @@ int __stdcall ContentGetValueW(const wchar_t* fileName, int fieldIndex, int unit
 
         if (g_extractor)
         {
-            return g_extractor->extract(fileName, fieldIndex, unitIndex, fieldValue, cbfieldValue, flags);
+            // cheap column values have priority over search, see RequestScheduler::isInteractive
+            ScopedInteractiveRequest interactive(fieldIndex);
+            return g_extractor->extract(fileName, fieldIndex, unitIndex, fieldValue, cbfieldValue, flags, firstPage);
         }
         TRACE(L"%hs!unable to create extractor\n", __FUNCTION__);
         return ft_fileerror;
@@ -358,15 +431,42 @@ void __stdcall ContentSetDefaultParams(ContentDefaultParamStruct* dps)
     globalOptionsFromIni.discardInvisibleText = GetPrivateProfileIntA(appName, "DiscardInvisibleText", 1, iniFileName);
     globalOptionsFromIni.discardDiagonalText = GetPrivateProfileIntA(appName, "DiscardDiagonalText", 1, iniFileName);
     globalOptionsFromIni.discardClippedText = GetPrivateProfileIntA(appName, "DiscardClippedText", 1, iniFileName);
+    globalOptionsFromIni.skipHiddenContent = GetPrivateProfileIntA(appName, "SkipHiddenContent", 0, iniFileName);
     globalOptionsFromIni.appendExtensionLevel = GetPrivateProfileIntA(appName, "AppendExtensionLevel", 1, iniFileName);
     globalOptionsFromIni.removeDateRawDColon = GetPrivateProfileIntA(appName, "RemoveDateRawDColon", 0, iniFileName);
+    globalOptionsFromIni.extractAnnotations = GetPrivateProfileIntA(appName, "ExtractAnnotations", 0, iniFileName);
+    globalOptionsFromIni.extractXFAData = GetPrivateProfileIntA(appName, "ExtractXFAData", 0, iniFileName);
+    globalOptionsFromIni.compareRevisions = GetPrivateProfileIntA(appName, "CompareRevisions", 1, iniFileName);
     globalOptionsFromIni.marginLeft = GetPrivateProfileIntA(appName, "MarginLeft", 0, iniFileName);
     globalOptionsFromIni.marginRight = GetPrivateProfileIntA(appName, "MarginRight", 0, iniFileName);
     globalOptionsFromIni.marginTop = GetPrivateProfileIntA(appName, "MarginTop", 0, iniFileName);
     globalOptionsFromIni.marginBottom = GetPrivateProfileIntA(appName, "MarginBottom", 0, iniFileName);
     globalOptionsFromIni.pageContentsLengthMin = GetPrivateProfileIntA(appName, "PageContentsLengthMin", 32, iniFileName);
+    globalOptionsFromIni.maxExtractionTime = GetPrivateProfileIntA(appName, "MaxExtractionTime", 0, iniFileName);
+    globalOptionsFromIni.maxDecodedSize = GetPrivateProfileIntA(appName, "MaxDecodedSize", 0, iniFileName);
+    globalOptionsFromIni.maxOperators = GetPrivateProfileIntA(appName, "MaxOperators", 0, iniFileName);
+    globalOptionsFromIni.maxGlyphs = GetPrivateProfileIntA(appName, "MaxGlyphs", 0, iniFileName);
+    globalOptionsFromIni.maxHeapGrowth = GetPrivateProfileIntA(appName, "MaxHeapGrowth", 0, iniFileName);
+    globalOptionsFromIni.maxPageTextMemory = GetPrivateProfileIntA(appName, "MaxPageTextMemory", 0, iniFileName);
+    globalOptionsFromIni.searchPrefetchThreads = GetPrivateProfileIntA(appName, "SearchPrefetchThreads", 0, iniFileName);
+    globalOptionsFromIni.searchPrefetchDepth = GetPrivateProfileIntA(appName, "SearchPrefetchDepth", 2, iniFileName);
+    globalOptionsFromIni.readAheadSize = GetPrivateProfileIntA(appName, "ReadAheadSize", 16, iniFileName);
+    globalOptionsFromIni.decodeAheadPages = GetPrivateProfileIntA(appName, "DecodeAheadPages", 2, iniFileName);
+    globalOptionsFromIni.searchEmbeddedFiles = GetPrivateProfileIntA(appName, "SearchEmbeddedFiles", 0, iniFileName);
     globalOptionsFromIni.textOutputMode = static_cast<TextOutputMode>(GetPrivateProfileIntA(appName, "TextOutputMode", 0, iniFileName) % (textOutRawOrder + 1));
 
+    if (globalOptionsFromIni.extractAnnotations && globalParams)
+    {
+        // annotation and form field text is read from dictionaries, don't generate and interpret appearance streams
+        globalParams->setDrawAnnotations(gFalse);
+        globalParams->setDrawFormFields(gFalse);
+    }
+    if (globalParams)
+    {
+        // layers are read only to skip the hidden ones, otherwise text of all layers is extracted
+        globalParams->setEnableOptionalContent(globalOptionsFromIni.skipHiddenContent ? gTrue : gFalse);
+    }
+
     char tmp[2];
     if (GetPrivateProfileStringA(appName, "AttrCopyingAllowed", "C", tmp, sizeof(tmp), iniFileName) == 1)
         mbtowc(&globalOptionsFromIni.attrCopyable, tmp, 1);
@@ -405,6 +505,10 @@ void __stdcall ContentPluginUnloading()
     {
         g_extractor->abort();
     }
+    g_queue.stop(PRODUCER_TIMEOUT);
+    g_prefetcher.stop(PRODUCER_TIMEOUT);
+    DocReclaimer::stop(PRODUCER_TIMEOUT);
+    Decrypt::clearFileKeyCache();
 }
 
 /**
@@ -420,6 +524,8 @@ void __stdcall ContentStopGetValueW(const wchar_t* fileName)
     {
         g_extractor->stop();
     }
+    // search is stopped, prefetched documents are not needed
+    g_prefetcher.cancel();
 }
 /**
 * ContentGetSupportedFieldFlags is called to get various information about a plugin variable.
@@ -6,7 +6,9 @@
 
 #pragma once
 #include "contentplug.h"
+#include "FieldIndexes.hh"
 #include <TextOutputDev.h>
+#include <cstdint>
 
 /**
 * PDF page units
@@ -28,14 +30,29 @@ typedef struct options_s
     bool discardInvisibleText{ true };  /**< discard all invisible characters */
     bool discardDiagonalText{ true };   /**< discard all text that's not close to 0/90/180/270 degrees */
     bool discardClippedText{ true };    /**< discard all clipped characters */
+    bool skipHiddenContent{ false };    /**< skip content of hidden optional content (layers), otherwise text of all layers is extracted */
     bool appendExtensionLevel{ true };  /**< append PDF Extension Level to PDF version, e.g. 1.7 extension level 3 = 1.73 */
     bool removeDateRawDColon{ false };  /**< remove D: from DateRaw string */
+    bool extractAnnotations{ false };   /**< extract text from annotations and form fields directly, without drawing appearance streams */
+    bool extractXFAData{ false };       /**< extract text of XFA form data (datasets packet) after the text of pages */
+    bool compareRevisions{ true };      /**< compare text of changed pages only, if compared files are revisions of one document */
     TextOutputMode textOutputMode{ textOutReadingOrder }; /**< text formatting mode, see TextOutputControl in TextOutputDev.h */
     int marginLeft{ 0 };                /**< discard all characters left of mediaBox + marginLeft */
     int marginRight{ 0 };               /**< discard all characters right of mediaBox - marginRight */
     int marginTop{ 0 };                 /**< discard all characters above of mediaBox - marginTop */
     int marginBottom{ 0 };              /**< discard all characters bellow of mediaBox + marginBottom */
     int pageContentsLengthMin{ 32 };    /**< minimal length of page Contents stream so page is not considered empty. Used for "Number of Fontless pages"  and "Number of pages with images"  fields */
+    uint32_t maxExtractionTime{ 0 };    /**< max time of text extraction from one document in miliseconds, 0 = unlimited */
+    uint32_t maxDecodedSize{ 0 };       /**< max size of decoded (decompressed) streams of one document in MB, 0 = unlimited */
+    uint32_t maxOperators{ 0 };         /**< max number of content stream operators executed for one document, 0 = unlimited */
+    uint32_t maxGlyphs{ 0 };            /**< max number of glyphs on one page, 0 = unlimited */
+    uint32_t maxHeapGrowth{ 0 };        /**< max growth of process private memory during text extraction from one document in MB, 0 = unlimited */
+    uint32_t maxPageTextMemory{ 0 };    /**< max memory for text layout of one page in MB, larger pages are extracted in parts, 0 = unlimited */
+    unsigned searchPrefetchThreads{ 0 };/**< number of threads extracting text of next documents in TC search, 0 = prefetch disabled */
+    unsigned searchPrefetchDepth{ 2 };  /**< number of next documents prefetched in TC search */
+    uint32_t readAheadSize{ 16 };       /**< max size of content streams of the page after decoded pages read ahead during TC search in MB, 0 = read ahead disabled */
+    unsigned decodeAheadPages{ 2 };     /**< number of next pages decoded by helper thread during TC search, 0 = decode ahead disabled */
+    unsigned searchEmbeddedFiles{ 0 };  /**< max nesting depth of embedded PDF documents searched after the text of document, 0 = embedded files are not searched */
     wchar_t attrCopyable{ L'\0' };
     wchar_t attrPrintable{ L'\0' };
     wchar_t attrCommentable{ L'\0' };
@@ -51,23 +68,6 @@ typedef struct options_s
 
 extern options_t globalOptionsFromIni;
 
-/**
-* The fieldIndexes enumeration is used simplify access to fields.
-*/
-enum fieldIndexes
-{
-    fiTitle, fiSubject, fiKeywords, fiAuthor, fiCreator, fiProducer, fiDocStart, fiFirstRow, fiExtensions,
-    fiNumberOfPages, fiNumberOfFontlessPages,fiNumberOfPagesWithImages,
-    fiPDFVersion, fiPageWidth, fiPageHeight,
-    fiCopyable, fiPrintable, fiCommentable, fiChangeable, fiEncrypted, fiTagged, fiLinearized, fiIncremental, fiSigned, fiOutlined, fiEmbeddedFiles,
-    fiCreationDate, fiModifiedDate, fiMetadataDate,
-    fiID, fiAttributesString, fiConformance, fiCreationDateRaw, fiModifiedDateRaw, fiMetadataDateRaw,
-    fiOutlines, fiText
-};
-
-/**< used to globally set the number of supported fields. */
-constexpr size_t FIELD_COUNT{ static_cast<size_t>(fiText + 1) };
-
 #ifdef _DEBUG
 extern bool __cdecl _trace(const wchar_t *format, ...);
 #define TRACE _trace
@@ -61,6 +61,10 @@ public:
   // Assumes 0 <= i < length.
   void *del(int i);
 
+  // Deletes and returns the last element, keeping the allocated space.
+  // Assumes length > 0.
+  void *pop() { return data[--length]; }
+
   // Sort the list accoring to the given comparison function.
   // NB: this sorts an array of pointers, so the pointer args need to
   // be double-dereferenced.
@@ -72,6 +76,10 @@ public:
   // Reverse the list.
   void reverse();
 
+  // Remove all elements, keeping the allocated space.  Does not free
+  // pointed-to objects.
+  void clear() { length = 0; }
+
   //----- control
 
   // Set allocation increment to <inc>.  If inc > 0, that many
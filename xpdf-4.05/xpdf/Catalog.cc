@@ -23,11 +23,15 @@
 #include "Dict.h"
 #include "Page.h"
 #include "Error.h"
+#include "GlobalParams.h"
 #include "Link.h"
 #include "AcroForm.h"
 #include "TextString.h"
 #include "Catalog.h"
 
+// max depth of the page tree above the first page of a linearized file
+#define firstPageMaxDepth 64
+
 //------------------------------------------------------------------------
 // PageTreeNode
 //------------------------------------------------------------------------
@@ -158,7 +162,11 @@ Catalog::Catalog(PDFDoc *docA)
   }
 
   // read page tree
-  if (!readPageTree()) {
+  if (doc->isFirstPageOnly()) {
+    if (!readFirstPage()) {
+      return;
+    }
+  } else if (!readPageTree()) {
       return;
   }
 
@@ -213,10 +221,12 @@ Catalog::Catalog(PDFDoc *docA)
                    obj.getBool();
   obj.free();
 
-#ifndef NO_EMBEDDED_CONTENT
   // get the OCProperties dictionary
-  catDict.dictLookup("OCProperties", &ocProperties);
+  if (globalParams->getEnableOptionalContent()) {
+    catDict.dictLookup("OCProperties", &ocProperties);
+  }
 
+#ifndef NO_EMBEDDED_CONTENT
   // get the list of embedded files
   readEmbeddedFileList(catDict.getDict());
 #endif
@@ -235,12 +245,9 @@ Catalog::~Catalog() {
   }
   if (pages) {
     for (i = 0; i < numPages; ++i) {
-      if (pages[i]) {
-	delete pages[i];
-	pages[i] = NULL;
-      }
+      delete pages[i].load();
     }
-    gfree(pages);
+    delete[] pages;
     gfree(pageRefs);
     pages = NULL;
     pageRefs = NULL;
@@ -276,51 +283,35 @@ Catalog::~Catalog() {
   catDict.free();
 }
 
+// Loaded pages are read without locking: the acquire load pairs with
+// the release store in loadPage2, so the page object and its entry in
+// pageRefs are visible to every thread which sees the pointer.  Only
+// threads which find an unloaded page take pageMutex.
 Page *Catalog::getPage(int i) {
-  Page *page = NULL;
+  Page *page;
 
-#if MULTITHREADED
-  gLockMutex(&pageMutex);
-#endif
-  if (pages && (i > 0)) {
-      if (!pages[i - 1]) {
-          loadPage(i);
-      }
-      page = pages[i - 1];
+  if (!pages || i < 1 || i > numPages) {
+    return NULL;
+  }
+  if (!(page = pages[i-1].load(std::memory_order_acquire))) {
+    page = loadPage(i);
   }
-#if MULTITHREADED
-  gUnlockMutex(&pageMutex);
-#endif
   return page;
 }
 
 Ref *Catalog::getPageRef(int i) {
-  Ref *pageRef;
-
-#if MULTITHREADED
-  gLockMutex(&pageMutex);
-#endif
-  if (!pages[i-1]) {
+  if (!pages[i-1].load(std::memory_order_acquire)) {
     loadPage(i);
   }
-  pageRef = &pageRefs[i-1];
-#if MULTITHREADED
-  gUnlockMutex(&pageMutex);
-#endif
-  return pageRef;
+  return &pageRefs[i-1];
 }
 
 void Catalog::doneWithPage(int i) {
-#if MULTITHREADED
-  gLockMutex(&pageMutex);
-#endif
-  if (pages[i-1]) {
-    delete pages[i-1];
-    pages[i-1] = NULL;
+  Page *page;
+
+  if ((page = pages[i-1].exchange(NULL, std::memory_order_acq_rel))) {
+    delete page;
   }
-#if MULTITHREADED
-  gUnlockMutex(&pageMutex);
-#endif
 }
 
 GString *Catalog::readMetadata() {
@@ -349,25 +340,15 @@ GString *Catalog::readMetadata() {
 }
 
 int Catalog::findPage(int num, int gen) {
+  Ref *ref;
   int i;
 
-#if MULTITHREADED
-  gLockMutex(&pageMutex);
-#endif
-  for (i = 0; i < numPages; ++i) {
-    if (!pages[i]) {
-      loadPage(i+1);
-    }
-    if (pageRefs[i].num == num && pageRefs[i].gen == gen) {
-#if MULTITHREADED
-      gUnlockMutex(&pageMutex);
-#endif
-      return i + 1;
+  for (i = 1; i <= numPages; ++i) {
+    ref = getPageRef(i);
+    if (ref->num == num && ref->gen == gen) {
+      return i;
     }
   }
-#if MULTITHREADED
-  gUnlockMutex(&pageMutex);
-#endif
   return 0;
 }
 
@@ -527,7 +508,7 @@ GBool Catalog::readPageTree() {
   pageTree = new PageTreeNode(topPagesRef.getRef(), numPages, NULL);
   topPagesObj.free();
   topPagesRef.free();
-  pages = (Page **)greallocn(pages, numPages, sizeof(Page *));
+  pages = new std::atomic<Page *>[numPages];
   pageRefs = (Ref *)greallocn(pageRefs, numPages, sizeof(Ref));
   for (i = 0; i < numPages; ++i) {
     pages[i] = NULL;
@@ -537,6 +518,93 @@ GBool Catalog::readPageTree() {
   return gTrue;
 }
 
+// Set up a one page catalog from the first page object of a linearized
+// file.  The page tree isn't read: its nodes are usually stored after
+// the first page section.
+GBool Catalog::readFirstPage() {
+  numPages = 1;
+  pages = new std::atomic<Page *>[numPages];
+  pageRefs = (Ref *)gmallocn(numPages, sizeof(Ref));
+  pages[0] = NULL;
+  pageRefs[0].num = -1;
+  pageRefs[0].gen = -1;
+  return loadFirstPage();
+}
+
+// Load the first page object of a linearized file.  Inherited
+// attributes are read from the ancestors of the page, which must be
+// available in the first page xref section.
+GBool Catalog::loadFirstPage() {
+  Object pageRefObj, pageObj;
+  XRefEntry *entry;
+  PageAttrs *attrs;
+  Page *page;
+  int num;
+
+  num = doc->getFirstPageObjNum();
+  if (num >= xref->getNumObjects() ||
+      (entry = xref->getEntry(num))->type == xrefEntryFree) {
+    error(errSyntaxError, -1,
+	  "First page object is not in the first page xref section");
+    return gFalse;
+  }
+  pageRefObj.initRef(num, entry->type == xrefEntryUncompressed ? entry->gen
+			                                       : 0);
+  if (!pageRefObj.fetch(xref, &pageObj)->isDict("Page")) {
+    error(errSyntaxError, -1, "First page object is wrong type ({0:s})",
+	  pageObj.getTypeName());
+    pageObj.free();
+    return gFalse;
+  }
+  if (!(attrs = readFirstPageAttrs(pageObj.getDict(), 0))) {
+    pageObj.free();
+    return gFalse;
+  }
+  if (pageRefs[0].num < 0) {
+    pageRefs[0] = pageRefObj.getRef();
+  }
+  page = new Page(doc, 1, pageObj.getDict(), attrs);
+  if (!page->isOk()) {
+    delete page;
+    page = new Page(doc, 1);
+  }
+  pages[0].store(page, std::memory_order_release);
+  pageObj.free();
+  return gTrue;
+}
+
+// Merge the attributes of page tree node [dict] with the attributes
+// of its ancestors.  Linearization pushes inherited attributes down to
+// the page objects, so the ancestors are usually stored after the
+// first page section; a node whose parent can't be read must have its
+// own MediaBox and Resources.  Returns NULL if the attributes are
+// incomplete.
+PageAttrs *Catalog::readFirstPageAttrs(Dict *dict, int depth) {
+  Object parentObj, obj;
+  PageAttrs *parentAttrs, *attrs;
+  GBool complete;
+
+  parentAttrs = NULL;
+  if (depth < firstPageMaxDepth &&
+      dict->lookup("Parent", &parentObj)->isDict()) {
+    parentAttrs = readFirstPageAttrs(parentObj.getDict(), depth + 1);
+  }
+  parentObj.free();
+  if (!parentAttrs) {
+    complete = dict->lookupNF("MediaBox", &obj)->isArray() ||
+	       obj.isRef();
+    obj.free();
+    complete = complete && !dict->lookupNF("Resources", &obj)->isNull();
+    obj.free();
+    if (!complete) {
+      return NULL;
+    }
+  }
+  attrs = new PageAttrs(parentAttrs, dict, xref);
+  delete parentAttrs;
+  return attrs;
+}
+
 int Catalog::countPageTree(Object *pagesNodeRef, char *touchedObjs) {
   // check for invalid reference
   if (pagesNodeRef->isRef() &&
@@ -587,19 +655,38 @@ int Catalog::countPageTree(Object *pagesNodeRef, char *touchedObjs) {
   return n;
 }
 
-void Catalog::loadPage(int pg) {
-  loadPage2(pg, pg - 1, pageTree);
+// Load page [pg] if no other thread has loaded it yet.  Returns the
+// loaded page.
+Page *Catalog::loadPage(int pg) {
+  Page *page;
+
+#if MULTITHREADED
+  gLockMutex(&pageMutex);
+#endif
+  if (!(page = pages[pg-1].load(std::memory_order_acquire))) {
+    if (pageTree) {
+      loadPage2(pg, pg - 1, pageTree);
+    } else if (!loadFirstPage()) {
+      pages[pg-1].store(new Page(doc, pg), std::memory_order_release);
+    }
+    page = pages[pg-1].load(std::memory_order_relaxed);
+  }
+#if MULTITHREADED
+  gUnlockMutex(&pageMutex);
+#endif
+  return page;
 }
 
 void Catalog::loadPage2(int pg, int relPg, PageTreeNode *node) {
   Object pageRefObj, pageObj, kidsObj, kidRefObj, kidObj, countObj;
   PageTreeNode *kidNode, *p;
   PageAttrs *attrs;
+  Page *page;
   int count, i;
 
   if (relPg >= node->count) {
     error(errSyntaxError, -1, "Internal error in page tree");
-    pages[pg-1] = new Page(doc, pg);
+    pages[pg-1].store(new Page(doc, pg), std::memory_order_release);
     return;
   }
 
@@ -611,7 +698,7 @@ void Catalog::loadPage2(int pg, int relPg, PageTreeNode *node) {
     for (p = node->parent; p; p = p->parent) {
       if (node->ref.num == p->ref.num && node->ref.gen == p->ref.gen) {
 	error(errSyntaxError, -1, "Loop in Pages tree");
-	pages[pg-1] = new Page(doc, pg);
+	pages[pg-1].store(new Page(doc, pg), std::memory_order_release);
 	return;
       }
     }
@@ -623,7 +710,7 @@ void Catalog::loadPage2(int pg, int relPg, PageTreeNode *node) {
 	    pageObj.getTypeName());
       pageObj.free();
       pageRefObj.free();
-      pages[pg-1] = new Page(doc, pg);
+      pages[pg-1].store(new Page(doc, pg), std::memory_order_release);
       return;
     }
 
@@ -632,8 +719,26 @@ void Catalog::loadPage2(int pg, int relPg, PageTreeNode *node) {
 			               : (PageAttrs *)NULL,
 			  pageObj.getDict(), xref);
 
-    // if "Kids" exists, it's an internal node
+    // if "Kids" exists, it's an internal node -- the kids are
+    // prefetched in file offset order, because they are fetched one by
+    // one for their Count values; pageMutex is released while the file
+    // is read, so other threads can load already known pages meanwhile
     if (pageObj.dictLookup("Kids", &kidsObj)->isArray()) {
+#if MULTITHREADED
+      gUnlockMutex(&pageMutex);
+#endif
+      prefetchKids(&kidsObj);
+#if MULTITHREADED
+      gLockMutex(&pageMutex);
+#endif
+    }
+
+    if (node->kids) {
+
+      // another thread has read this node while pageMutex was released
+      delete attrs;
+
+    } else if (kidsObj.isArray()) {
 
       // save the PageAttrs
       node->attrs = attrs;
@@ -664,15 +769,25 @@ void Catalog::loadPage2(int pg, int relPg, PageTreeNode *node) {
 	kidRefObj.free();
       }
 
+    } else if (pages[pg-1].load(std::memory_order_relaxed)) {
+
+      // another thread has loaded the page while pageMutex was released
+      delete attrs;
+
     } else {
       
-      // create the Page object
-      pageRefs[pg-1] = node->ref;
-      pages[pg-1] = new Page(doc, pg, pageObj.getDict(), attrs);
-      if (!pages[pg-1]->isOk()) {
-	delete pages[pg-1];
-	pages[pg-1] = new Page(doc, pg);
+      // create the Page object -- pageRefs is written only once,
+      // because lock-free readers may read it while a page released
+      // by doneWithPage is loaded again
+      if (pageRefs[pg-1].num < 0) {
+	pageRefs[pg-1] = node->ref;
+      }
+      page = new Page(doc, pg, pageObj.getDict(), attrs);
+      if (!page->isOk()) {
+	delete page;
+	page = new Page(doc, pg);
       }
+      pages[pg-1].store(page, std::memory_order_release);
 
     }
 
@@ -696,9 +811,26 @@ void Catalog::loadPage2(int pg, int relPg, PageTreeNode *node) {
     // (i.e., parent count > sum of children counts)
     if (i == node->kids->getLength()) {
       error(errSyntaxError, -1, "Invalid page count in page tree");
-      pages[pg-1] = new Page(doc, pg);
+      pages[pg-1].store(new Page(doc, pg), std::memory_order_release);
+    }
+  }
+}
+
+void Catalog::prefetchKids(Object *kidsObj) {
+  Object kidRefObj;
+  Ref *refs;
+  int nRefs, i;
+
+  refs = (Ref *)gmallocn(kidsObj->arrayGetLength(), sizeof(Ref));
+  nRefs = 0;
+  for (i = 0; i < kidsObj->arrayGetLength(); ++i) {
+    if (kidsObj->arrayGetNF(i, &kidRefObj)->isRef()) {
+      refs[nRefs++] = kidRefObj.getRef();
     }
+    kidRefObj.free();
   }
+  xref->prefetch(refs, nRefs);
+  gfree(refs);
 }
 
 Object *Catalog::getDestOutputProfile(Object *destOutProf) {
@@ -11,6 +11,7 @@
 
 #include <aconf.h>
 
+#include <atomic>
 #if MULTITHREADED
 #include "GMutex.h"
 #endif
@@ -126,10 +127,13 @@ private:
   PDFDoc *doc;
   XRef *xref;			// the xref table for this PDF file
   PageTreeNode *pageTree{ nullptr };	// the page tree
-  Page **pages{ nullptr };			// array of pages
-  Ref *pageRefs{ nullptr };		// object ID for each page
+  std::atomic<Page *> *pages{ nullptr };	// array of pages, a loaded page
+				//   is published with a release store
+  Ref *pageRefs{ nullptr };		// object ID for each page, written
+				//   before the page is published
 #if MULTITHREADED
-  GMutex pageMutex;
+  GMutex pageMutex;		// serializes page loading (page tree
+				//   expansion), not lookups of loaded pages
 #endif
   int numPages{ 0 };			// number of pages
   Object dests;			// named destination dictionary
@@ -151,9 +155,13 @@ private:
 
   Object *findDestInTree(Object *tree, GString *name, Object *obj);
   GBool readPageTree();
+  GBool readFirstPage();
+  GBool loadFirstPage();
+  PageAttrs *readFirstPageAttrs(Dict *dict, int depth);
   int countPageTree(Object *pagesNodeRef, char *touchedObjs);
-  void loadPage(int pg);
+  Page *loadPage(int pg);
   void loadPage2(int pg, int relPg, PageTreeNode *node);
+  void prefetchKids(Object *kidsObj);
 #ifndef NO_EMBEDDED_CONTENT
   void readEmbeddedFileList(Dict *catDict);
   void readEmbeddedFileTree(Object *nodeRef, char *touchedObjs);
@@ -9,6 +9,7 @@
 #include <aconf.h>
 
 #include <string.h>
+#include <mutex>
 #include "gmem.h"
 #include "gmempp.h"
 #include "Decrypt.h"
@@ -20,6 +21,16 @@ static void sha256(Guchar *msg, int msgLen, Guchar *hash);
 static void sha384(Guchar *msg, int msgLen, Guchar *hash);
 static void sha512(Guchar *msg, int msgLen, Guchar *hash);
 
+// Number of decrypted bytes between two abort checks.
+#define decryptAbortCheckSize 1048576
+
+// Size of the input buffer of DecryptStream::getBlock (a multiple of
+// the AES block size).
+#define decryptBlockSize 4096
+
+// Max number of revision 6 file keys kept in the cache.
+#define fileKeyCacheSize 64
+
 static Guchar passwordPad[32] = {
   0x28, 0xbf, 0x4e, 0x5e, 0x4e, 0x75, 0x8a, 0x41,
   0x64, 0x00, 0x4e, 0x56, 0xff, 0xfa, 0x01, 0x08, 
@@ -27,6 +38,101 @@ static Guchar passwordPad[32] = {
   0x2f, 0x0c, 0xa9, 0xfe, 0x64, 0x53, 0x69, 0x7a
 };
 
+//------------------------------------------------------------------------
+// revision 6 file key cache
+//------------------------------------------------------------------------
+
+struct FileKeyCacheEntry {
+  Guchar id[32];		// SHA-256 of the makeFileKey inputs
+  Guchar fileKey[32];
+  GBool ok;			// makeFileKey result
+  GBool ownerPasswordOk;
+};
+
+// Most recently used entries first.
+static FileKeyCacheEntry fileKeyCache[fileKeyCacheSize];
+static int fileKeyCacheLen = 0;
+static std::mutex fileKeyCacheMutex;
+
+static void appendFileKeyInput(GString *buf, GString *s) {
+  int len;
+
+  // NULL strings (passwords) are distinguished from empty strings
+  len = s ? s->getLength() : -1;
+  buf->append((char)(len >> 24))->append((char)(len >> 16))
+     ->append((char)(len >> 8))->append((char)len);
+  if (s) {
+    buf->append(s);
+  }
+}
+
+// Compute the cache ID of a revision 6 file key: a hash of the
+// encryption dictionary values, the file ID, and the passwords (which
+// are not stored in the cache).
+static void makeFileKeyCacheID(GString *ownerKey, GString *userKey,
+			       GString *ownerEnc, GString *userEnc,
+			       GString *fileID, GString *ownerPassword,
+			       GString *userPassword, Guchar *id) {
+  GString *buf;
+
+  buf = new GString();
+  appendFileKeyInput(buf, ownerKey);
+  appendFileKeyInput(buf, userKey);
+  appendFileKeyInput(buf, ownerEnc);
+  appendFileKeyInput(buf, userEnc);
+  appendFileKeyInput(buf, fileID);
+  appendFileKeyInput(buf, ownerPassword);
+  appendFileKeyInput(buf, userPassword);
+  sha256((Guchar *)buf->getCString(), buf->getLength(), id);
+  memset(buf->getCString(), 0, buf->getLength());
+  delete buf;
+}
+
+static GBool lookupFileKey(Guchar *id, Guchar *fileKey, GBool *ok,
+			   GBool *ownerPasswordOk) {
+  FileKeyCacheEntry entry;
+  int i;
+
+  std::lock_guard<std::mutex> lock(fileKeyCacheMutex);
+  for (i = 0; i < fileKeyCacheLen; ++i) {
+    if (!memcmp(fileKeyCache[i].id, id, 32)) {
+      entry = fileKeyCache[i];
+      memmove(&fileKeyCache[1], &fileKeyCache[0],
+	      i * sizeof(FileKeyCacheEntry));
+      fileKeyCache[0] = entry;
+      memcpy(fileKey, entry.fileKey, 32);
+      *ok = entry.ok;
+      *ownerPasswordOk = entry.ownerPasswordOk;
+      return gTrue;
+    }
+  }
+  return gFalse;
+}
+
+static void storeFileKey(Guchar *id, Guchar *fileKey, GBool ok,
+			 GBool ownerPasswordOk) {
+  std::lock_guard<std::mutex> lock(fileKeyCacheMutex);
+  if (fileKeyCacheLen < fileKeyCacheSize) {
+    ++fileKeyCacheLen;
+  }
+  memmove(&fileKeyCache[1], &fileKeyCache[0],
+	  (fileKeyCacheLen - 1) * sizeof(FileKeyCacheEntry));
+  memcpy(fileKeyCache[0].id, id, 32);
+  if (ok) {
+    memcpy(fileKeyCache[0].fileKey, fileKey, 32);
+  } else {
+    memset(fileKeyCache[0].fileKey, 0, 32);
+  }
+  fileKeyCache[0].ok = ok;
+  fileKeyCache[0].ownerPasswordOk = ownerPasswordOk;
+}
+
+void Decrypt::clearFileKeyCache() {
+  std::lock_guard<std::mutex> lock(fileKeyCacheMutex);
+  memset(fileKeyCache, 0, sizeof(fileKeyCache));
+  fileKeyCacheLen = 0;
+}
+
 //------------------------------------------------------------------------
 // Decrypt
 //------------------------------------------------------------------------
@@ -38,101 +144,35 @@ GBool Decrypt::makeFileKey(int encVersion, int encRevision, int keyLength,
 			   GString *ownerPassword, GString *userPassword,
 			   Guchar *fileKey, GBool encryptMetadata,
 			   GBool *ownerPasswordOk) {
-  DecryptAES256State state;
-  Guchar test[127 + 56], test2[32];
+  Guchar cacheID[32];
+  Guchar test[32], test2[32];
   GString *userPassword2;
-  const char *userPW;
   Guchar fState[256];
   Guchar tmpKey[16];
   Guchar fx, fy;
   int len, i, j;
+  GBool ok;
 
   *ownerPasswordOk = gFalse;
 
   if (encRevision == 5 || encRevision == 6) {
-
-    // check the owner password
-    if (ownerPassword) {
-      //~ this is supposed to convert the password to UTF-8 using "SASLprep"
-      len = ownerPassword->getLength();
-      if (len > 127) {
-	len = 127;
-      }
-      memcpy(test, ownerPassword->getCString(), len);
-      memcpy(test + len, ownerKey->getCString() + 32, 8);
-      memcpy(test + len + 8, userKey->getCString(), 48);
-      sha256(test, len + 56, test);
-      if (encRevision == 6) {
-	r6Hash(test, 32, ownerPassword->getCString(), len,
-	       userKey->getCString());
-      }
-      if (!memcmp(test, ownerKey->getCString(), 32)) {
-
-	// compute the file key from the owner password
-	memcpy(test, ownerPassword->getCString(), len);
-	memcpy(test + len, ownerKey->getCString() + 40, 8);
-	memcpy(test + len + 8, userKey->getCString(), 48);
-	sha256(test, len + 56, test);
-	if (encRevision == 6) {
-	  r6Hash(test, 32, ownerPassword->getCString(), len,
-		 userKey->getCString());
-	}
-	aes256KeyExpansion(&state, test, 32);
-	for (i = 0; i < 16; ++i) {
-	  state.cbc[i] = 0;
-	}
-	aes256DecryptBlock(&state, (Guchar *)ownerEnc->getCString(), gFalse);
-	memcpy(fileKey, state.buf, 16);
-	aes256DecryptBlock(&state, (Guchar *)ownerEnc->getCString() + 16,
-			   gFalse);
-	memcpy(fileKey + 16, state.buf, 16);
-
-	*ownerPasswordOk = gTrue;
-	return gTrue;
-      }
+    if (encRevision == 5) {
+      return makeFileKey3(encRevision, ownerKey, userKey, ownerEnc, userEnc,
+			  ownerPassword, userPassword, fileKey,
+			  ownerPasswordOk);
     }
 
-    // check the user password
-    if (userPassword) {
-      //~ this is supposed to convert the password to UTF-8 using "SASLprep"
-      userPW = userPassword->getCString();
-      len = userPassword->getLength();
-      if (len > 127) {
-	len = 127;
-      }
-    } else {
-      userPW = "";
-      len = 0;
-    }
-    memcpy(test, userPW, len);
-    memcpy(test + len, userKey->getCString() + 32, 8);
-    sha256(test, len + 8, test);
-    if (encRevision == 6) {
-      r6Hash(test, 32, userPW, len, NULL);
+    // the revision 6 hash is slow, and the same documents are opened
+    // again and again, so the results are cached
+    makeFileKeyCacheID(ownerKey, userKey, ownerEnc, userEnc, fileID,
+		       ownerPassword, userPassword, cacheID);
+    if (lookupFileKey(cacheID, fileKey, &ok, ownerPasswordOk)) {
+      return ok;
     }
-    if (!memcmp(test, userKey->getCString(), 32)) {
-
-      // compute the file key from the user password
-      memcpy(test, userPW, len);
-      memcpy(test + len, userKey->getCString() + 40, 8);
-      sha256(test, len + 8, test);
-      if (encRevision == 6) {
-	r6Hash(test, 32, userPW, len, NULL);
-      }
-      aes256KeyExpansion(&state, test, 32);
-      for (i = 0; i < 16; ++i) {
-	state.cbc[i] = 0;
-      }
-      aes256DecryptBlock(&state, (Guchar *)userEnc->getCString(), gFalse);
-      memcpy(fileKey, state.buf, 16);
-      aes256DecryptBlock(&state, (Guchar *)userEnc->getCString() + 16,
-			 gFalse);
-      memcpy(fileKey + 16, state.buf, 16);
-
-      return gTrue; 
-    }
-
-    return gFalse;
+    ok = makeFileKey3(encRevision, ownerKey, userKey, ownerEnc, userEnc,
+		      ownerPassword, userPassword, fileKey, ownerPasswordOk);
+    storeFileKey(cacheID, fileKey, ok, *ownerPasswordOk);
+    return ok;
 
   } else {
 
@@ -188,6 +228,101 @@ GBool Decrypt::makeFileKey(int encVersion, int encRevision, int keyLength,
   }
 }
 
+// Generate a file key for revision 5 or 6 (AES-256).
+GBool Decrypt::makeFileKey3(int encRevision,
+			    GString *ownerKey, GString *userKey,
+			    GString *ownerEnc, GString *userEnc,
+			    GString *ownerPassword, GString *userPassword,
+			    Guchar *fileKey, GBool *ownerPasswordOk) {
+  DecryptAES256State state;
+  Guchar test[127 + 56];
+  const char *userPW;
+  int len, i;
+
+  // check the owner password
+  if (ownerPassword) {
+    //~ this is supposed to convert the password to UTF-8 using "SASLprep"
+    len = ownerPassword->getLength();
+    if (len > 127) {
+      len = 127;
+    }
+    memcpy(test, ownerPassword->getCString(), len);
+    memcpy(test + len, ownerKey->getCString() + 32, 8);
+    memcpy(test + len + 8, userKey->getCString(), 48);
+    sha256(test, len + 56, test);
+    if (encRevision == 6) {
+      r6Hash(test, 32, ownerPassword->getCString(), len,
+	     userKey->getCString());
+    }
+    if (!memcmp(test, ownerKey->getCString(), 32)) {
+
+      // compute the file key from the owner password
+      memcpy(test, ownerPassword->getCString(), len);
+      memcpy(test + len, ownerKey->getCString() + 40, 8);
+      memcpy(test + len + 8, userKey->getCString(), 48);
+      sha256(test, len + 56, test);
+      if (encRevision == 6) {
+	r6Hash(test, 32, ownerPassword->getCString(), len,
+	       userKey->getCString());
+      }
+      aes256KeyExpansion(&state, test, 32);
+      for (i = 0; i < 16; ++i) {
+	state.cbc[i] = 0;
+      }
+      aes256DecryptBlock(&state, (Guchar *)ownerEnc->getCString(), gFalse);
+      memcpy(fileKey, state.buf, 16);
+      aes256DecryptBlock(&state, (Guchar *)ownerEnc->getCString() + 16,
+			 gFalse);
+      memcpy(fileKey + 16, state.buf, 16);
+
+      *ownerPasswordOk = gTrue;
+      return gTrue;
+    }
+  }
+
+  // check the user password
+  if (userPassword) {
+    //~ this is supposed to convert the password to UTF-8 using "SASLprep"
+    userPW = userPassword->getCString();
+    len = userPassword->getLength();
+    if (len > 127) {
+      len = 127;
+    }
+  } else {
+    userPW = "";
+    len = 0;
+  }
+  memcpy(test, userPW, len);
+  memcpy(test + len, userKey->getCString() + 32, 8);
+  sha256(test, len + 8, test);
+  if (encRevision == 6) {
+    r6Hash(test, 32, userPW, len, NULL);
+  }
+  if (!memcmp(test, userKey->getCString(), 32)) {
+
+    // compute the file key from the user password
+    memcpy(test, userPW, len);
+    memcpy(test + len, userKey->getCString() + 40, 8);
+    sha256(test, len + 8, test);
+    if (encRevision == 6) {
+      r6Hash(test, 32, userPW, len, NULL);
+    }
+    aes256KeyExpansion(&state, test, 32);
+    for (i = 0; i < 16; ++i) {
+      state.cbc[i] = 0;
+    }
+    aes256DecryptBlock(&state, (Guchar *)userEnc->getCString(), gFalse);
+    memcpy(fileKey, state.buf, 16);
+    aes256DecryptBlock(&state, (Guchar *)userEnc->getCString() + 16,
+		       gFalse);
+    memcpy(fileKey + 16, state.buf, 16);
+
+    return gTrue; 
+  }
+
+  return gFalse;
+}
+
 void Decrypt::r6Hash(Guchar *key, int keyLen, const char *pwd, int pwdLen,
 		     char *userKey) {
   Guchar key1[64*(127+64+48)];
@@ -337,6 +472,8 @@ DecryptStream::DecryptStream(Stream *strA, Guchar *fileKeyA,
   keyLength = keyLengthA;
   objNum = objNumA;
   objGen = objGenA;
+  abortCheckCounter = 0;
+  aborted = gFalse;
 
   // construct object key
   for (i = 0; i < keyLength; ++i) {
@@ -386,6 +523,8 @@ Stream *DecryptStream::copy() {
 
 void DecryptStream::reset() {
   str->reset();
+  abortCheckCounter = 0;
+  aborted = gFalse;
   switch (algo) {
   case cryptRC4:
     state.rc4.x = state.rc4.y = 0;
@@ -409,6 +548,17 @@ int DecryptStream::getChar() {
   Guchar in[16];
   int c;
 
+  // check for an abort
+  if (++abortCheckCounter > decryptAbortCheckSize) {
+    abortCheckCounter = 0;
+    if (checkForAbort()) {
+      aborted = gTrue;
+    }
+  }
+  if (aborted) {
+    return EOF;
+  }
+
   c = EOF; // make gcc happy
   switch (algo) {
   case cryptRC4:
@@ -456,6 +606,10 @@ int DecryptStream::lookChar() {
   Guchar in[16];
   int c;
 
+  if (aborted) {
+    return EOF;
+  }
+
   c = EOF; // make gcc happy
   switch (algo) {
   case cryptRC4:
@@ -498,6 +652,109 @@ int DecryptStream::lookChar() {
   return c;
 }
 
+int DecryptStream::getBlock(char *blk, int size) {
+  Guchar in[decryptBlockSize];
+  int n, m, i;
+
+  if (aborted) {
+    return 0;
+  }
+  if (algo != cryptRC4) {
+    n = getAESBlock(blk, size);
+  } else {
+    n = 0;
+    if (n < size && state.rc4.buf != EOF) {
+      blk[n++] = (char)state.rc4.buf;
+      state.rc4.buf = EOF;
+    }
+    while (n < size) {
+      m = size - n;
+      if (m > decryptBlockSize) {
+	m = decryptBlockSize;
+      }
+      if ((m = str->getBlock((char *)in, m)) <= 0) {
+	break;
+      }
+      for (i = 0; i < m; ++i) {
+	blk[n + i] = (char)rc4DecryptByte(state.rc4.state, &state.rc4.x,
+					  &state.rc4.y, in[i]);
+      }
+      n += m;
+    }
+  }
+
+  // check for an abort
+  abortCheckCounter += n;
+  if (abortCheckCounter > decryptAbortCheckSize) {
+    abortCheckCounter = 0;
+    if (checkForAbort()) {
+      aborted = gTrue;
+    }
+  }
+  return n;
+}
+
+// Decrypt AES or AES-256 data: leftover bytes of the current block,
+// then as many whole blocks as fit into <blk>, read from the input at
+// once.  A block which doesn't fit is decrypted into the state buffer.
+int DecryptStream::getAESBlock(char *blk, int size) {
+  Guchar in[decryptBlockSize];
+  Guchar *buf;
+  int *bufIdx;
+  int n, m, i, j;
+  GBool last;
+
+  if (algo == cryptAES) {
+    buf = state.aes.buf;
+    bufIdx = &state.aes.bufIdx;
+  } else {
+    buf = state.aes256.buf;
+    bufIdx = &state.aes256.bufIdx;
+  }
+  n = 0;
+  while (n < size) {
+    if (*bufIdx < 16) {
+      m = 16 - *bufIdx;
+      if (m > size - n) {
+	m = size - n;
+      }
+      memcpy(blk + n, buf + *bufIdx, m);
+      *bufIdx += m;
+      n += m;
+      continue;
+    }
+    m = ((size - n) / 16) * 16;
+    if (m > decryptBlockSize) {
+      m = decryptBlockSize;
+    } else if (m == 0) {
+      m = 16;
+    }
+    m = str->getBlock((char *)in, m);
+    m -= m % 16;
+    if (m == 0) {
+      break;
+    }
+    for (j = 0; j < m; j += 16) {
+      last = j + 16 == m && str->lookChar() == EOF;
+      if (algo == cryptAES) {
+	aesDecryptBlock(&state.aes, in + j, last);
+      } else {
+	aes256DecryptBlock(&state.aes256, in + j, last);
+      }
+      // the last block may be shorter than 16 bytes (padding)
+      i = 16 - *bufIdx;
+      if (i > size - n) {
+	// only for the final (partial) block, see m above
+	i = size - n;
+      }
+      memcpy(blk + n, buf + *bufIdx, i);
+      *bufIdx += i;
+      n += i;
+    }
+  }
+  return n;
+}
+
 GBool DecryptStream::isBinary(GBool last) {
   return str->isBinary(last);
 }
@@ -1242,6 +1499,14 @@ static inline Guint sha256sigma1(Guint x) {
   return rotr(x, 17) ^ rotr(x, 19) ^ (x >> 10);
 }
 
+// One round of the SHA-256 compression function: the new values of
+// <a> and <e> are stored in <h> and <d>.
+#define sha256Round(a, b, c, d, e, f, g, h, t)				\
+  T1 = h + sha256Sigma1(e) + sha256Ch(e, f, g) + sha256K[t] + W[t];	\
+  T2 = sha256Sigma0(a) + sha256Maj(a, b, c);				\
+  d += T1;								\
+  h = T1 + T2
+
 static void sha256HashBlock(Guchar *blk, Guint *H) {
   Guint W[64];
   Guint a, b, c, d, e, f, g, h;
@@ -1269,18 +1534,17 @@ static void sha256HashBlock(Guchar *blk, Guint *H) {
   g = H[6];
   h = H[7];
 
-  // 3.
-  for (t = 0; t < 64; ++t) {
-    T1 = h + sha256Sigma1(e) + sha256Ch(e,f,g) + sha256K[t] + W[t];
-    T2 = sha256Sigma0(a) + sha256Maj(a,b,c);
-    h = g;
-    g = f;
-    f = e;
-    e = d + T1;
-    d = c;
-    c = b;
-    b = a;
-    a = T1 + T2;
+  // 3. (unrolled by eight: instead of shifting the working variables,
+  //    rotate their roles in each round)
+  for (t = 0; t < 64; t += 8) {
+    sha256Round(a, b, c, d, e, f, g, h, t);
+    sha256Round(h, a, b, c, d, e, f, g, t + 1);
+    sha256Round(g, h, a, b, c, d, e, f, t + 2);
+    sha256Round(f, g, h, a, b, c, d, e, t + 3);
+    sha256Round(e, f, g, h, a, b, c, d, t + 4);
+    sha256Round(d, e, f, g, h, a, b, c, t + 5);
+    sha256Round(c, d, e, f, g, h, a, b, t + 6);
+    sha256Round(b, c, d, e, f, g, h, a, t + 7);
   }
 
   // 4. compute the intermediate hash value
@@ -1427,6 +1691,14 @@ static inline SHA512Uint64 sha512sigma1(SHA512Uint64 x) {
   return rotr64(x, 19) ^ rotr64(x, 61) ^ (x >> 6);
 }
 
+// One round of the SHA-512 compression function: the new values of
+// <a> and <e> are stored in <h> and <d>.
+#define sha512Round(a, b, c, d, e, f, g, h, t)				\
+  T1 = h + sha512Sigma1(e) + sha512Ch(e, f, g) + sha512K[t] + W[t];	\
+  T2 = sha512Sigma0(a) + sha512Maj(a, b, c);				\
+  d += T1;								\
+  h = T1 + T2
+
 static void sha512HashBlock(Guchar *blk, SHA512Uint64 *H) {
   SHA512Uint64 W[80];
   SHA512Uint64 a, b, c, d, e, f, g, h;
@@ -1458,18 +1730,17 @@ static void sha512HashBlock(Guchar *blk, SHA512Uint64 *H) {
   g = H[6];
   h = H[7];
 
-  // 3.
-  for (t = 0; t < 80; ++t) {
-    T1 = h + sha512Sigma1(e) + sha512Ch(e,f,g) + sha512K[t] + W[t];
-    T2 = sha512Sigma0(a) + sha512Maj(a,b,c);
-    h = g;
-    g = f;
-    f = e;
-    e = d + T1;
-    d = c;
-    c = b;
-    b = a;
-    a = T1 + T2;
+  // 3. (unrolled by eight: instead of shifting the working variables,
+  //    rotate their roles in each round)
+  for (t = 0; t < 80; t += 8) {
+    sha512Round(a, b, c, d, e, f, g, h, t);
+    sha512Round(h, a, b, c, d, e, f, g, t + 1);
+    sha512Round(g, h, a, b, c, d, e, f, t + 2);
+    sha512Round(f, g, h, a, b, c, d, e, t + 3);
+    sha512Round(e, f, g, h, a, b, c, d, t + 4);
+    sha512Round(d, e, f, g, h, a, b, c, t + 5);
+    sha512Round(c, d, e, f, g, h, a, b, t + 6);
+    sha512Round(b, c, d, e, f, g, h, a, t + 7);
   }
 
   // 4. compute the intermediate hash value
@@ -36,8 +36,16 @@ public:
 			   Guchar *fileKey, GBool encryptMetadata,
 			   GBool *ownerPasswordOk);
 
+  // Free the cache of revision 6 file keys (see makeFileKey).
+  static void clearFileKeyCache();
+
 private:
 
+  static GBool makeFileKey3(int encRevision,
+			    GString *ownerKey, GString *userKey,
+			    GString *ownerEnc, GString *userEnc,
+			    GString *ownerPassword, GString *userPassword,
+			    Guchar *fileKey, GBool *ownerPasswordOk);
   static void r6Hash(Guchar *key, int keyLen, const char *pwd, int pwdLen,
 		     char *userKey);
   static GBool makeFileKey2(int encVersion, int encRevision, int keyLength,
@@ -85,17 +93,22 @@ public:
   virtual void reset();
   virtual int getChar();
   virtual int lookChar();
+  virtual int getBlock(char *blk, int size);
   virtual GBool isBinary(GBool last);
   virtual Stream *getUndecodedStream() { return this; }
 
 private:
 
+  int getAESBlock(char *blk, int size);
+
   Guchar fileKey[32];
   CryptAlgorithm algo;
   int keyLength;
   int objNum, objGen;
   int objKeyLength;
   Guchar objKey[32];
+  int abortCheckCounter;	// bytes decrypted since last abort check
+  GBool aborted;		// set if decryption has been aborted
 
   union {
     DecryptRC4State rc4;
@@ -82,6 +82,11 @@
 // giving up on a content stream.
 #define contentStreamErrorLimit 500
 
+// Abort check interval.  The counter goes up by one for each object
+// parsed from the content stream (operands as well as operators);
+// shown text adds 10 per byte and images add up to 1000 per image.
+#define opAbortCheckInterval 20
+
 //------------------------------------------------------------------------
 // Operator table
 //------------------------------------------------------------------------
@@ -519,15 +524,22 @@ Gfx::Gfx(PDFDoc *docA, OutputDev *outA, int pageNum, Dict *resDict,
 	 void *abortCheckCbkDataA) 
   : doc(docA), xref(doc->getXRef()), out(outA), subPage(gFalse)
   , printCommands(globalParams->getPrintCommands())
-  , res(new GfxResources(xref, resDict, NULL)), defaultFont(NULL), opCounter(0)
+  , res(new GfxResources(xref, resDict, NULL)), defaultFont(NULL), opCounter(0), aborted(gFalse)
   , state(new GfxState(hDPI, vDPI, box, rotate, out->upsideDown()))
   , fontChanged(gFalse), haveSavedClipPath(gFalse), clip(clipNone), ignoreUndef(0)
   , formDepth(0), ocState(gTrue)
   , markedContentStack(new GList()), parser(NULL)
   , contentStreamStack(new GList())
   , abortCheckCbk(abortCheckCbkA), abortCheckCbkData(abortCheckCbkDataA)
+  , savedStreamAbortCheckCbk(NULL), savedStreamAbortCheckCbkData(NULL)
 {
   int i;
+  if (abortCheckCbk) {
+    // let the stream decoders check for an abort too
+    Stream::getAbortCheckCbk(&savedStreamAbortCheckCbk,
+			     &savedStreamAbortCheckCbkData);
+    Stream::setAbortCheckCbk(abortCheckCbk, abortCheckCbkData);
+  }
   out->startPage(pageNum, state);
   out->setDefaultCTM(state->getCTM());
   out->updateAll(state);
@@ -554,15 +566,22 @@ Gfx::Gfx(PDFDoc *docA, OutputDev *outA, Dict *resDict,
 	 void *abortCheckCbkDataA) 
     : doc(docA), xref(doc->getXRef()), out(outA), subPage(gTrue)
     , printCommands(globalParams->getPrintCommands())
-    , res(new GfxResources(xref, resDict, NULL)), defaultFont(NULL), opCounter(0)
+    , res(new GfxResources(xref, resDict, NULL)), defaultFont(NULL), opCounter(0), aborted(gFalse)
     , state(new GfxState(72, 72, box, 0, gFalse))
     , fontChanged(gFalse), haveSavedClipPath(gFalse), clip(clipNone), ignoreUndef(0)
     , formDepth(0), ocState(gTrue)
     , markedContentStack(new GList()), parser(NULL)
     , contentStreamStack(new GList())
     , abortCheckCbk(abortCheckCbkA), abortCheckCbkData(abortCheckCbkDataA)
+    , savedStreamAbortCheckCbk(NULL), savedStreamAbortCheckCbkData(NULL)
 {
   int i;
+  if (abortCheckCbk) {
+    // let the stream decoders check for an abort too
+    Stream::getAbortCheckCbk(&savedStreamAbortCheckCbk,
+			     &savedStreamAbortCheckCbkData);
+    Stream::setAbortCheckCbk(abortCheckCbk, abortCheckCbkData);
+  }
   for (i = 0; i < 6; ++i) {
     baseMatrix[i] = state->getCTM()[i];
   }
@@ -596,6 +615,10 @@ Gfx::~Gfx() {
   }
   deleteGList(markedContentStack, GfxMarkedContent);
   delete contentStreamStack;
+  if (abortCheckCbk) {
+    Stream::setAbortCheckCbk(savedStreamAbortCheckCbk,
+			     savedStreamAbortCheckCbkData);
+  }
 }
 
 void Gfx::display(Object *objRef, GBool topLevel) {
@@ -678,29 +701,51 @@ GBool Gfx::checkForContentStreamLoop(Object *ref) {
   return gFalse;
 }
 
+// Number of operators executed in the current thread.
+static thread_local unsigned long long opCount = 0;
+
+unsigned long long Gfx::getOpCount() {
+  return opCount;
+}
+
+// Calls the abort check callback.  Once it has requested an abort,
+// the result is remembered, so nested content streams (forms,
+// patterns, Type 3 glyphs) and the rest of the page are skipped
+// without calling it again.
+GBool Gfx::checkForAbort() {
+  if (!aborted && abortCheckCbk && (*abortCheckCbk)(abortCheckCbkData)) {
+    aborted = gTrue;
+  }
+  return aborted;
+}
+
 void Gfx::go(GBool topLevel) {
   Object obj;
   Object args[maxArgs];
-  GBool aborted;
   int numArgs, i;
   int errCount;
 
-  // scan a sequence of objects
-  opCounter = 0;
-  aborted = gFalse;
+  // scan a sequence of objects -- the operation counter is not reset
+  // for nested content streams, otherwise a page built from many
+  // small forms would never reach the abort check
+  if (topLevel) {
+    opCounter = 0;
+  }
   errCount = 0;
   numArgs = 0;
+  if (aborted) {
+    return;
+  }
   getContentObj(&obj);
   while (!obj.isEOF()) {
 
     // check for an abort
     ++opCounter;
-    if (abortCheckCbk && opCounter > 100) {
-      if ((*abortCheckCbk)(abortCheckCbkData)) {
-	aborted = gTrue;
+    if (abortCheckCbk && opCounter > opAbortCheckInterval) {
+      opCounter = 0;
+      if (checkForAbort()) {
 	break;
       }
-      opCounter = 0;
     }
 
     // got a command - execute it
@@ -714,6 +759,7 @@ void Gfx::go(GBool topLevel) {
 	printf("\n");
 	fflush(stdout);
       }
+      ++opCount;
       if (!execOp(&obj, args, numArgs)) {
 	++errCount;
       }
@@ -2222,7 +2268,7 @@ void Gfx::doTilingPatternFill(GfxTilingPattern *tPat,
 	if (abortCheckCbk) {
 	  ++abortCheckCounter;
 	  if (abortCheckCounter > 100) {
-	    if ((*abortCheckCbk)(abortCheckCbkData)) {
+	    if (checkForAbort()) {
 	      goto err;
 	    }
 	    abortCheckCounter = 0;
@@ -2726,7 +2772,7 @@ void Gfx::doAxialShFill(GfxAxialShading *shading) {
     if (abortCheckCbk) {
       ++abortCheckCounter;
       if (abortCheckCounter > 100) {
-        if ((*abortCheckCbk)(abortCheckCbkData)) {
+        if (checkForAbort()) {
           break;
         }
         abortCheckCounter = 0;
@@ -3047,7 +3093,7 @@ void Gfx::doRadialShFill(GfxRadialShading *shading) {
     if (abortCheckCbk) {
       ++abortCheckCounter;
       if (abortCheckCounter > 100) {
-	if ((*abortCheckCbk)(abortCheckCbkData)) {
+	if (checkForAbort()) {
 	  break;
 	}
 	abortCheckCounter = 0;
@@ -3246,7 +3292,7 @@ void Gfx::doGouraudTriangleShFill(GfxGouraudTriangleShading *shading) {
     if (abortCheckCbk) {
       ++abortCheckCounter;
       if (abortCheckCounter > 25) {
-	if ((*abortCheckCbk)(abortCheckCbkData)) {
+	if (checkForAbort()) {
 	  break;
 	}
 	abortCheckCounter = 0;
@@ -3343,7 +3389,7 @@ void Gfx::doPatchMeshShFill(GfxPatchMeshShading *shading) {
     if (abortCheckCbk) {
       ++abortCheckCounter;
       if (abortCheckCounter > 25) {
-	if ((*abortCheckCbk)(abortCheckCbkData)) {
+	if (checkForAbort()) {
 	  break;
 	}
 	abortCheckCounter = 0;
@@ -151,6 +151,9 @@ public:
   // reference wherever possible (for loop-checking).
   void display(Object *objRef, GBool topLevel = gTrue);
 
+  // Get the number of operators executed in the current thread.
+  static unsigned long long getOpCount();
+
   // Display an annotation, given its appearance (a Form XObject),
   // border style, and bounding box (in default user space).
   void drawAnnot(Object *strRef, AnnotBorderStyle *borderStyle,
@@ -193,6 +196,8 @@ private:
   GfxFont *defaultFont;		// font substituted for undefined fonts
   int opCounter;		// operation counter (used to decide when
 				//   to check for an abort)
+  GBool aborted;		// set when abortCheckCbk has requested
+				//   an abort
 
   GfxState *state;		// current graphics state
   GBool fontChanged;		// set if font or text matrix has changed
@@ -213,10 +218,14 @@ private:
   GBool				// callback to check for an abort
     (*abortCheckCbk)(void *data);
   void *abortCheckCbkData;
+  GBool				// stream abort check callback which
+    (*savedStreamAbortCheckCbk)(void *data); // was active before
+  void *savedStreamAbortCheckCbkData;	//   this Gfx was created
 
   static Operator opTab[];	// table of operators
 
   GBool checkForContentStreamLoop(Object *ref);
+  GBool checkForAbort();
   void go(GBool topLevel);
   void getContentObj(Object *obj);
   GBool execOp(Object *cmd, Object args[], int numArgs);
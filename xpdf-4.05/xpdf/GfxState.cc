@@ -27,6 +27,15 @@
 // loops in the color space object structure.
 #define colorSpaceRecursionLimit 8
 
+// GfxState::shared flags: components of a saved state which are
+// borrowed from the state below it on the stack.
+#define gfxStateSharedFillColorSpace   0x01
+#define gfxStateSharedStrokeColorSpace 0x02
+#define gfxStateSharedFillPattern      0x04
+#define gfxStateSharedStrokePattern    0x08
+#define gfxStateSharedTransfer         0x10
+#define gfxStateSharedLineDash         0x20
+
 
 //------------------------------------------------------------------------
 
@@ -4588,29 +4597,34 @@ GfxState::GfxState(double hDPIA, double vDPIA, PDFRectangle *pageBox,
   ignoreColorOps = gFalse;
 
   saved = NULL;
+  shared = 0;
 }
 
 GfxState::~GfxState() {
   int i;
 
-  if (fillColorSpace) {
+  if (fillColorSpace && !(shared & gfxStateSharedFillColorSpace)) {
     delete fillColorSpace;
   }
-  if (strokeColorSpace) {
+  if (strokeColorSpace && !(shared & gfxStateSharedStrokeColorSpace)) {
     delete strokeColorSpace;
   }
-  if (fillPattern) {
+  if (fillPattern && !(shared & gfxStateSharedFillPattern)) {
     delete fillPattern;
   }
-  if (strokePattern) {
+  if (strokePattern && !(shared & gfxStateSharedStrokePattern)) {
     delete strokePattern;
   }
-  for (i = 0; i < 4; ++i) {
-    if (transfer[i]) {
-      delete transfer[i];
+  if (!(shared & gfxStateSharedTransfer)) {
+    for (i = 0; i < 4; ++i) {
+      if (transfer[i]) {
+	delete transfer[i];
+      }
     }
   }
-  gfree(lineDash);
+  if (!(shared & gfxStateSharedLineDash)) {
+    gfree(lineDash);
+  }
   if (path) {
     // this gets set to NULL by restore()
     delete path;
@@ -4647,6 +4661,19 @@ GfxState::GfxState(GfxState *state, GBool copyPath) {
     path = state->path->copy();
   }
   saved = NULL;
+  shared = 0;
+}
+
+// Used for save(): the color spaces, patterns, transfer functions, and
+// line dash array are borrowed from <state> (which stays below this
+// state on the stack, and can't change until this state is restored),
+// and are only copied when this state replaces them.
+GfxState::GfxState(GfxState *state) {
+  memcpy(this, state, sizeof(GfxState));
+  saved = NULL;
+  shared = gfxStateSharedFillColorSpace | gfxStateSharedStrokeColorSpace |
+           gfxStateSharedFillPattern | gfxStateSharedStrokePattern |
+           gfxStateSharedTransfer | gfxStateSharedLineDash;
 }
 
 void GfxState::setPath(GfxPath *pathA) {
@@ -4797,47 +4824,53 @@ void GfxState::shiftCTM(double tx, double ty) {
 }
 
 void GfxState::setFillColorSpace(GfxColorSpace *colorSpace) {
-  if (fillColorSpace) {
+  if (fillColorSpace && !(shared & gfxStateSharedFillColorSpace)) {
     delete fillColorSpace;
   }
   fillColorSpace = colorSpace;
+  shared &= ~gfxStateSharedFillColorSpace;
 }
 
 void GfxState::setStrokeColorSpace(GfxColorSpace *colorSpace) {
-  if (strokeColorSpace) {
+  if (strokeColorSpace && !(shared & gfxStateSharedStrokeColorSpace)) {
     delete strokeColorSpace;
   }
   strokeColorSpace = colorSpace;
+  shared &= ~gfxStateSharedStrokeColorSpace;
 }
 
 void GfxState::setFillPattern(GfxPattern *pattern) {
-  if (fillPattern) {
+  if (fillPattern && !(shared & gfxStateSharedFillPattern)) {
     delete fillPattern;
   }
   fillPattern = pattern;
+  shared &= ~gfxStateSharedFillPattern;
 }
 
 void GfxState::setStrokePattern(GfxPattern *pattern) {
-  if (strokePattern) {
+  if (strokePattern && !(shared & gfxStateSharedStrokePattern)) {
     delete strokePattern;
   }
   strokePattern = pattern;
+  shared &= ~gfxStateSharedStrokePattern;
 }
 
 void GfxState::setTransfer(Function **funcs) {
   int i;
 
   for (i = 0; i < 4; ++i) {
-    if (transfer[i]) {
+    if (transfer[i] && !(shared & gfxStateSharedTransfer)) {
       delete transfer[i];
     }
     transfer[i] = funcs[i];
   }
+  shared &= ~gfxStateSharedTransfer;
 }
 
 void GfxState::setLineDash(double *dash, int length, double start) {
-  if (lineDash)
+  if (lineDash && !(shared & gfxStateSharedLineDash))
     gfree(lineDash);
+  shared &= ~gfxStateSharedLineDash;
   lineDash = dash;
   lineDashLength = length;
   lineDashStart = start;
@@ -5106,7 +5139,7 @@ void GfxState::shift(double dx, double dy) {
 GfxState *GfxState::save() {
   GfxState *newState;
 
-  newState = copy();
+  newState = new GfxState(this);
   newState->saved = this;
   return newState;
 }
@@ -1370,8 +1370,12 @@ private:
 				//   patterns)
 
   GfxState *saved;		// next GfxState on stack
+  int shared;			// components borrowed from the saved
+				//   state, not owned by this state
+				//   (gfxStateShared* flags)
 
   GfxState(GfxState *state, GBool copyPath);
+  GfxState(GfxState *state);
 };
 
 #endif
@@ -751,6 +751,7 @@ GlobalParams::GlobalParams(const char *cfgFileName) {
   drawAnnotations = gTrue;
   drawFormFields = gTrue;
   enableXFA = gTrue;
+  enableOptionalContent = gTrue;
   overprintPreview = gFalse;
   paperColor = new GString("#ffffff");
   matteColor = new GString("#808080");
@@ -1263,6 +1264,9 @@ void GlobalParams::parseLine(char *buf, GString *fileName, int line) {
     } else if (!cmd->cmp("enableXFA")) {
       parseYesNo("enableXFA", &enableXFA,
 		 tokens, fileName, line);
+    } else if (!cmd->cmp("enableOptionalContent")) {
+      parseYesNo("enableOptionalContent", &enableOptionalContent,
+		 tokens, fileName, line);
     } else if (!cmd->cmp("overprintPreview")) {
       parseYesNo("overprintPreview", &overprintPreview,
 		 tokens, fileName, line);
@@ -3311,6 +3315,15 @@ GBool GlobalParams::getEnableXFA() {
   return xfa;
 }
 
+GBool GlobalParams::getEnableOptionalContent() {
+  GBool enable;
+
+  lockGlobalParams;
+  enable = enableOptionalContent;
+  unlockGlobalParams;
+  return enable;
+}
+
 
 
 GString *GlobalParams::getPaperColor() {
@@ -3944,12 +3957,24 @@ void GlobalParams::setScreenWhiteThreshold(double thresh) {
   unlockGlobalParams;
 }
 
+void GlobalParams::setDrawAnnotations(GBool draw) {
+  lockGlobalParams;
+  drawAnnotations = draw;
+  unlockGlobalParams;
+}
+
 void GlobalParams::setDrawFormFields(GBool draw) {
   lockGlobalParams;
   drawFormFields = draw;
   unlockGlobalParams;
 }
 
+void GlobalParams::setEnableOptionalContent(GBool enable) {
+  lockGlobalParams;
+  enableOptionalContent = enable;
+  unlockGlobalParams;
+}
+
 void GlobalParams::setOverprintPreview(GBool preview) {
   lockGlobalParams;
   overprintPreview = preview;
@@ -329,6 +329,7 @@ public:
   GBool getDrawAnnotations();
   GBool getDrawFormFields();
   GBool getEnableXFA();
+  GBool getEnableOptionalContent();
   GBool getOverprintPreview() { return overprintPreview; }
   GString *getPaperColor();
   GString *getMatteColor();
@@ -405,7 +406,9 @@ public:
   void setScreenGamma(double gamma);
   void setScreenBlackThreshold(double thresh);
   void setScreenWhiteThreshold(double thresh);
+  void setDrawAnnotations(GBool draw);
   void setDrawFormFields(GBool draw);
+  void setEnableOptionalContent(GBool enable);
   void setOverprintPreview(GBool preview);
   void setMapNumericCharNames(GBool map);
   void setMapUnknownCharNames(GBool map);
@@ -592,6 +595,8 @@ private:
   GBool drawAnnotations;	// draw annotations or not
   GBool drawFormFields;		// draw form fields or not
   GBool enableXFA;		// enable XFA form parsing
+  GBool enableOptionalContent;	// read optional content (layers), if
+				//   disabled, all content is shown
   GBool overprintPreview;	// enable overprint preview
   GString *paperColor;		// paper (page background) color
   GString *matteColor;		// matte (background outside of page) color
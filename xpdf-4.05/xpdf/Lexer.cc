@@ -39,6 +39,40 @@ static char specialChars[256] = {
   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0    // fx
 };
 
+//------------------------------------------------------------------------
+// LexerStream
+//------------------------------------------------------------------------
+
+// The current stream of a lexer with buffered input: data buffered by
+// the lexer is read first, so inline image data can be read directly
+// from the content stream (see Gfx::buildImageStream).
+class LexerStream: public Stream {
+public:
+
+  LexerStream(Lexer *lexerA): lexer(lexerA) {}
+  virtual Stream *copy() { return str()->copy(); }
+  virtual StreamKind getKind() { return str()->getKind(); }
+  virtual void reset() {}
+  virtual int getChar() { return lexer->strGetChar(); }
+  virtual int lookChar() { return lexer->strLookChar(); }
+  virtual int getBlock(char *blk, int size)
+    { return lexer->strGetBlock(blk, size); }
+  virtual GFileOffset getPos() { return lexer->getPos(); }
+  virtual void setPos(GFileOffset pos, int dir = 0)
+    { lexer->setPos(pos, dir); }
+  virtual GBool isBinary(GBool last = gTrue) { return str()->isBinary(last); }
+  virtual BaseStream *getBaseStream() { return str()->getBaseStream(); }
+  virtual Stream *getUndecodedStream()
+    { return str()->getUndecodedStream(); }
+  virtual Dict *getDict() { return str()->getDict(); }
+
+private:
+
+  Stream *str() { return lexer->curStr.getStream(); }
+
+  Lexer *lexer;
+};
+
 //------------------------------------------------------------------------
 // Lexer
 //------------------------------------------------------------------------
@@ -54,6 +88,8 @@ Lexer::Lexer(XRef *xref, Stream *str)
 Lexer::Lexer(XRef *xref, Object *obj) {
   Object obj2;
 
+  inBuf = inBufPtr = inBufEnd = (char *)gmalloc(lexerBufSize);
+  bufStr = new LexerStream(this);
   if (obj->isStream()) {
     streams = new Array(xref);
     streams->add(obj->copy(&obj2));
@@ -75,13 +111,18 @@ Lexer::~Lexer() {
   if (freeArray) {
     delete streams;
   }
+  delete bufStr;
+  gfree(inBuf);
 }
 
 int Lexer::getChar() {
   int c;
 
+  if (inBufPtr < inBufEnd) {
+    return *inBufPtr++ & 0xff;
+  }
   c = EOF;
-  while (!curStr.isNone() && (c = curStr.streamGetChar()) == EOF) {
+  while (!curStr.isNone() && (c = strGetChar()) == EOF) {
     curStr.streamClose();
     curStr.free();
     ++strPtr;
@@ -94,10 +135,92 @@ int Lexer::getChar() {
 }
 
 int Lexer::lookChar() {
+  if (inBufPtr < inBufEnd) {
+    return *inBufPtr & 0xff;
+  }
   if (curStr.isNone()) {
     return EOF;
   }
-  return curStr.streamLookChar();
+  return strLookChar();
+}
+
+// Get the next char of the current stream (through the input buffer,
+// if there is one).
+int Lexer::strGetChar() {
+  if (!inBuf) {
+    return curStr.streamGetChar();
+  }
+  if (inBufPtr >= inBufEnd && !fillBuf()) {
+    return EOF;
+  }
+  return *inBufPtr++ & 0xff;
+}
+
+int Lexer::strLookChar() {
+  if (!inBuf) {
+    return curStr.streamLookChar();
+  }
+  if (inBufPtr >= inBufEnd && !fillBuf()) {
+    return EOF;
+  }
+  return *inBufPtr & 0xff;
+}
+
+int Lexer::strGetBlock(char *blk, int size) {
+  int n;
+
+  if (curStr.isNone()) {
+    return 0;
+  }
+  n = 0;
+  if (inBuf) {
+    n = (int)(inBufEnd - inBufPtr);
+    if (n > size) {
+      n = size;
+    }
+    memcpy(blk, inBufPtr, n);
+    inBufPtr += n;
+  }
+  if (n < size) {
+    n += curStr.getStream()->getBlock(blk + n, size - n);
+  }
+  return n;
+}
+
+GBool Lexer::fillBuf() {
+  int n;
+
+  inBufPtr = inBufEnd = inBuf;
+  if (curStr.isNone()) {
+    return gFalse;
+  }
+  n = curStr.getStream()->getBlock(inBuf, lexerBufSize);
+  if (n <= 0) {
+    return gFalse;
+  }
+  inBufEnd = inBuf + n;
+  return gTrue;
+}
+
+Stream *Lexer::getStream() {
+  if (curStr.isNone()) {
+    return NULL;
+  }
+  return inBuf ? (Stream *)bufStr : curStr.getStream();
+}
+
+GFileOffset Lexer::getPos() {
+  if (curStr.isNone()) {
+    return -1;
+  }
+  return curStr.streamGetPos() - (GFileOffset)(inBufEnd - inBufPtr);
+}
+
+void Lexer::setPos(GFileOffset pos, int dir) {
+  if (!curStr.isNone()) {
+    inBufPtr = inBufEnd = inBuf;
+    curStr.streamSetPos(pos, dir);
+  }
 }
 
 Object *Lexer::getObj(Object *obj) {
@@ -15,8 +15,10 @@
 #include "Stream.h"
 
 class XRef;
+class LexerStream;
 
 #define tokBufSize 128		// size of token buffer
+#define lexerBufSize 4096	// size of input buffer (content streams)
 
 //------------------------------------------------------------------------
 // Lexer
@@ -30,7 +32,8 @@ public:
   Lexer(XRef *xref, Stream *str);
 
   // Construct a lexer for a stream or array of streams (assumes obj
-  // is either a stream or array of streams).
+  // is either a stream or array of streams).  This is used for
+  // content streams, which are read in blocks of lexerBufSize bytes.
   Lexer(XRef *xref, Object *obj);
   Lexer(const Lexer&) = delete;
   Lexer& operator=(const Lexer&) = delete;
@@ -52,17 +55,15 @@ public:
   // Get stream index (for arrays of streams).
   int getStreamIndex() { return strPtr; }
 
-  // Get stream.
-  Stream *getStream()
-    { return curStr.isNone() ? (Stream *)NULL : curStr.getStream(); }
+  // Get stream.  For content streams, this is a stream which reads
+  // the data buffered by the lexer first (used for inline images).
+  Stream *getStream();
 
   // Get current position in file.
-  GFileOffset getPos()
-    { return curStr.isNone() ? -1 : curStr.streamGetPos(); }
+  GFileOffset getPos();
 
   // Set position in file.
-  void setPos(GFileOffset pos, int dir = 0)
-    { if (!curStr.isNone()) curStr.streamSetPos(pos, dir); }
+  void setPos(GFileOffset pos, int dir = 0);
 
   // Returns true if <c> is a whitespace character.
   static GBool isSpace(int c);
@@ -71,12 +72,24 @@ private:
 
   int getChar();
   int lookChar();
+  int strGetChar();
+  int strLookChar();
+  int strGetBlock(char *blk, int size);
+  GBool fillBuf();
 
   Array* streams{ nullptr };		// array of input streams
   int strPtr{ 0 };			// index of current stream
   Object curStr;		// current stream
   GBool freeArray{ gTrue };		// should lexer free the streams array?
   char tokBuf[tokBufSize]{ };	// temporary token buffer
+  char *inBuf{ nullptr };		// input buffer of the current stream
+					//   (NULL if not buffered)
+  char *inBufPtr{ nullptr };		// next char in input buffer
+  char *inBufEnd{ nullptr };		// end of data in input buffer
+  LexerStream *bufStr{ nullptr };	// stream returned by getStream()
+					//   if the input is buffered
+
+  friend class LexerStream;
 };
 
 #endif
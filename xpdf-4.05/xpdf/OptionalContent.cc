@@ -8,6 +8,7 @@
 
 #include <aconf.h>
 
+#include <string.h>
 #include "gmempp.h"
 #include "GString.h"
 #include "GList.h"
@@ -34,6 +35,15 @@
 // loops in the "Order" object structure.
 #define displayNodeRecursionLimit 50
 
+// Initial sizes of the OCG index and the OCMD cache (must be powers
+// of 2).
+#define ocgIndexInitialSize 64
+#define ocmdCacheInitialSize 64
+
+static inline Guint hashRef(Ref *ref) {
+  return (Guint)ref->num * 31 + (Guint)ref->gen;
+}
+
 //------------------------------------------------------------------------
 
 OptionalContent::OptionalContent(PDFDoc *doc) {
@@ -45,6 +55,11 @@ OptionalContent::OptionalContent(PDFDoc *doc) {
 
   xref = doc->getXRef();
   ocgs = new GList();
+  ocgIndex = NULL;
+  ocgIndexSize = 0;
+  ocmdCache = NULL;
+  ocmdCacheSize = 0;
+  ocmdCacheLen = 0;
   display = NULL;
 
   if ((ocProps = doc->getCatalog()->getOCProperties())->isDict()) {
@@ -56,7 +71,7 @@ OptionalContent::OptionalContent(PDFDoc *doc) {
 	  ref1 = obj1.getRef();
 	  obj1.fetch(xref, &obj2);
 	  if ((ocg = OptionalContentGroup::parse(&ref1, &obj2))) {
-	    ocgs->append(ocg);
+	    addOCG(ocg);
 	  }
 	  obj2.free();
 	}
@@ -139,9 +154,97 @@ OptionalContent::OptionalContent(PDFDoc *doc) {
 
 OptionalContent::~OptionalContent() {
   deleteGList(ocgs, OptionalContentGroup);
+  gfree(ocgIndex);
+  gfree(ocmdCache);
   delete display;
 }
 
+// Append an OCG to the list, and add it to the index unless there is
+// already an OCG with the same reference (findOCG returns the first
+// one).  The index is kept at most half full.
+void OptionalContent::addOCG(OptionalContentGroup *ocg) {
+  OptionalContentGroup **oldIndex;
+  OptionalContentGroup *ocg2;
+  int oldSize, i;
+  Guint h;
+
+  ocg->oc = this;
+  ocgs->append(ocg);
+  if (findOCG(&ocg->ref)) {
+    return;
+  }
+  if (2 * (ocgs->getLength() + 1) > ocgIndexSize) {
+    oldIndex = ocgIndex;
+    oldSize = ocgIndexSize;
+    ocgIndexSize = oldSize ? 2 * oldSize : ocgIndexInitialSize;
+    ocgIndex = (OptionalContentGroup **)
+                   gmallocn(ocgIndexSize, sizeof(OptionalContentGroup *));
+    memset(ocgIndex, 0, ocgIndexSize * sizeof(OptionalContentGroup *));
+    for (i = 0; i < oldSize; ++i) {
+      if ((ocg2 = oldIndex[i])) {
+	h = hashRef(&ocg2->ref) & (ocgIndexSize - 1);
+	while (ocgIndex[h]) {
+	  h = (h + 1) & (ocgIndexSize - 1);
+	}
+	ocgIndex[h] = ocg2;
+      }
+    }
+    gfree(oldIndex);
+  }
+  h = hashRef(&ocg->ref) & (ocgIndexSize - 1);
+  while (ocgIndex[h]) {
+    h = (h + 1) & (ocgIndexSize - 1);
+  }
+  ocgIndex[h] = ocg;
+}
+
+// Called by OptionalContentGroup::setState -- OCMD results depend on
+// OCG states, so they are dropped.
+void OptionalContent::ocgStateChanged() {
+  int i;
+
+  for (i = 0; i < ocmdCacheSize; ++i) {
+    ocmdCache[i].ref.num = -1;
+  }
+  ocmdCacheLen = 0;
+}
+
+// Returns the cache entry for <ref>, or the free entry where it
+// should be added.  The cache is kept at most half full.
+OCMDCacheEntry *OptionalContent::findOCMDCacheEntry(Ref *ref) {
+  OCMDCacheEntry *oldCache;
+  int oldSize, i;
+  Guint h;
+
+  if (2 * (ocmdCacheLen + 1) > ocmdCacheSize) {
+    oldCache = ocmdCache;
+    oldSize = ocmdCacheSize;
+    ocmdCacheSize = oldSize ? 2 * oldSize : ocmdCacheInitialSize;
+    ocmdCache = (OCMDCacheEntry *)gmallocn(ocmdCacheSize,
+					   sizeof(OCMDCacheEntry));
+    for (i = 0; i < ocmdCacheSize; ++i) {
+      ocmdCache[i].ref.num = -1;
+    }
+    for (i = 0; i < oldSize; ++i) {
+      if (oldCache[i].ref.num >= 0) {
+	h = hashRef(&oldCache[i].ref) & (ocmdCacheSize - 1);
+	while (ocmdCache[h].ref.num >= 0) {
+	  h = (h + 1) & (ocmdCacheSize - 1);
+	}
+	ocmdCache[h] = oldCache[i];
+      }
+    }
+    gfree(oldCache);
+  }
+  h = hashRef(ref) & (ocmdCacheSize - 1);
+  while (ocmdCache[h].ref.num >= 0 &&
+	 !(ocmdCache[h].ref.num == ref->num &&
+	   ocmdCache[h].ref.gen == ref->gen)) {
+    h = (h + 1) & (ocmdCacheSize - 1);
+  }
+  return &ocmdCache[h];
+}
+
 int OptionalContent::getNumOCGs() {
   return ocgs->getLength();
 }
@@ -152,35 +255,58 @@ OptionalContentGroup *OptionalContent::getOCG(int idx) {
 
 OptionalContentGroup *OptionalContent::findOCG(Ref *ref) {
   OptionalContentGroup *ocg;
-  int i;
+  Guint h;
 
-  for (i = 0; i < ocgs->getLength(); ++i) {
-    ocg = (OptionalContentGroup *)ocgs->get(i);
+  if (!ocgIndexSize) {
+    return NULL;
+  }
+  h = hashRef(ref) & (ocgIndexSize - 1);
+  while ((ocg = ocgIndex[h])) {
     if (ocg->matches(ref)) {
       return ocg;
     }
+    h = (h + 1) & (ocgIndexSize - 1);
   }
   return NULL;
 }
 
 GBool OptionalContent::evalOCObject(Object *obj, GBool *visible) {
   OptionalContentGroup *ocg;
-  int policy;
+  OCMDCacheEntry *entry;
   Ref ref;
-  Object obj2, obj3, obj4, obj5;
-  GBool gotOCG;
-  int i;
 
   if (obj->isNull()) {
     return gFalse;
   }
-  if (obj->isRef()) {
-    ref = obj->getRef();
-    if ((ocg = findOCG(&ref))) {
-      *visible = ocg->getState();
-      return gTrue;
-    }
+  if (!obj->isRef()) {
+    return evalOCMD(obj, visible);
+  }
+  ref = obj->getRef();
+  if ((ocg = findOCG(&ref))) {
+    *visible = ocg->getState();
+    return gTrue;
+  }
+  entry = findOCMDCacheEntry(&ref);
+  if (entry->ref.num < 0) {
+    entry->visible = gTrue;
+    entry->ok = evalOCMD(obj, &entry->visible);
+    entry->ref = ref;
+    ++ocmdCacheLen;
+  }
+  if (entry->ok) {
+    *visible = entry->visible;
   }
+  return entry->ok;
+}
+
+GBool OptionalContent::evalOCMD(Object *obj, GBool *visible) {
+  OptionalContentGroup *ocg;
+  int policy;
+  Ref ref;
+  Object obj2, obj3, obj4, obj5;
+  GBool gotOCG;
+  int i;
+
   obj->fetch(xref, &obj2);
   if (!obj2.isDict("OCMD")) {
     obj2.free();
@@ -375,7 +501,7 @@ OptionalContentGroup::OptionalContentGroup(Ref *refA, TextString *nameA,
 					   OCUsageState viewStateA,
 					   OCUsageState printStateA) 
   : ref(*refA), name(nameA), viewState(viewStateA), printState(printStateA)
-  , state(gTrue), inViewUsageAppDict(gFalse)
+  , state(gTrue), inViewUsageAppDict(gFalse), oc(NULL)
 {
 }
 
@@ -387,6 +513,15 @@ GBool OptionalContentGroup::matches(Ref *refA) {
   return refA->num == ref.num && refA->gen == ref.gen;
 }
 
+void OptionalContentGroup::setState(GBool stateA) {
+  if (stateA != state) {
+    state = stateA;
+    if (oc) {
+      oc->ocgStateChanged();
+    }
+  }
+}
+
 Unicode *OptionalContentGroup::getName() {
   return name->getUnicode();
 }
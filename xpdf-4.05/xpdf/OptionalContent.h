@@ -25,6 +25,15 @@ class OCDisplayNode;
 
 //------------------------------------------------------------------------
 
+// Cached result of evalOCObject for an indirect OCMD.
+struct OCMDCacheEntry {
+  Ref ref;			// OCMD reference (num < 0 for free slots)
+  GBool ok;			// return value of evalOCObject
+  GBool visible;		// visibility, if ok is true
+};
+
+//------------------------------------------------------------------------
+
 class OptionalContent {
 public:
 
@@ -47,15 +56,29 @@ public:
   // Evaluate an optional content object -- either an OCG or an OCMD.
   // If <obj> is a valid OCG or OCMD, sets *<visible> and returns
   // true; otherwise returns false.
+  // Results for indirect OCMDs are cached until the state of an
+  // OCG changes.
   GBool evalOCObject(Object *obj, GBool *visible);
 
 private:
 
+  void addOCG(OptionalContentGroup *ocg);
+  void ocgStateChanged();
+  OCMDCacheEntry *findOCMDCacheEntry(Ref *ref);
+  GBool evalOCMD(Object *obj, GBool *visible);
   GBool evalOCVisibilityExpr(Object *expr, int recursion);
 
   XRef *xref;
   GList *ocgs;			// all OCGs [OptionalContentGroup]
+  OptionalContentGroup **ocgIndex;	// hash table of OCGs, indexed by
+				//   reference (NULL for free slots)
+  int ocgIndexSize;		// size of ocgIndex (a power of 2)
+  OCMDCacheEntry *ocmdCache;	// hash table of OCMD results
+  int ocmdCacheSize;		// size of ocmdCache (a power of 2)
+  int ocmdCacheLen;		// number of used entries in ocmdCache
   OCDisplayNode *display;	// root node of display tree 
+
+  friend class OptionalContentGroup;
 };
 
 //------------------------------------------------------------------------
@@ -82,7 +105,7 @@ public:
   OCUsageState getViewState() { return viewState; }
   OCUsageState getPrintState() { return printState; }
   GBool getState() { return state; }
-  void setState(GBool stateA) { state = stateA; }
+  void setState(GBool stateA);
   GBool getInViewUsageAppDict() { return inViewUsageAppDict; }
   void setInViewUsageAppDict() { inViewUsageAppDict = gTrue; }
 
@@ -98,7 +121,9 @@ private:
   GBool state;			// current state (on/off)
   GBool inViewUsageAppDict;	// true if this OCG is listed in a
 				//   usage app dict with Event=View
+  OptionalContent *oc;		// owner, notified of state changes
 
+  friend class OptionalContent;
   friend class OCDisplayNode;
 };
 
@@ -59,7 +59,7 @@
 //------------------------------------------------------------------------
 
 PDFDoc::PDFDoc(GString *fileNameA, GString *ownerPassword,
-	       GString *userPassword, PDFCore *coreA) 
+	       GString *userPassword, PDFCore *coreA, GBool firstPageOnly) 
     : fileName{ fileNameA }
     , core{ coreA }
 
@@ -104,12 +104,12 @@ PDFDoc::PDFDoc(GString *fileNameA, GString *ownerPassword,
   obj.initNull();
   str = new FileStream(file, 0, gFalse, 0, &obj);
 
-  ok = setup(ownerPassword, userPassword);
+  ok = setup(ownerPassword, userPassword, firstPageOnly);
 }
 
 #ifdef _WIN32
 PDFDoc::PDFDoc(const wchar_t *fileNameA, size_t fileNameLen, GString *ownerPassword,
-	       GString *userPassword, PDFCore *coreA) 
+	       GString *userPassword, PDFCore *coreA, GBool firstPageOnly) 
     : fileName{ new GString() }
     , core{ coreA }
 {
@@ -147,7 +147,7 @@ PDFDoc::PDFDoc(const wchar_t *fileNameA, size_t fileNameLen, GString *ownerPassw
   obj.initNull();
   str = new FileStream(file, 0, gFalse, 0, &obj);
 
-  ok = setup(ownerPassword, userPassword);
+  ok = setup(ownerPassword, userPassword, firstPageOnly);
 }
 #endif
 
@@ -216,13 +216,24 @@ PDFDoc::PDFDoc(BaseStream *strA, GString *ownerPassword,
   ok = setup(ownerPassword, userPassword);
 }
 
-GBool PDFDoc::setup(GString *ownerPassword, GString *userPassword) {
+GBool PDFDoc::setup(GString *ownerPassword, GString *userPassword,
+		    GBool firstPageOnly) {
 
   str->reset();
 
   // check header
   checkHeader();
 
+  // open the first page of a linearized file -- the xref isn't
+  // repaired, the caller opens the file normally if this fails
+  if (firstPageOnly) {
+    if (!readLinearization()) {
+      errCode = errDamaged;
+      return gFalse;
+    }
+    return PDFDoc::setup2(ownerPassword, userPassword, gFalse);
+  }
+
   // read the xref and catalog
   if (!PDFDoc::setup2(ownerPassword, userPassword, gFalse)) {
     if (errCode == errDamaged || errCode == errBadCatalog) {
@@ -251,7 +262,7 @@ GBool PDFDoc::setup(GString *ownerPassword, GString *userPassword) {
 GBool PDFDoc::setup2(GString *ownerPassword, GString *userPassword,
 		     GBool repairXRef) {
   // read xref table
-  xref = new XRef(str, repairXRef);
+  xref = new XRef(str, repairXRef, isFirstPageOnly());
   if (!xref->isOk()) {
     error(errSyntaxError, -1, "Couldn't read xref table");
     errCode = xref->getErrorCode();
@@ -317,6 +328,13 @@ PDFDoc::~PDFDoc() {
 #endif
 }
 
+void PDFDoc::closeFile() {
+  if (file) {
+    fclose(file);
+    file = NULL;
+  }
+}
+
 // Check for a PDF header on this stream.  Skip past some garbage
 // if necessary.
 void PDFDoc::checkHeader() {
@@ -512,6 +530,53 @@ GBool PDFDoc::isLinearized() {
   return lin;
 }
 
+// Read the linearization dictionary at the start of the file, and set
+// firstPageObjNum.  The dictionary is valid only if the file length
+// matches, i.e., the file hasn't been updated after linearization.
+// In a valid linearized file, startxref points to the xref section of
+// the first page, which follows the linearization dictionary.
+GBool PDFDoc::readLinearization() {
+  Parser *parser;
+  Object obj1, obj2, obj3, obj4, obj5;
+  GFileOffset fileLength;
+  GBool lin;
+
+  lin = gFalse;
+  obj1.initNull();
+  parser = new Parser(NULL,
+	     new Lexer(NULL,
+	       str->makeSubStream(str->getStart(), gFalse, 0, &obj1)),
+	     gTrue);
+  parser->getObj(&obj1);
+  parser->getObj(&obj2);
+  parser->getObj(&obj3);
+  parser->getObj(&obj4);
+  if (obj1.isInt() && obj2.isInt() && obj3.isCmd("obj") &&
+      obj4.isDict()) {
+    if (obj4.dictLookup("Linearized", &obj5)->isNum() &&
+	obj5.getNum() > 0) {
+      obj5.free();
+      str->setPos(0, -1);
+      fileLength = str->getPos() - str->getStart();
+      if (obj4.dictLookup("L", &obj5)->isNum() &&
+	  (GFileOffset)obj5.getNum() == fileLength) {
+	obj5.free();
+	if (obj4.dictLookup("O", &obj5)->isInt() && obj5.getInt() > 0) {
+	  firstPageObjNum = obj5.getInt();
+	  lin = gTrue;
+	}
+      }
+    }
+    obj5.free();
+  }
+  obj4.free();
+  obj3.free();
+  obj2.free();
+  obj1.free();
+  delete parser;
+  return lin;
+}
+
 GBool PDFDoc::saveAs(GString *name) {
   FILE *f;
   char buf[4096];
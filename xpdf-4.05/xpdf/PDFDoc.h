@@ -35,12 +35,19 @@ class PDFCore;
 class PDFDoc {
 public:
 
+  // If [firstPageOnly] is set, only the first page of a linearized
+  // file is opened: the xref section and objects of the first page at
+  // the start of the file are read, the main xref table and page tree
+  // are not.  The document then has one page.  Opening fails if the
+  // file isn't linearized, or has been updated after linearization.
   PDFDoc(GString *fileNameA, GString *ownerPassword = NULL,
-	 GString *userPassword = NULL, PDFCore *coreA = NULL);
+	 GString *userPassword = NULL, PDFCore *coreA = NULL,
+	 GBool firstPageOnly = gFalse);
 
 #ifdef _WIN32
   PDFDoc(const wchar_t *fileNameA, size_t fileNameLen, GString *ownerPassword = NULL,
-	 GString *userPassword = NULL, PDFCore *coreA = NULL);
+	 GString *userPassword = NULL, PDFCore *coreA = NULL,
+	 GBool firstPageOnly = gFalse);
 #endif
 
   // This version takes a UTF-8 file name (which is only relevant on
@@ -79,6 +86,11 @@ public:
   // Get base stream.
   BaseStream *getBaseStream() { return str; }
 
+  // Close the file before the document is destroyed, e.g. in another
+  // thread.  Nothing can be read from the document after this, only
+  // the destructor may be called.
+  void closeFile();
+
   // Get page parameters.
   double getPageMediaWidth(int page)
     { return catalog->getPage(page)->getMediaWidth(); }
@@ -171,6 +183,12 @@ public:
   // Is this document linearized?
   GBool isLinearized();
 
+  // Is only the first page of a linearized file open?
+  GBool isFirstPageOnly() { return firstPageObjNum >= 0; }
+
+  // Object number of the first page, if only the first page is open.
+  int getFirstPageObjNum() { return firstPageObjNum; }
+
   // Return the document's Info dictionary (if any).
   Object *getDocInfo(Object *obj) { return xref->getDocInfo(obj); }
   Object *getDocInfoNF(Object *obj) { return xref->getDocInfoNF(obj); }
@@ -203,9 +221,11 @@ public:
 
 private:
 
-  GBool setup(GString *ownerPassword, GString *userPassword);
+  GBool setup(GString *ownerPassword, GString *userPassword,
+	      GBool firstPageOnly = gFalse);
   GBool setup2(GString *ownerPassword, GString *userPassword,
 	       GBool repairXRef);
+  GBool readLinearization();
   void checkHeader();
   GBool checkEncryption(GString *ownerPassword, GString *userPassword);
 #ifndef NO_EMBEDDED_CONTENT
@@ -227,6 +247,8 @@ private:
 #endif
   OptionalContent *optContent{ nullptr };
 
+  int firstPageObjNum{ -1 };	// first page object number, if only
+				//   the first page is open
   GBool ok{ gFalse };
   int errCode{ errNone };
 };
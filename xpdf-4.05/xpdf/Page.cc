@@ -279,6 +279,24 @@ GBool PageAttrs::readBox(Dict *dict, const char *key, PDFRectangle *box) {
 // Page
 //------------------------------------------------------------------------
 
+static thread_local GBool (*contentsCbk)(void *data, int pageNum,
+					 Object *contentsA) = NULL;
+static thread_local void *contentsCbkData = NULL;
+
+void Page::setContentsCbk(GBool (*cbk)(void *data, int pageNum,
+				       Object *contentsA),
+			  void *data) {
+  contentsCbk = cbk;
+  contentsCbkData = data;
+}
+
+void Page::getContentsCbk(GBool (**cbk)(void *data, int pageNum,
+					Object *contentsA),
+			  void **data) {
+  *cbk = contentsCbk;
+  *data = contentsCbkData;
+}
+
 Page::Page(PDFDoc *docA, int numA, Dict *pageDict, PageAttrs *attrsA) {
   ok = gTrue;
   doc = docA;
@@ -376,7 +394,7 @@ void Page::displaySlice(OutputDev *out, double hDPI, double vDPI,
   PDFRectangle *mediaBox, *cropBox;
   PDFRectangle box;
   Gfx *gfx;
-  Object obj;
+  Object obj, decoded;
   AcroForm *form;
   int i;
 
@@ -414,7 +432,12 @@ void Page::displaySlice(OutputDev *out, double hDPI, double vDPI,
   contents.fetch(xref, &obj);
   if (!obj.isNull()) {
     gfx->saveState();
-    gfx->display(&contents);
+    if (contentsCbk && (*contentsCbk)(contentsCbkData, num, &decoded)) {
+      gfx->display(&decoded);
+      decoded.free();
+    } else {
+      gfx->display(&contents);
+    }
     gfx->endOfPage();
   }
   obj.free();
@@ -161,6 +161,17 @@ public:
   // Get contents.
   Object *getContents(Object *obj) { return contents.fetch(xref, obj); }
 
+  // Set/get the callback which supplies already decoded contents of a
+  // page.  If it returns true, display() interprets the stream returned
+  // in <contentsA> instead of the page's content streams.  The callback
+  // is set per thread, NULL disables it.
+  static void setContentsCbk(GBool (*cbk)(void *data, int pageNum,
+					  Object *contentsA),
+			     void *data);
+  static void getContentsCbk(GBool (**cbk)(void *data, int pageNum,
+					   Object *contentsA),
+			     void **data);
+
   // Get the page's thumbnail image.
   Object *getThumbnail(Object *obj) { return thumbnail.fetch(xref, obj); }
 
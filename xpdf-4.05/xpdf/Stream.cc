@@ -60,6 +60,13 @@ static GBool setDJSYSFLAGS = gFalse;
 #define decompressionBombSizeThreshold 50000000
 #define decompressionBombRatioThreshold 200
 
+// LZW/Flate/decryption output size (in bytes) between two abort checks.
+#define abortCheckSize 1048576
+
+// Size of the input buffer of filters which read their input byte by
+// byte (see FilterStream::getInputChar).
+#define filterInputBufSize 4096
+
 //------------------------------------------------------------------------
 // Stream (base class)
 //------------------------------------------------------------------------
@@ -70,6 +77,32 @@ Stream::Stream() {
 Stream::~Stream() {
 }
 
+static thread_local GBool (*abortCheckCbk)(void *data) = NULL;
+static thread_local void *abortCheckCbkData = NULL;
+static thread_local unsigned long long decodedSize = 0;
+
+void Stream::setAbortCheckCbk(GBool (*cbk)(void *data), void *data) {
+  abortCheckCbk = cbk;
+  abortCheckCbkData = data;
+}
+
+void Stream::getAbortCheckCbk(GBool (**cbk)(void *data), void **data) {
+  *cbk = abortCheckCbk;
+  *data = abortCheckCbkData;
+}
+
+GBool Stream::checkForAbort() {
+  return abortCheckCbk && (*abortCheckCbk)(abortCheckCbkData);
+}
+
+unsigned long long Stream::getDecodedSize() {
+  return decodedSize;
+}
+
+void Stream::addDecodedSize(unsigned long long n) {
+  decodedSize += n;
+}
+
 void Stream::close() {
 }
 
@@ -78,6 +111,19 @@ int Stream::getRawChar() {
   return EOF;
 }
 
+int Stream::getRawBlock(char *blk, int size) {
+  int n, c;
+
+  n = 0;
+  while (n < size) {
+    if ((c = getRawChar()) == EOF) {
+      break;
+    }
+    blk[n++] = (char)c;
+  }
+  return n;
+}
+
 int Stream::getBlock(char *buf, int size) {
   int n, c;
 
@@ -357,9 +403,29 @@ BaseStream::~BaseStream() {
 FilterStream::FilterStream(Stream *strA) 
     : str{ strA }
 {
+  inputReadAhead = !str->getBaseStream()->isEmbedStream();
 }
 
 FilterStream::~FilterStream() {
+  gfree(inBuf);
+}
+
+int FilterStream::fillInputBuf() {
+  int n;
+
+  if (!inputReadAhead) {
+    return str->getChar();
+  }
+  if (!inBuf) {
+    inBuf = (char *)gmalloc(filterInputBufSize);
+  }
+  n = str->getBlock(inBuf, filterInputBufSize);
+  inBufPtr = inBuf;
+  inBufEnd = inBuf + (n > 0 ? n : 0);
+  if (inBufPtr >= inBufEnd) {
+    return EOF;
+  }
+  return *inBufPtr++ & 0xff;
 }
 
 void FilterStream::close() {
@@ -489,6 +555,69 @@ void ImageStream::skipLine() {
 // StreamPredictor
 //------------------------------------------------------------------------
 
+// PNG filter kernels.  The templates are instantiated for the common
+// pixel widths, so the compiler can unroll (and vectorize) the loops;
+// <bpp> = 0 is the generic version, using the <pixBytes> arg.
+
+static void pngFilterUp(Guchar *cur, const Guchar *prev,
+			const Guchar *raw, int n, int pixBytes) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    cur[i] = (Guchar)(prev[i] + raw[i]);
+  }
+}
+
+static void pngFilterAverage(Guchar *cur, const Guchar *prev,
+			     const Guchar *raw, int n, int pixBytes) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    cur[i] = (Guchar)(((cur[i - pixBytes] + prev[i]) >> 1) + raw[i]);
+  }
+}
+
+template <int bpp>
+static void pngFilterSub(Guchar *cur, const Guchar *prev,
+			 const Guchar *raw, int n, int pixBytes) {
+  const int d = bpp ? bpp : pixBytes;
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    cur[i] = (Guchar)(cur[i - d] + raw[i]);
+  }
+}
+
+template <int bpp>
+static void pngFilterPaeth(Guchar *cur, const Guchar *prev,
+			   const Guchar *raw, int n, int pixBytes) {
+  const int d = bpp ? bpp : pixBytes;
+  int left, up, upLeft, pa, pb, pc, i;
+
+  for (i = 0; i < n; ++i) {
+    left = cur[i - d];
+    up = prev[i];
+    upLeft = prev[i - d];
+    // p = left + up - upLeft; pa = |p - left|, pb = |p - up|,
+    // pc = |p - upLeft|
+    pa = up - upLeft;
+    pb = left - upLeft;
+    pc = pa + pb;
+    if (pa < 0)
+      pa = -pa;
+    if (pb < 0)
+      pb = -pb;
+    if (pc < 0)
+      pc = -pc;
+    if (pa <= pb && pa <= pc)
+      cur[i] = (Guchar)(left + raw[i]);
+    else if (pb <= pc)
+      cur[i] = (Guchar)(up + raw[i]);
+    else
+      cur[i] = (Guchar)(upLeft + raw[i]);
+  }
+}
+
 StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
 				 int widthA, int nCompsA, int nBitsA) 
     : str{ strA }
@@ -508,6 +637,32 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
     return;
   }
   predLine = (Guchar *)gmalloc(rowBytes);
+  prevLine = (Guchar *)gmalloc(rowBytes);
+  rawLine = (Guchar *)gmalloc(rowBytes - pixBytes);
+
+  // select the PNG kernels for the pixel width
+  switch (pixBytes) {
+  case 1:
+    pngSub = &pngFilterSub<1>;
+    pngPaeth = &pngFilterPaeth<1>;
+    break;
+  case 2:
+    pngSub = &pngFilterSub<2>;
+    pngPaeth = &pngFilterPaeth<2>;
+    break;
+  case 3:
+    pngSub = &pngFilterSub<3>;
+    pngPaeth = &pngFilterPaeth<3>;
+    break;
+  case 4:
+    pngSub = &pngFilterSub<4>;
+    pngPaeth = &pngFilterPaeth<4>;
+    break;
+  default:
+    pngSub = &pngFilterSub<0>;
+    pngPaeth = &pngFilterPaeth<0>;
+    break;
+  }
 
   reset();
 
@@ -516,10 +671,13 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
 
 StreamPredictor::~StreamPredictor() {
   gfree(predLine);
+  gfree(prevLine);
+  gfree(rawLine);
 }
 
 void StreamPredictor::reset() {
   memset(predLine, 0, rowBytes);
+  memset(prevLine, 0, rowBytes);
   predIdx = rowBytes;
 }
 
@@ -565,7 +723,8 @@ int StreamPredictor::getBlock(char *blk, int size) {
 GBool StreamPredictor::getNextLine() {
   int curPred;
   Guchar upLeftBuf[gfxColorMaxComps * 2 + 1];
-  int left, up, upLeft, p, pa, pb, pc;
+  Guchar *line;
+  int n;
   int c;
   Gulong inBuf, outBuf, bitMask;
   int inBits, outBits;
@@ -581,55 +740,43 @@ GBool StreamPredictor::getNextLine() {
     curPred = predictor;
   }
 
-  // read the raw line, apply PNG (byte) predictor
-  memset(upLeftBuf, 0, pixBytes + 1);
-  for (i = pixBytes; i < rowBytes; ++i) {
-    for (j = pixBytes; j > 0; --j) {
-      upLeftBuf[j] = upLeftBuf[j-1];
-    }
-    upLeftBuf[0] = predLine[i];
-    if ((c = str->getRawChar()) == EOF) {
-      if (i > pixBytes) {
-	// this ought to return false, but some (broken) PDF files
-	// contain truncated image data, and Adobe apparently reads the
-	// last partial line
-	break;
-      }
-      return gFalse;
-    }
-    switch (curPred) {
-    case 11:			// PNG sub
-      predLine[i] = (Guchar)(predLine[i - pixBytes] + c);
-      break;
-    case 12:			// PNG up
-      predLine[i] = (Guchar)(predLine[i] + c);
-      break;
-    case 13:			// PNG average
-      predLine[i] = (Guchar)(((predLine[i - pixBytes] + predLine[i]) >> 1) + c);
-      break;
-    case 14:			// PNG Paeth
-      left = predLine[i - pixBytes];
-      up = predLine[i];
-      upLeft = upLeftBuf[pixBytes];
-      p = left + up - upLeft;
-      if ((pa = p - left) < 0)
-	pa = -pa;
-      if ((pb = p - up) < 0)
-	pb = -pb;
-      if ((pc = p - upLeft) < 0)
-	pc = -pc;
-      if (pa <= pb && pa <= pc)
-	predLine[i] = (Guchar)(left + c);
-      else if (pb <= pc)
-	predLine[i] = (Guchar)(up + c);
-      else
-	predLine[i] = (Guchar)(upLeft + c);
-      break;
-    case 10:			// PNG none
-    default:			// no predictor or TIFF predictor
-      predLine[i] = (Guchar)c;
-      break;
-    }
+  // read the raw line
+  if ((n = str->getRawBlock((char *)rawLine, rowBytes - pixBytes)) <= 0) {
+    return gFalse;
+  }
+
+  // the previous line becomes the up line, apply PNG (byte) predictor
+  line = prevLine;
+  prevLine = predLine;
+  predLine = line;
+  switch (curPred) {
+  case 11:			// PNG sub
+    (*pngSub)(predLine + pixBytes, prevLine + pixBytes, rawLine,
+	      n, pixBytes);
+    break;
+  case 12:			// PNG up
+    pngFilterUp(predLine + pixBytes, prevLine + pixBytes, rawLine,
+		n, pixBytes);
+    break;
+  case 13:			// PNG average
+    pngFilterAverage(predLine + pixBytes, prevLine + pixBytes, rawLine,
+		     n, pixBytes);
+    break;
+  case 14:			// PNG Paeth
+    (*pngPaeth)(predLine + pixBytes, prevLine + pixBytes, rawLine,
+		n, pixBytes);
+    break;
+  case 10:			// PNG none
+  default:			// no predictor or TIFF predictor
+    memcpy(predLine + pixBytes, rawLine, n);
+    break;
+  }
+  if (n < rowBytes - pixBytes) {
+    // this ought to return false, but some (broken) PDF files
+    // contain truncated image data, and Adobe apparently reads the
+    // last partial line -- the rest of the line is left unchanged
+    memcpy(predLine + pixBytes + n, prevLine + pixBytes + n,
+	   rowBytes - pixBytes - n);
   }
 
   // apply TIFF (component) predictor
@@ -868,11 +1015,17 @@ void FileStream::setPos(GFileOffset pos, int dir) {
   if (dir >= 0) {
     bufPos = pos;
   } else {
-    size = f->getSize();
-    if (pos <= size) {
+    // seek from the end of the window, so that a limited stream can
+    // be opened as a document (e.g., an embedded file)
+    if (limited) {
+      size = start + length;
+    } else {
+      size = f->getSize();
+    }
+    if (pos <= size - start) {
       bufPos = size - pos;
     } else {
-      bufPos = 0;
+      bufPos = start;
     }
   }
   bufPtr = bufEnd = buf;
@@ -1067,29 +1220,53 @@ Stream *ASCIIHexStream::copy() {
 
 void ASCIIHexStream::reset() {
   str->reset();
+  resetInputBuf();
   buf = EOF;
   eof = gFalse;
 }
 
 int ASCIIHexStream::lookChar() {
-  int c1, c2, x;
-
   if (buf != EOF)
     return buf;
   if (eof) {
     buf = EOF;
     return EOF;
   }
+  buf = decodeByte();
+  return buf;
+}
+
+int ASCIIHexStream::getBlock(char *blk, int size) {
+  int n, c;
+
+  n = 0;
+  if (n < size && buf != EOF) {
+    blk[n++] = (char)buf;
+    buf = EOF;
+  }
+  while (n < size && !eof) {
+    if ((c = decodeByte()) == EOF) {
+      break;
+    }
+    blk[n++] = (char)c;
+  }
+  return n;
+}
+
+// Decode the next pair of hex digits.  Returns EOF at the end of the
+// data.
+int ASCIIHexStream::decodeByte() {
+  int c1, c2, x;
+
   do {
-    c1 = str->getChar();
+    c1 = getInputChar();
   } while (isspace(c1));
   if (c1 == '>') {
     eof = gTrue;
-    buf = EOF;
-    return buf;
+    return EOF;
   }
   do {
-    c2 = str->getChar();
+    c2 = getInputChar();
   } while (isspace(c2));
   if (c2 == '>') {
     eof = gTrue;
@@ -1122,8 +1299,7 @@ int ASCIIHexStream::lookChar() {
     error(errSyntaxError, getPos(),
 	  "Illegal character <{0:02x}> in ASCIIHex stream", c2);
   }
-  buf = x & 0xff;
-  return buf;
+  return x & 0xff;
 }
 
 GString *ASCIIHexStream::getPSFilter(int psLevel, const char *indent,
@@ -1163,52 +1339,73 @@ Stream *ASCII85Stream::copy() {
 
 void ASCII85Stream::reset() {
   str->reset();
+  resetInputBuf();
   index = n = 0;
   eof = gFalse;
 }
 
 int ASCII85Stream::lookChar() {
+  if (index >= n) {
+    if (eof || !decodeGroup())
+      return EOF;
+  }
+  return b[index];
+}
+
+int ASCII85Stream::getBlock(char *blk, int size) {
+  int i;
+
+  i = 0;
+  while (i < size) {
+    if (index >= n) {
+      if (eof || !decodeGroup())
+	break;
+    }
+    blk[i++] = (char)b[index++];
+  }
+  return i;
+}
+
+// Decode the next group of five characters into <b>.  Returns false
+// at the end of the data.
+GBool ASCII85Stream::decodeGroup() {
   int k;
   Gulong t;
 
-  if (index >= n) {
-    if (eof)
-      return EOF;
-    index = 0;
-    do {
-      c[0] = str->getChar();
-    } while (Lexer::isSpace(c[0]));
-    if (c[0] == '~' || c[0] == EOF) {
+  index = 0;
+  do {
+    c[0] = getInputChar();
+  } while (Lexer::isSpace(c[0]));
+  if (c[0] == '~' || c[0] == EOF) {
+    eof = gTrue;
+    n = 0;
+    return gFalse;
+  } else if (c[0] == 'z') {
+    b[0] = b[1] = b[2] = b[3] = 0;
+    n = 4;
+  } else {
+    for (k = 1; k < 5; ++k) {
+      do {
+	c[k] = getInputChar();
+      } while (Lexer::isSpace(c[k]));
+      if (c[k] == '~' || c[k] == EOF)
+	break;
+    }
+    n = k - 1;
+    if (k < 5 && (c[k] == '~' || c[k] == EOF)) {
+      for (++k; k < 5; ++k)
+	c[k] = 0x21 + 84;
       eof = gTrue;
-      n = 0;
-      return EOF;
-    } else if (c[0] == 'z') {
-      b[0] = b[1] = b[2] = b[3] = 0;
-      n = 4;
-    } else {
-      for (k = 1; k < 5; ++k) {
-	do {
-	  c[k] = str->getChar();
-	} while (Lexer::isSpace(c[k]));
-	if (c[k] == '~' || c[k] == EOF)
-	  break;
-      }
-      n = k - 1;
-      if (k < 5 && (c[k] == '~' || c[k] == EOF)) {
-	for (++k; k < 5; ++k)
-	  c[k] = 0x21 + 84;
-	eof = gTrue;
-      }
-      t = 0;
-      for (k = 0; k < 5; ++k)
-	t = t * 85 + (c[k] - 0x21);
-      for (k = 3; k >= 0; --k) {
-	b[k] = (int)(t & 0xff);
-	t >>= 8;
-      }
+    }
+    t = 0;
+    for (k = 0; k < 5; ++k)
+      t = t * 85 + (c[k] - 0x21);
+    for (k = 3; k >= 0; --k) {
+      b[k] = (int)(t & 0xff);
+      t >>= 8;
     }
   }
-  return b[index];
+  return gTrue;
 }
 
 GString *ASCII85Stream::getPSFilter(int psLevel, const char *indent,
@@ -1237,6 +1434,12 @@ LZWStream::LZWStream(Stream *strA, int predictor, int columns, int colors,
 		     int bits, int earlyA):
     FilterStream(strA), early(earlyA)
 {
+  int i;
+
+  for (i = 0; i < 256; ++i) {
+    table[i].length = 1;
+    table[i].suffix = table[i].first = (Guchar)i;
+  }
   if (predictor != 1) {
     pred = new StreamPredictor(this, predictor, columns, colors, bits);
     if (!pred->isOk()) {
@@ -1247,6 +1450,7 @@ LZWStream::LZWStream(Stream *strA, int predictor, int columns, int colors,
 }
 
 LZWStream::~LZWStream() {
+  addDecodedSize(totalOut - accountedOut);
   if (pred) {
     delete pred;
   }
@@ -1279,6 +1483,7 @@ int LZWStream::getChar() {
     if (!processNextCode()) {
       return EOF;
     }
+    copySeq(seqBuf);
   }
   return seqBuf[seqIndex++];
 }
@@ -1294,6 +1499,7 @@ int LZWStream::lookChar() {
     if (!processNextCode()) {
       return EOF;
     }
+    copySeq(seqBuf);
   }
   return seqBuf[seqIndex];
 }
@@ -1306,16 +1512,21 @@ int LZWStream::getRawChar() {
     if (!processNextCode()) {
       return EOF;
     }
+    copySeq(seqBuf);
   }
   return seqBuf[seqIndex++];
 }
 
 int LZWStream::getBlock(char *blk, int size) {
-  int n, m;
-
   if (pred) {
     return pred->getBlock(blk, size);
   }
+  return getRawBlock(blk, size);
+}
+
+int LZWStream::getRawBlock(char *blk, int size) {
+  int n, m;
+
   if (eof) {
     return 0;
   }
@@ -1325,6 +1536,15 @@ int LZWStream::getBlock(char *blk, int size) {
       if (!processNextCode()) {
 	break;
       }
+      // if the whole sequence fits, decode it directly into the
+      // caller's buffer
+      if (seqLength <= size - n) {
+	copySeq((Guchar *)blk + n);
+	seqIndex = seqLength;
+	n += seqLength;
+	continue;
+      }
+      copySeq(seqBuf);
     }
     m = seqLength - seqIndex;
     if (m > size - n) {
@@ -1339,19 +1559,22 @@ int LZWStream::getBlock(char *blk, int size) {
 
 void LZWStream::reset() {
   str->reset();
+  resetInputBuf();
   if (pred) {
     pred->reset();
   }
   eof = gFalse;
   inputBits = 0;
   clearTable();
-  totalIn = totalOut = 0;
+  addDecodedSize(totalOut - accountedOut);
+  totalIn = totalOut = accountedOut = 0;
+  nextAbortCheck = abortCheckSize;
 }
 
+// Reads the next code and sets up the current sequence.  The
+// sequence itself is not decoded here, see copySeq().
 GBool LZWStream::processNextCode() {
   int code;
-  int nextLength;
-  int i, j;
 
   // check for EOF
   if (eof) {
@@ -1374,34 +1597,23 @@ GBool LZWStream::processNextCode() {
 	  "Bad LZW stream - expected clear-table code");
     clearTable();
   }
-
-  // process the next code
-  nextLength = seqLength + 1;
-  if (code < 256) {
-    seqBuf[0] = (Guchar)code;
-    seqLength = 1;
-  } else if (code < nextCode) {
-    seqLength = table[code].length;
-    for (i = seqLength - 1, j = code; i > 0; --i) {
-      seqBuf[i] = table[j].tail;
-      j = table[j].head;
-    }
-    seqBuf[0] = (Guchar)j;
-  } else if (code == nextCode) {
-    seqBuf[seqLength] = (Guchar)newChar;
-    ++seqLength;
-  } else {
+  if (code > nextCode || (code == nextCode && first)) {
     error(errSyntaxError, getPos(), "Bad LZW stream - unexpected code");
     eof = gTrue;
     return gFalse;
   }
-  newChar = seqBuf[0];
+
+  // add the previous sequence followed by the first byte of the
+  // current sequence to the table -- if the current code is the one
+  // being added, its first byte is the first byte of the previous
+  // sequence
   if (first) {
     first = gFalse;
   } else if (nextCode < 4097) {
-    table[nextCode].length = nextLength;
-    table[nextCode].head = prevCode;
-    table[nextCode].tail = (Guchar)newChar;
+    table[nextCode].length = table[prevCode].length + 1;
+    table[nextCode].prefix = prevCode;
+    table[nextCode].first = table[prevCode].first;
+    table[nextCode].suffix = table[code == nextCode ? prevCode : code].first;
     ++nextCode;
     if (nextCode + early == 512)
       nextBits = 10;
@@ -1411,6 +1623,8 @@ GBool LZWStream::processNextCode() {
       nextBits = 12;
   }
   prevCode = code;
+  seqCode = code;
+  seqLength = table[code].length;
   totalOut += seqLength;
 
   // check for a 'decompression bomb'
@@ -1422,12 +1636,36 @@ GBool LZWStream::processNextCode() {
     return gFalse;
   }
 
+  // check for an abort
+  if (totalOut >= nextAbortCheck) {
+    nextAbortCheck = totalOut + abortCheckSize;
+    addDecodedSize(totalOut - accountedOut);
+    accountedOut = totalOut;
+    if (checkForAbort()) {
+      eof = gTrue;
+      return gFalse;
+    }
+  }
+
   // reset buffer
   seqIndex = 0;
 
   return gTrue;
 }
 
+// Writes the current sequence (seqLength bytes) to <buf>, walking the
+// table from the last byte back to the first one.
+void LZWStream::copySeq(Guchar *buf) {
+  Guchar *p;
+  int code;
+
+  p = buf + seqLength;
+  for (code = seqCode; code > 255; code = table[code].prefix) {
+    *--p = table[code].suffix;
+  }
+  *--p = (Guchar)code;
+}
+
 void LZWStream::clearTable() {
   nextCode = 258;
   nextBits = 9;
@@ -1440,7 +1678,7 @@ int LZWStream::getCode() {
   int code;
 
   while (inputBits < nextBits) {
-    if ((c = str->getChar()) == EOF)
+    if ((c = getInputChar()) == EOF)
       return EOF;
     inputBuf = (inputBuf << 8) | (c & 0xff);
     inputBits += 8;
@@ -1491,6 +1729,7 @@ Stream *RunLengthStream::copy() {
 
 void RunLengthStream::reset() {
   str->reset();
+  resetInputBuf();
   bufPtr = bufEnd = buf;
   eof = gFalse;
 }
@@ -1540,7 +1779,7 @@ GBool RunLengthStream::fillBuf() {
 
   if (eof)
     return gFalse;
-  c = str->getChar();
+  c = getInputChar();
   if (c == 0x80 || c == EOF) {
     eof = gTrue;
     return gFalse;
@@ -1548,10 +1787,10 @@ GBool RunLengthStream::fillBuf() {
   if (c < 0x80) {
     n = c + 1;
     for (i = 0; i < n; ++i)
-      buf[i] = (char)str->getChar();
+      buf[i] = (char)getInputChar();
   } else {
     n = 0x101 - c;
-    c = str->getChar();
+    c = getInputChar();
     for (i = 0; i < n; ++i)
       buf[i] = (char)c;
   }
@@ -4991,6 +5230,7 @@ FlateStream::FlateStream(Stream *strA, int predictor, int columns,
 }
 
 FlateStream::~FlateStream() {
+  addDecodedSize(totalOut - accountedOut);
   if (litCodeTab.codes != fixedLitCodeTab.codes) {
     gfree(litCodeTab.codes);
   }
@@ -5044,7 +5284,9 @@ void FlateStream::reset() {
   cmf = str->getChar();
   flg = str->getChar();
   totalIn = 2;
-  totalOut = 0;
+  addDecodedSize(totalOut - accountedOut);
+  totalOut = accountedOut = 0;
+  nextAbortCheck = abortCheckSize;
   if (cmf == EOF || flg == EOF)
     return;
   if ((cmf & 0x0f) != 0x08) {
@@ -5111,11 +5353,14 @@ int FlateStream::getRawChar() {
 }
 
 int FlateStream::getBlock(char *blk, int size) {
-  int n, k;
-
   if (pred) {
     return pred->getBlock(blk, size);
   }
+  return getRawBlock(blk, size);
+}
+
+int FlateStream::getRawBlock(char *blk, int size) {
+  int n, k;
 
   n = 0;
   while (n < size) {
@@ -5292,6 +5537,17 @@ void FlateStream::readSome() {
     remain = 0;
   }
 
+  // check for an abort
+  if (totalOut >= nextAbortCheck) {
+    nextAbortCheck = totalOut + abortCheckSize;
+    addDecodedSize(totalOut - accountedOut);
+    accountedOut = totalOut;
+    if (checkForAbort()) {
+      endOfBlock = eof = gTrue;
+      remain = 0;
+    }
+  }
+
   return;
 
 err:
@@ -101,6 +101,11 @@ public:
   // This is only used by StreamPredictor.
   virtual int getRawChar();
 
+  // Get up to <size> bytes from stream without using the predictor.
+  // Returns the number of bytes read -- the returned count will be
+  // less than <size> at EOF.  This is only used by StreamPredictor.
+  virtual int getRawBlock(char *blk, int size);
+
   // Get exactly <size> bytes from stream.  Returns the number of
   // bytes read -- the returned count will be less than <size> at EOF.
   virtual int getBlock(char *buf, int size);
@@ -156,6 +161,25 @@ public:
   // Returns the new stream.
   Stream *addFilters(Object *dict, int recursion = 0);
 
+  // Set/get the callback used by long-running decoders (LZW, Flate,
+  // decryption) to check for an abort.  The callback is set per
+  // thread, NULL disables the check.
+  static void setAbortCheckCbk(GBool (*cbk)(void *data), void *data);
+  static void getAbortCheckCbk(GBool (**cbk)(void *data), void **data);
+
+  // Call the abort check callback.  Returns true if the decoder should
+  // stop and report EOF.
+  static GBool checkForAbort();
+
+  // Get the number of bytes decoded by LZW and Flate decoders in the
+  // current thread.
+  static unsigned long long getDecodedSize();
+
+  // Add <n> bytes to the number of bytes decoded in the current
+  // thread (also used for data decoded by another thread on behalf of
+  // this one).
+  static void addDecodedSize(unsigned long long n);
+
 private:
 
   Stream *makeFilter(char *name, Stream *str, Object *params, int recursion);
@@ -213,7 +237,28 @@ public:
 
 protected:
 
+  // Get the next byte from <str>.  Filters which parse their input
+  // byte by byte use this instead of str->getChar(): the input is read
+  // with str->getBlock() into a buffer.  Input of inline images is not
+  // read ahead, because the data after the image belongs to the
+  // content stream.
+  int getInputChar()
+    { return (inBufPtr < inBufEnd) ? (*inBufPtr++ & 0xff)
+	                           : fillInputBuf(); }
+
+  // Discard the input buffer (after resetting <str>).
+  void resetInputBuf() { inBufPtr = inBufEnd = inBuf; }
+
   Stream *str;
+
+private:
+
+  int fillInputBuf();
+
+  GBool inputReadAhead;		// true if the input can be read ahead
+  char *inBuf{ nullptr };	// input buffer (allocated on first use)
+  char *inBufPtr{ nullptr };	// next byte in input buffer
+  char *inBufEnd{ nullptr };	// end of data in input buffer
 };
 
 //------------------------------------------------------------------------
@@ -265,6 +310,12 @@ private:
 // StreamPredictor
 //------------------------------------------------------------------------
 
+// PNG filter kernel: decodes <n> bytes of <raw> into <cur>, using the
+// previous line <prev>.  <cur> and <prev> point past <pixBytes> bytes
+// of zero padding, so cur[-pixBytes] and prev[-pixBytes] are valid.
+typedef void (*PNGFilterFunc)(Guchar *cur, const Guchar *prev,
+			      const Guchar *raw, int n, int pixBytes);
+
 class StreamPredictor {
 public:
 
@@ -301,6 +352,10 @@ private:
   int pixBytes;			// bytes per pixel
   int rowBytes;			// bytes per line
   Guchar* predLine{ nullptr };		// line buffer
+  Guchar* prevLine{ nullptr };		// previous line buffer
+  Guchar* rawLine{ nullptr };		// raw (undecoded) line buffer
+  PNGFilterFunc pngSub{ nullptr };	// PNG Sub kernel for pixBytes
+  PNGFilterFunc pngPaeth{ nullptr };	// PNG Paeth kernel for pixBytes
   int predIdx{ 0 };			// current index in predLine
   GBool ok{ gFalse };
 };
@@ -436,12 +491,15 @@ public:
   virtual int getChar()
     { int c = lookChar(); buf = EOF; return c; }
   virtual int lookChar();
+  virtual int getBlock(char *blk, int size);
   virtual GString *getPSFilter(int psLevel, const char *indent,
 			       GBool okToReadStream);
   virtual GBool isBinary(GBool last = gTrue);
 
 private:
 
+  int decodeByte();
+
   int buf{ EOF };
   GBool eof{ gFalse };
 };
@@ -461,12 +519,15 @@ public:
   virtual int getChar()
     { int ch = lookChar(); ++index; return ch; }
   virtual int lookChar();
+  virtual int getBlock(char *blk, int size);
   virtual GString *getPSFilter(int psLevel, const char *indent,
 			       GBool okToReadStream);
   virtual GBool isBinary(GBool last = gTrue);
 
 private:
 
+  GBool decodeGroup();
+
   int c[5]{};
   int b[4]{};
   int index{ 0 }, n{ 0 };
@@ -493,6 +554,7 @@ public:
   virtual int getChar();
   virtual int lookChar();
   virtual int getRawChar();
+  virtual int getRawBlock(char *blk, int size);
   virtual int getBlock(char *blk, int size);
   virtual GString *getPSFilter(int psLevel, const char *indent,
 			       GBool okToReadStream);
@@ -506,15 +568,18 @@ private:
   GBool eof{ gFalse };			// true if at eof
   int inputBuf{ 0 };			// input buffer
   int inputBits{ 0 };		// number of bits in input buffer
-  struct {			// decoding table
-    int length{ 0 };
-    int head{ 0 };
-    Guchar tail{ 0 };
+  struct {			// decoding table: the sequence of a code is
+				//   the sequence of its prefix code
+				//   followed by the suffix byte
+    int length{ 0 };		// length of the sequence
+    int prefix{ 0 };		// prefix code
+    Guchar suffix{ 0 };		// last byte of the sequence
+    Guchar first{ 0 };		// first byte of the sequence
   } table[4097]{};
   int nextCode{ 258 };			// next code to be used
   int nextBits{ 9 };			// number of bits in next code word
   int prevCode{ 0 };			// previous code used in stream
-  int newChar{ 0 };			// next char to be added to table
+  int seqCode{ 0 };			// code of current sequence
   Guchar seqBuf[4097]{};		// buffer for current sequence
   int seqLength{ 0 };		// length of current sequence
   int seqIndex{ 0 };			// index into current sequence
@@ -522,8 +587,12 @@ private:
   GBool checkForDecompressionBombs{ gTrue };
   unsigned long long totalIn{ 0 };	// total number of encoded bytes read so far
   unsigned long long totalOut{ 0 };	// total number of bytes decoded so far
+  unsigned long long nextAbortCheck{ 0 };	// totalOut at the next abort check
+  unsigned long long accountedOut{ 0 };	// part of totalOut which has been
+					//   added to the decoded size
 
   GBool processNextCode();
+  void copySeq(Guchar *buf);
   void clearTable();
   int getCode();
 };
@@ -822,6 +891,7 @@ public:
   virtual int getChar();
   virtual int lookChar();
   virtual int getRawChar();
+  virtual int getRawBlock(char *blk, int size);
   virtual int getBlock(char *blk, int size);
   virtual GString *getPSFilter(int psLevel, const char *indent,
 			       GBool okToReadStream);
@@ -847,6 +917,9 @@ private:
   GBool checkForDecompressionBombs{ gTrue };
   unsigned long long totalIn{ 0 };	// total number of encoded bytes read so far
   unsigned long long totalOut{ 0 };	// total number of bytes decoded so far
+  unsigned long long nextAbortCheck{ 0 };	// totalOut at the next abort check
+  unsigned long long accountedOut{ 0 };	// part of totalOut which has been
+					//   added to the decoded size
 
   static int			// code length code reordering
     codeLenCodeMap[flateMaxCodeLenCodes];
@@ -189,6 +189,13 @@
 
 #define maxUnicodeLen 16
 
+// Max number of unused TextChar objects kept by a TextPage for reuse
+// on the next page.
+#define maxCharPoolSize 32768
+
+// Initial size of the TextPage font hash table (power of 2).
+#define fontHashSizeMin 32
+
 //------------------------------------------------------------------------
 
 static inline double dmin(double x, double y) {
@@ -212,6 +219,14 @@ public:
 	   TextFontInfo *fontA, double fontSizeA,
 	   double colorRA, double colorGA, double colorBA);
 
+  // (Re)initialize all fields -- used by the constructor, and by
+  // TextPage::newChar() to reuse a recycled char.
+  void init(Unicode cA, int charPosA, int charLenA,
+	    double xMinA, double yMinA, double xMaxA, double yMaxA,
+	    int rotA, GBool rotatedA, GBool clippedA, GBool invisibleA,
+	    TextFontInfo *fontA, double fontSizeA,
+	    double colorRA, double colorGA, double colorBA);
+
   static int cmpX(const void *p1, const void *p2);
   static int cmpY(const void *p1, const void *p2);
   static int cmpBase(const void *p1, const void *p2);
@@ -242,6 +257,16 @@ TextChar::TextChar(Unicode cA, int charPosA, int charLenA,
 		   int rotA, GBool rotatedA, GBool clippedA, GBool invisibleA,
 		   TextFontInfo *fontA, double fontSizeA,
 		   double colorRA, double colorGA, double colorBA) {
+  init(cA, charPosA, charLenA, xMinA, yMinA, xMaxA, yMaxA,
+       rotA, rotatedA, clippedA, invisibleA, fontA, fontSizeA,
+       colorRA, colorGA, colorBA);
+}
+
+void TextChar::init(Unicode cA, int charPosA, int charLenA,
+		    double xMinA, double yMinA, double xMaxA, double yMaxA,
+		    int rotA, GBool rotatedA, GBool clippedA, GBool invisibleA,
+		    TextFontInfo *fontA, double fontSizeA,
+		    double colorRA, double colorGA, double colorBA) {
   double t;
 
   c = cA;
@@ -709,6 +734,8 @@ TextOutputControl::TextOutputControl() {
   marginRight = 0;
   marginTop = 0;
   marginBottom = 0;
+  maxPageChars = 0;
+  skipHiddenContent = gFalse;
 }
 
 
@@ -756,6 +783,57 @@ TextFontInfo::TextFontInfo(GfxState *state) {
       }
     }
   }
+  sizeScale = 1;
+  if (gfxFont && gfxFont->getType() == fontType3) {
+    // This is a hack which makes it possible to deal with some Type 3
+    // fonts.  The problem is that it's impossible to know what the
+    // base coordinate system used in the font is without actually
+    // rendering the font.  This code tries to guess by looking at the
+    // width of the character 'm' (which breaks if the font is a
+    // subset that doesn't contain 'm').  It depends only on the font,
+    // so it's done once per font (per page), not on every font
+    // change.
+    char *name;
+    double *fm;
+    double w;
+    int code, mCode, letterCode, anyCode;
+    mCode = letterCode = anyCode = -1;
+    for (code = 0; code < 256; ++code) {
+      name = ((Gfx8BitFont *)gfxFont)->getCharName(code);
+      if (name && name[0] == 'm' && name[1] == '\0') {
+	mCode = code;
+      }
+      if (letterCode < 0 &&
+	  name &&
+	  ((name[0] >= 'A' && name[0] <= 'Z') ||
+	   (name[0] >= 'a' && name[0] <= 'z')) &&
+	  name[1] == '\0') {
+	letterCode = code;
+      }
+      if (anyCode < 0 && name &&
+	  ((Gfx8BitFont *)gfxFont)->getWidth((Guchar)code) > 0) {
+	anyCode = code;
+      }
+    }
+    if (mCode >= 0 &&
+	(w = ((Gfx8BitFont *)gfxFont)->getWidth((Guchar)mCode)) > 0) {
+      // 0.6 is a generic average 'm' width -- yes, this is a hack
+      sizeScale *= w / 0.6;
+    } else if (letterCode >= 0 &&
+	       (w = ((Gfx8BitFont *)gfxFont)->getWidth((Guchar)letterCode))
+	         > 0) {
+      // even more of a hack: 0.5 is a generic letter width
+      sizeScale *= w / 0.5;
+    } else if (anyCode >= 0 &&
+	       (w = ((Gfx8BitFont *)gfxFont)->getWidth((Guchar)anyCode)) > 0) {
+      // better than nothing: 0.5 is a generic character width
+      sizeScale *= w / 0.5;
+    }
+    fm = gfxFont->getFontMatrix();
+    if (fm[0] != 0) {
+      sizeScale *= fabs(fm[3] / fm[0]);
+    }
+  }
 }
 
 TextFontInfo::TextFontInfo()
@@ -764,6 +842,7 @@ TextFontInfo::TextFontInfo()
   , mWidth(0)
   , ascent(0)
   , descent(0)
+  , sizeScale(1)
 {
   fontID.num = -1;
   fontID.gen = -1;
@@ -1254,7 +1333,11 @@ TextPage::TextPage(TextOutputControl *controlA)
   actualTextNBytes = 0;
 
   chars = new GList();
+  charPool = new GList();
   fonts = new GList();
+  fontHashSize = fontHashSizeMin;
+  fontHash = (TextFontInfo **)gmallocn(fontHashSize, sizeof(TextFontInfo *));
+  memset(fontHash, 0, fontHashSize * sizeof(TextFontInfo *));
   primaryRot = 0;
 
   underlines = new GList();
@@ -1270,7 +1353,9 @@ TextPage::TextPage(TextOutputControl *controlA)
 TextPage::~TextPage() {
   clear();
   deleteGList(chars, TextChar);
+  deleteGList(charPool, TextChar);
   deleteGList(fonts, TextFontInfo);
+  gfree(fontHash);
   deleteGList(underlines, TextUnderline);
   deleteGList(links, TextLink);
   if (findCols) {
@@ -1299,6 +1384,8 @@ void TextPage::startPage(GfxState *state) {
 }
 
 void TextPage::clear() {
+  int i;
+
   pageWidth = pageHeight = 0;
   charPos = 0;
   curFont = NULL;
@@ -1311,14 +1398,21 @@ void TextPage::clear() {
   actualText = NULL;
   actualTextLen = 0;
   actualTextNBytes = 0;
-  deleteGList(chars, TextChar);
-  chars = new GList();
-  deleteGList(fonts, TextFontInfo);
-  fonts = new GList();
-  deleteGList(underlines, TextUnderline);
-  underlines = new GList();
-  deleteGList(links, TextLink);
-  links = new GList();
+  // keep the chars and the list space for the next page
+  recycleChars(chars);
+  for (i = 0; i < fonts->getLength(); ++i) {
+    delete (TextFontInfo *)fonts->get(i);
+  }
+  fonts->clear();
+  memset(fontHash, 0, fontHashSize * sizeof(TextFontInfo *));
+  for (i = 0; i < underlines->getLength(); ++i) {
+    delete (TextUnderline *)underlines->get(i);
+  }
+  underlines->clear();
+  for (i = 0; i < links->getLength(); ++i) {
+    delete (TextLink *)links->get(i);
+  }
+  links->clear();
   nVisibleChars = 0;
   nInvisibleChars = 0;
   nRemovedDupChars = 0;
@@ -1333,29 +1427,112 @@ void TextPage::clear() {
   problematic = gFalse;
 }
 
+// Allocate a char, reusing a recycled one if available.
+TextChar *TextPage::newChar(Unicode c, int charPosA, int charLen,
+			    double xMin, double yMin, double xMax, double yMax,
+			    int rot, GBool rotatedA, GBool clipped,
+			    GBool invisible, TextFontInfo *font,
+			    double fontSize,
+			    double colorR, double colorG, double colorB) {
+  TextChar *ch;
+
+  if (charPool->getLength() == 0) {
+    return new TextChar(c, charPosA, charLen, xMin, yMin, xMax, yMax,
+			rot, rotatedA, clipped, invisible, font, fontSize,
+			colorR, colorG, colorB);
+  }
+  ch = (TextChar *)charPool->pop();
+  ch->init(c, charPosA, charLen, xMin, yMin, xMax, yMax,
+	   rot, rotatedA, clipped, invisible, font, fontSize,
+	   colorR, colorG, colorB);
+  return ch;
+}
+
+// Move the chars in <charsA> to the pool (up to maxCharPoolSize),
+// delete the rest, and empty <charsA>.
+void TextPage::recycleChars(GList *charsA) {
+  int i;
+
+  for (i = 0; i < charsA->getLength(); ++i) {
+    if (charPool->getLength() < maxCharPoolSize) {
+      charPool->append(charsA->get(i));
+    } else {
+      delete (TextChar *)charsA->get(i);
+    }
+  }
+  charsA->clear();
+}
+
+// Hash function for the font hash table.
+static inline Guint hashFontID(Ref id) {
+  return (Guint)id.num * 31 + (Guint)id.gen;
+}
+
+// Find the font info object for the current font in [state].
+TextFontInfo *TextPage::lookupFont(GfxState *state) {
+  TextFontInfo *font;
+  Ref id;
+  Guint h;
+
+  if (state->getFont()) {
+    id = *state->getFont()->getID();
+  } else {
+    id.num = -1;
+    id.gen = -1;
+  }
+  h = hashFontID(id) & (Guint)(fontHashSize - 1);
+  while ((font = fontHash[h])) {
+    if (font->fontID.num == id.num && font->fontID.gen == id.gen) {
+      return font;
+    }
+    h = (h + 1) & (Guint)(fontHashSize - 1);
+  }
+  return NULL;
+}
+
+// Add a font info object to the font list and the hash table.
+void TextPage::addFont(TextFontInfo *font) {
+  TextFontInfo *font2;
+  Guint h;
+  int i;
+
+  fonts->append(font);
+  // keep the load factor at most 1/2
+  if (2 * fonts->getLength() > fontHashSize) {
+    fontHashSize *= 2;
+    fontHash = (TextFontInfo **)greallocn(fontHash, fontHashSize,
+					  sizeof(TextFontInfo *));
+    memset(fontHash, 0, fontHashSize * sizeof(TextFontInfo *));
+    for (i = 0; i < fonts->getLength() - 1; ++i) {
+      font2 = (TextFontInfo *)fonts->get(i);
+      h = hashFontID(font2->fontID) & (Guint)(fontHashSize - 1);
+      while (fontHash[h]) {
+	h = (h + 1) & (Guint)(fontHashSize - 1);
+      }
+      fontHash[h] = font2;
+    }
+  }
+  h = hashFontID(font->fontID) & (Guint)(fontHashSize - 1);
+  while (fontHash[h]) {
+    h = (h + 1) & (Guint)(fontHashSize - 1);
+  }
+  fontHash[h] = font;
+}
+
 void TextPage::updateFont(GfxState *state) {
   GfxFont *gfxFont;
   double *fm;
-  char *name;
-  int code, mCode, letterCode, anyCode;
-  double w;
   double m[4], m2[4];
-  int i;
 
-  // get the font info object
-  curFont = NULL;
-  for (i = 0; i < fonts->getLength(); ++i) {
-    curFont = (TextFontInfo *)fonts->get(i);
-    if (curFont->matches(state)) {
-      break;
-    }
-    curFont = NULL;
-  }
-  if (!curFont) {
-    curFont = new TextFontInfo(state);
-    fonts->append(curFont);
-    if (state->getFont() && state->getFont()->problematicForUnicode()) {
-      problematic = gTrue;
+  // get the font info object -- font changes often switch back and
+  // forth between a few fonts, so check the current one first
+  if (!curFont || !curFont->matches(state)) {
+    if (!(curFont = lookupFont(state))) {
+      curFont = new TextFontInfo(state);
+      addFont(curFont);
+      if (state->getFont() && state->getFont()->problematicForUnicode()) {
+	problematic = gTrue;
+      }
     }
   }
 
@@ -1363,48 +1540,8 @@ void TextPage::updateFont(GfxState *state) {
   gfxFont = state->getFont();
   curFontSize = state->getTransformedFontSize();
   if (gfxFont && gfxFont->getType() == fontType3) {
-    // This is a hack which makes it possible to deal with some Type 3
-    // fonts.  The problem is that it's impossible to know what the
-    // base coordinate system used in the font is without actually
-    // rendering the font.  This code tries to guess by looking at the
-    // width of the character 'm' (which breaks if the font is a
-    // subset that doesn't contain 'm').
-    mCode = letterCode = anyCode = -1;
-    for (code = 0; code < 256; ++code) {
-      name = ((Gfx8BitFont *)gfxFont)->getCharName(code);
-      if (name && name[0] == 'm' && name[1] == '\0') {
-	mCode = code;
-      }
-      if (letterCode < 0 &&
-	  name &&
-	  ((name[0] >= 'A' && name[0] <= 'Z') ||
-	   (name[0] >= 'a' && name[0] <= 'z')) &&
-	  name[1] == '\0') {
-	letterCode = code;
-      }
-      if (anyCode < 0 && name &&
-	  ((Gfx8BitFont *)gfxFont)->getWidth((Guchar)code) > 0) {
-	anyCode = code;
-      }
-    }
-    if (mCode >= 0 &&
-	(w = ((Gfx8BitFont *)gfxFont)->getWidth((Guchar)mCode)) > 0) {
-      // 0.6 is a generic average 'm' width -- yes, this is a hack
-      curFontSize *= w / 0.6;
-    } else if (letterCode >= 0 &&
-	       (w = ((Gfx8BitFont *)gfxFont)->getWidth((Guchar)letterCode))
-	         > 0) {
-      // even more of a hack: 0.5 is a generic letter width
-      curFontSize *= w / 0.5;
-    } else if (anyCode >= 0 &&
-	       (w = ((Gfx8BitFont *)gfxFont)->getWidth((Guchar)anyCode)) > 0) {
-      // better than nothing: 0.5 is a generic character width
-      curFontSize *= w / 0.5;
-    }
-    fm = gfxFont->getFontMatrix();
-    if (fm[0] != 0) {
-      curFontSize *= fabs(fm[3] / fm[0]);
-    }
+    // see TextFontInfo::TextFontInfo()
+    curFontSize *= curFont->sizeScale;
   }
 
   // compute the rotation
@@ -1617,12 +1754,12 @@ void TextPage::addChar(GfxState *state, double x, double y,
 	j = i;
       }
       GBool invisible = state->getRender() == 3 || alpha < 0.001;
-      chars->append(new TextChar(uBuf[j], charPos, nBytes,
-				 xMin, yMin, xMax, yMax,
-				 curRot, rotated, clipped, invisible,
-				 curFont, curFontSize,
-				 colToDbl(rgb.r), colToDbl(rgb.g),
-				 colToDbl(rgb.b)));
+      chars->append(newChar(uBuf[j], charPos, nBytes,
+			    xMin, yMin, xMax, yMax,
+			    curRot, rotated, clipped, invisible,
+			    curFont, curFontSize,
+			    colToDbl(rgb.r), colToDbl(rgb.g),
+			    colToDbl(rgb.b)));
       if (invisible) {
 	++nInvisibleChars;
       } else {
@@ -1638,8 +1775,8 @@ void TextPage::addSpecialChar(double xMin, double yMin,
 			      double xMax, double yMax,
 			      int rot, TextFontInfo *font, double fontSize,
 			      Unicode u) {
-  chars->append(new TextChar(u, 0, 0, xMin, yMin, xMax, yMax, rot,
-			     gFalse, gFalse, gFalse, font, fontSize, 0, 0, 0));
+  chars->append(newChar(u, 0, 0, xMin, yMin, xMax, yMax, rot,
+			gFalse, gFalse, gFalse, font, fontSize, 0, 0, 0));
 }
 
 //~ this is inefficient -- consider using some sort of tree
@@ -1657,7 +1794,11 @@ void TextPage::removeChars(double xMin, double yMin,
     if (xOverlap > xOverlapThresh * (ch->xMax - ch->xMin) &&
 	yOverlap > yOverlapThresh * (ch->yMax - ch->yMin)) {
       chars->del(i);
-      delete ch;
+      if (charPool->getLength() < maxCharPoolSize) {
+	charPool->append(ch);
+      } else {
+	delete ch;
+      }
     } else {
       ++i;
     }
@@ -1716,6 +1857,20 @@ void TextPage::addLink(double xMin, double yMin, double xMax, double yMax,
 //------------------------------------------------------------------------
 
 void TextPage::write(void *outputStream, TextOutputFunc outputFunc) {
+  write(outputStream, outputFunc, gTrue);
+}
+
+void TextPage::flush(void *outputStream, TextOutputFunc outputFunc) {
+  write(outputStream, outputFunc, gFalse);
+  recycleChars(chars);
+  if (findCols) {
+    deleteGList(findCols, TextColumn);
+    findCols = NULL;
+  }
+}
+
+void TextPage::write(void *outputStream, TextOutputFunc outputFunc,
+		     GBool endOfPage) {
   UnicodeMap *uMap;
   char space[8], eol[16], eop[8];
   int spaceLen, eolLen, eopLen;
@@ -1771,7 +1926,7 @@ void TextPage::write(void *outputStream, TextOutputFunc outputFunc) {
   }
 
   // end of page
-  if (pageBreaks) {
+  if (endOfPage && pageBreaks) {
     (*outputFunc)(outputStream, eop, eopLen);
   }
 
@@ -1823,7 +1978,8 @@ void TextPage::writeReadingOrder(void *outputStream,
     if (overlappingChars->getLength() > 0) {
       columns->append(buildOverlappingTextColumn(overlappingChars));
     }
-    deleteGList(overlappingChars, TextChar);
+    recycleChars(overlappingChars);
+    delete overlappingChars;
   }
 #if 0 //~debug
   dumpColumns(columns);
@@ -1894,7 +2050,8 @@ GList *TextPage::makeColumns() {
       if (overlappingChars->getLength() > 0) {
 	columns->append(buildOverlappingTextColumn(overlappingChars));
       }
-      deleteGList(overlappingChars, TextChar);
+      recycleChars(overlappingChars);
+      delete overlappingChars;
     }
   }
   return columns;
@@ -2022,7 +2179,8 @@ void TextPage::writePhysLayout(void *outputStream,
       }
       delete col;
     }
-    deleteGList(overlappingChars, TextChar);
+    recycleChars(overlappingChars);
+    delete overlappingChars;
   }
 }
 
@@ -6667,7 +6825,8 @@ TextWordList *TextPage::makeWordListForChars(GList *charList) {
       if (overlappingChars->getLength() > 0) {
 	columns->append(buildOverlappingTextColumn(overlappingChars));
       }
-      deleteGList(overlappingChars, TextChar);
+      recycleChars(overlappingChars);
+      delete overlappingChars;
     }
   }
 
@@ -6923,6 +7082,10 @@ void TextOutputDev::drawChar(GfxState *state, double x, double y,
 			     CharCode c, int nBytes, Unicode *u, int uLen,
 			     GBool fill, GBool stroke, GBool makePath) {
   text->addChar(state, x, y, dx, dy, c, nBytes, u, uLen);
+  if (control.maxPageChars > 0 && outputStream &&
+      text->chars->getLength() >= control.maxPageChars) {
+    text->flush(outputStream, outputFunc);
+  }
 }
 
 void TextOutputDev::incCharCount(int nChars) {
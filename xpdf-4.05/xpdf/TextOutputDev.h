@@ -86,6 +86,15 @@ public:
          marginRight,		//   discarded
          marginTop,
          marginBottom;
+  int maxPageChars;		// if non-zero, the text of a page is
+				//   written in parts of (at most) this
+				//   many characters, to bound memory
+				//   use on huge pages -- layout is done
+				//   within each part only
+  GBool skipHiddenContent;	// don't interpret content on non-shown
+				//   layers (forms on hidden layers are
+				//   not parsed at all), character
+				//   positions don't count hidden text
 };
 
 //------------------------------------------------------------------------
@@ -130,6 +139,8 @@ private:
   int flags;
   double mWidth;
   double ascent, descent;
+  double sizeScale;		// font size scale factor guessed for
+				//   Type 3 fonts (1 for other fonts)
 
   friend class TextLine;
   friend class TextPage;
@@ -392,6 +403,11 @@ public:
   // Write contents of page to a stream.
   void write(void *outputStream, TextOutputFunc outputFunc);
 
+  // Write the chars added so far to a stream (without the end of page
+  // marker), and remove them from the page.  Fonts and counters are
+  // kept, so more chars can be added.
+  void flush(void *outputStream, TextOutputFunc outputFunc);
+
   // Find a string.  If <startAtTop> is true, starts looking at the
   // top of the page; else if <startAtLast> is true, starts looking
   // immediately after the last find result; else starts looking at
@@ -501,10 +517,23 @@ public:
   void removeChars(double xMin, double yMin, double xMax, double yMax,
 		   double xOverlapThresh, double yOverlapThresh);
 
+  // Clear the page for reuse.  Char objects and list space are kept
+  // for the next page, so extraction of many pages with one TextPage
+  // does almost no heap allocation.
+  void reset() { clear(); }
+
 private:
 
   void startPage(GfxState *state);
   void clear();
+  TextFontInfo *lookupFont(GfxState *state);
+  void addFont(TextFontInfo *font);
+  TextChar *newChar(Unicode c, int charPosA, int charLen,
+		    double xMin, double yMin, double xMax, double yMax,
+		    int rot, GBool rotatedA, GBool clipped, GBool invisible,
+		    TextFontInfo *font, double fontSize,
+		    double colorR, double colorG, double colorB);
+  void recycleChars(GList *charsA);
   void updateFont(GfxState *state);
   void addChar(GfxState *state, double x, double y,
 	       double dx, double dy,
@@ -517,6 +546,8 @@ private:
 	       Link *link);
 
   // output
+  void write(void *outputStream, TextOutputFunc outputFunc,
+	     GBool endOfPage);
   void writeReadingOrder(void *outputStream,
 			 TextOutputFunc outputFunc,
 			 UnicodeMap *uMap,
@@ -650,8 +681,13 @@ private:
   int actualTextNBytes;
 
   GList *chars;			// [TextChar]
+  GList *charPool;		// unused chars, reused by newChar()
+				//   [TextChar]
   GList *fonts;			// all font info objects used on this
 				//   page [TextFontInfo]
+  TextFontInfo **fontHash;	// hash table of the font info objects,
+				//   indexed by font ID (open addressing)
+  int fontHashSize;		// size of fontHash (power of 2)
   int primaryRot;		// primary rotation
 
   GList *underlines;		// [TextUnderline]
@@ -722,7 +758,7 @@ public:
 
   // Does this device require incCharCount to be called for text on
   // non-shown layers?
-  virtual GBool needCharCount() { return gTrue; }
+  virtual GBool needCharCount() { return !control.skipHiddenContent; }
 
   //----- initialization and control
 
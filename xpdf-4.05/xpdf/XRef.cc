@@ -31,6 +31,18 @@
 #define xrefSearchSize 1024	// read this many bytes at end of file
 				//   to look for 'startxref'
 
+#define prefetchObjSize 4096	// prefetch this many bytes of each object
+#define prefetchGapMax 32768	// prefetched objects closer than this are
+				//   read with one sequential read
+#define prefetchRunMax 262144	// max size of one sequential read
+
+static int cmpFileOffsets(const void *p1, const void *p2) {
+  GFileOffset d;
+
+  d = *(const GFileOffset *)p1 - *(const GFileOffset *)p2;
+  return d < 0 ? -1 : d > 0 ? 1 : 0;
+}
+
 //------------------------------------------------------------------------
 // XRefPosSet
 //------------------------------------------------------------------------
@@ -275,7 +287,7 @@ Object *ObjectStream::getObject(int objIdx, int objNum, Object *obj) {
 // XRef
 //------------------------------------------------------------------------
 
-XRef::XRef(BaseStream *strA, GBool repair) 
+XRef::XRef(BaseStream *strA, GBool repair, GBool firstSection) 
     : str{ strA }
 {
   GFileOffset pos;
@@ -311,7 +323,11 @@ XRef::XRef(BaseStream *strA, GBool repair)
 
     // read the xref table
     posSet = new XRefPosSet();
-    while (readXRef(&pos, posSet, gFalse)) ;
+    if (firstSection) {
+      readXRef(&pos, posSet, gFalse);
+    } else {
+      while (readXRef(&pos, posSet, gFalse)) ;
+    }
     xrefTablePosLen = posSet->getLength();
     xrefTablePos = (GFileOffset *)gmallocn(xrefTablePosLen,
 					   sizeof(GFileOffset));
@@ -333,7 +349,8 @@ XRef::XRef(BaseStream *strA, GBool repair)
     obj.free();
   } else {
     obj.free();
-    if (!(ok = constructXRef())) {
+    if (firstSection || !(ok = constructXRef())) {
+      ok = gFalse;
       errCode = errDamaged;
       return;
     }
@@ -745,8 +762,9 @@ GBool XRef::readXRefStream(Stream *xrefStr, GFileOffset *pos, GBool hybrid) {
 }
 
 GBool XRef::readXRefStreamSection(Stream *xrefStr, int *w, int first, int n) {
+  Guchar buf[24];
   long long type, gen, offset;
-  int c, newSize, i, j;
+  int entrySize, newSize, i, j, k;
 
   if (first + n < 0) {
     return gFalse;
@@ -765,31 +783,30 @@ GBool XRef::readXRefStreamSection(Stream *xrefStr, int *w, int first, int n) {
     }
     size = newSize;
   }
+  // w[i] <= 8 is checked by the caller
+  entrySize = w[0] + w[1] + w[2];
   for (i = first; i < first + n; ++i) {
+    // read the whole entry with one call -- for Flate/LZW streams with
+    // a predictor, this copies directly from the predictor line
+    if (xrefStr->getBlock((char *)buf, entrySize) != entrySize) {
+      return gFalse;
+    }
+    k = 0;
     if (w[0] == 0) {
       type = 1;
     } else {
       for (type = 0, j = 0; j < w[0]; ++j) {
-	if ((c = xrefStr->getChar()) == EOF) {
-	  return gFalse;
-	}
-	type = (type << 8) + c;
+	type = (type << 8) + buf[k++];
       }
     }
     for (offset = 0, j = 0; j < w[1]; ++j) {
-      if ((c = xrefStr->getChar()) == EOF) {
-	return gFalse;
-      }
-      offset = (offset << 8) + c;
+      offset = (offset << 8) + buf[k++];
     }
     if (offset < 0 || offset > GFILEOFFSET_MAX) {
       return gFalse;
     }
     for (gen = 0, j = 0; j < w[2]; ++j) {
-      if ((c = xrefStr->getChar()) == EOF) {
-	return gFalse;
-      }
-      gen = (gen << 8) + c;
+      gen = (gen << 8) + buf[k++];
     }
     // some PDF generators include a free entry with gen=0xffffffff
     if ((gen < 0 || gen > INT_MAX) && type != 0) {
@@ -1291,9 +1308,11 @@ GBool XRef::getObjectStreamObject(int objStrNum, int objIdx,
     return gTrue;
   }
 
-  // load a new ObjectStream
+  // load a new ObjectStream -- if an abort was requested while the
+  // object stream was decoded, the decoder may have stopped early, so
+  // the (possibly truncated) ObjectStream is discarded, not cached
   objStr = new ObjectStream(this, objStrNum, recursion);
-  if (!objStr->isOk()) {
+  if (!objStr->isOk() || Stream::checkForAbort()) {
     delete objStr;
     return gFalse;
   }
@@ -1378,6 +1397,73 @@ Object *XRef::getDocInfoNF(Object *obj) {
   return trailerDict.dictLookupNF("Info", obj);
 }
 
+// Objects are read in file offset order, nearby objects are coalesced
+// into one sequential read of at most prefetchRunMax bytes.  The data
+// is discarded: fetches which follow in logical order are served from
+// the file system cache instead of seeking back and forth across the
+// file.  Objects in object streams are prefetched as their object
+// stream.  The stream abort check is called between reads.
+void XRef::prefetch(Ref *refs, int nRefs) {
+  GFileOffset *offsets;
+  GFileOffset pos, end;
+  XRefEntry *e;
+  Stream *s;
+  Object obj;
+  char *buf;
+  int nOffsets, num, n, i;
+
+  // a single object is read by its fetch anyway
+  if (nRefs < 2) {
+    return;
+  }
+  offsets = (GFileOffset *)gmallocn(nRefs, sizeof(GFileOffset));
+  nOffsets = 0;
+  for (i = 0; i < nRefs; ++i) {
+    num = refs[i].num;
+    if (num < 0 || num > last) {
+      continue;
+    }
+    e = &entries[num];
+    if (e->type == xrefEntryCompressed) {
+      if (e->offset < 0 || e->offset > last) {
+	continue;
+      }
+      e = &entries[e->offset];
+    }
+    if (e->type == xrefEntryUncompressed) {
+      offsets[nOffsets++] = e->offset;
+    }
+  }
+  qsort(offsets, nOffsets, sizeof(GFileOffset), &cmpFileOffsets);
+
+  buf = (char *)gmalloc(prefetchObjSize);
+  i = 0;
+  while (i < nOffsets) {
+    if (Stream::checkForAbort()) {
+      break;
+    }
+    pos = offsets[i];
+    end = pos + prefetchObjSize;
+    for (++i; i < nOffsets && offsets[i] <= end + prefetchGapMax &&
+	   offsets[i] + prefetchObjSize - pos <= prefetchRunMax; ++i) {
+      end = offsets[i] + prefetchObjSize;
+    }
+    obj.initNull();
+    s = str->makeSubStream(start + pos, gFalse, 0, &obj);
+    s->reset();
+    while (pos < end) {
+      n = end - pos < prefetchObjSize ? (int)(end - pos) : prefetchObjSize;
+      if ((n = s->getBlock(buf, n)) <= 0) {
+	break;
+      }
+      pos += n;
+    }
+    delete s;
+  }
+  gfree(buf);
+  gfree(offsets);
+}
+
 GBool XRef::getStreamEnd(GFileOffset streamStart, GFileOffset *streamEnd) {
   int a, b, m;
 
@@ -65,8 +65,11 @@ struct XRefCacheEntry {
 class XRef {
 public:
 
-  // Constructor.  Read xref table from stream.
-  XRef(BaseStream *strA, GBool repair);
+  // Constructor.  Read xref table from stream.  If [firstSection] is
+  // set, only the xref section which startxref points to is read (in
+  // a linearized file, the first page section), and the table is not
+  // repaired if it is damaged.
+  XRef(BaseStream *strA, GBool repair, GBool firstSection = gFalse);
 
   // Destructor.
   ~XRef();
@@ -104,6 +107,9 @@ public:
   // Fetch an indirect reference.
   Object *fetch(int num, int gen, Object *obj, int recursion = 0);
 
+  // Read objects [refs] from the file ahead of fetching them.
+  void prefetch(Ref *refs, int nRefs);
+
   // Return the document's Info dictionary (if any).
   Object *getDocInfo(Object *obj);
   Object *getDocInfoNF(Object *obj);